@@ -1,160 +1,306 @@
-#include "Application.h"
-#include "toolbox.h"
-#include <algorithm>
-#include <iostream>
-const float Application::DEFAULT_ZOOM = 0.03f;
-Application::Application(sf::RenderWindow & rw, int argc, char** argv)
-    :renderWindow(rw)
-    ,view(rw.getDefaultView())
-    ,mouseHeldRight(false)
-    ,zoomPercent(DEFAULT_ZOOM)
-{
-    updateViewSize();
-    view.setCenter({ 0,0 });
-    // process our arg list //
-    bool loadedMap = false;
-    for (int c = 1; c < argc; c++)
-    {
-        if (argv[c] == std::string("-map"))
-        {
-            c++;
-            if (c >= argc)
-            {
-                std::cerr << "ERROR: must specify map filename after \"-map\"\n";
-                break;
-            }
-            if (!map.load(argv[c]))
-            {
-                exit(EXIT_FAILURE);
-            }
-            loadedMap = true;
-        }
-    }
-    if (!loadedMap)
-    {
-        std::cerr << "ERROR: no map loaded! use -map \"filename\" to specify a Tiled JSON map.\n";
-        exit(EXIT_FAILURE);
-    }
-}
-void Application::onEvent(const sf::Event & e)
-{
-    static const float ZOOM_DELTA = -0.00625f;
-    static const float MIN_ZOOM = DEFAULT_ZOOM * 2;
-    static const float MAX_ZOOM = 0.00125f;
-    switch (e.type)
-    {
-    case sf::Event::KeyPressed:
-        switch(e.key.code)
-        {
-        case sf::Keyboard::F1:
-            map.toggleVoxelGrid();
-            break;
-        case sf::Keyboard::F2:
-            map.togglePartitionMeta();
-            break;
-        case sf::Keyboard::Escape:
-            renderWindow.close();
-            break;
-        case sf::Keyboard::J:
-            zoomPercent += ZOOM_DELTA*-1;
-            zoomPercent = clampf(zoomPercent, MAX_ZOOM, MIN_ZOOM);
-            updateViewSize();
-            break;
-        case sf::Keyboard::K:
-            zoomPercent += ZOOM_DELTA*1;
-            zoomPercent = clampf(zoomPercent, MAX_ZOOM, MIN_ZOOM);
-            updateViewSize();
-            break;
-        }
-        break;
-    case sf::Event::MouseButtonPressed:
-        switch (e.mouseButton.button)
-        {
-        case sf::Mouse::Left:
-            mouseHeldLeft = true;
-            mouseLeftClickPosition = { e.mouseButton.x, e.mouseButton.y };
-            break;
-        case sf::Mouse::Right:
-            mouseHeldRight = true;
-            mouseRightClickOrigin = { float(e.mouseButton.x), float(e.mouseButton.y) };
-            mouseRightClickCenterScreen = view.getCenter();
-            break;
-        case sf::Mouse::Middle:
-            zoomPercent = DEFAULT_ZOOM;
-            updateViewSize();
-            break;
-        }
-        break;
-    case sf::Event::MouseButtonReleased:
-        switch (e.mouseButton.button)
-        {
-        case sf::Mouse::Left:
-            mouseHeldLeft = false;
-            break;
-        case sf::Mouse::Right:
-            mouseHeldRight = false;
-            break;
-        }
-        break;
-    case sf::Event::MouseMoved:
-        if (mouseHeldRight)
-        {
-            const sf::Vector2f mousePosF(float(e.mouseMove.x), float(e.mouseMove.y));
-            sf::Vector2f fromClickOrigin = mouseRightClickOrigin - mousePosF;
-            fromClickOrigin.y *= -1.f;// need to invert y because it's inverted in screen-space
-            view.setCenter(mouseRightClickCenterScreen + fromClickOrigin*zoomPercent);
-        }
-        break;
-    case sf::Event::MouseWheelScrolled:
-        {
-            //std::cout << "wheelDelta=" << e.mouseWheelScroll.delta << std::endl;
-            zoomPercent += ZOOM_DELTA*e.mouseWheelScroll.delta;
-            zoomPercent = clampf(zoomPercent, MAX_ZOOM, MIN_ZOOM);
-            updateViewSize();
-        }
-        break;
-    }
-}
-void Application::tick(const sf::Time & deltaTime)
-{
-    renderWindow.setView(view);
-    if (mouseHeldLeft)
-    {
-        map.touch(renderWindow.mapPixelToCoords(mouseLeftClickPosition));
-    }
-    map.stepSimulation();
-    map.draw(renderWindow);
-    drawOrigin();
-}
-void Application::drawOrigin()
-{
-    static const float ORIGIN_LINE_SIZE = 1;
-    // First, we get the boundaries of the world that we're drawing
-    //  so that we can prevent the origin from being drawn off-screen //
-    auto viewCenter = view.getCenter();
-    auto viewSize = view.getSize();
-    viewSize.y *= -1;// need to do this because we invert the view size to fix the y-axis
-    auto viewBottomLeft = viewCenter - viewSize*0.5f;
-    auto viewTopRight = viewBottomLeft + viewSize;
-    sf::Vector2f drawLocation(
-        clampf(viewBottomLeft.x + 1.f/999, 0.f, viewTopRight.x - 1.f/9),
-        clampf(viewBottomLeft.y + 1.f/999, 0.f, viewTopRight.y - 1.f/9));
-    // Finally, we draw the origin graphics //
-    sf::VertexArray va(sf::PrimitiveType::Lines, 4);
-    va[0].position = drawLocation + sf::Vector2f{ 0,0 };
-    va[1].position = drawLocation + sf::Vector2f{ 0,ORIGIN_LINE_SIZE };
-    va[0].color = sf::Color::Green;
-    va[1].color = sf::Color::Green;
-    va[2].position = drawLocation + sf::Vector2f{ 0,0 };
-    va[3].position = drawLocation + sf::Vector2f{ ORIGIN_LINE_SIZE,0 };
-    va[2].color = sf::Color::Red;
-    va[3].color = sf::Color::Red;
-    renderWindow.draw(va);
-}
-void Application::updateViewSize()
-{
-    auto winSize = renderWindow.getSize();
-    // Invert the camera's y-axis //
-    sf::Vector2f newSize(float(winSize.x), winSize.y*-1.f);
-    view.setSize(newSize*zoomPercent);
+#include "Application.h"
+#include "toolbox.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+const float Application::DEFAULT_ZOOM = 0.03f;
+Application::Application(sf::RenderWindow & rw, int argc, char** argv)
+    :renderWindow(rw)
+    ,view(rw.getDefaultView())
+    ,mouseHeldRight(false)
+    ,zoomPercent(DEFAULT_ZOOM)
+    ,showStabilityGraph(false)
+{
+    updateViewSize();
+    view.setCenter({ 0,0 });
+    // process our arg list //
+    std::string mapFilename;
+    Map::LoadOptions mapOptions;
+    for (int c = 1; c < argc; c++)
+    {
+        if (argv[c] == std::string("-map"))
+        {
+            c++;
+            if (c >= argc)
+            {
+                std::cerr << "ERROR: must specify map filename after \"-map\"\n";
+                break;
+            }
+            mapFilename = argv[c];
+        }
+        else if (argv[c] == std::string("-3d"))
+        {
+            mapOptions.volumetric = true;
+        }
+        else if (argv[c] == std::string("-regionsize") && c + 1 < argc)
+        {
+            mapOptions.regionTiles = unsigned(std::max(1, std::stoi(argv[++c])));
+        }
+        else if (argv[c] == std::string("-quality") && c + 1 < argc)
+        {
+            if (!mapOptions.setQuality(argv[++c]))
+            {
+                std::cerr << "ERROR: unknown quality \"" << argv[c] << "\", use preview, balanced or final\n";
+            }
+        }
+        else if (argv[c] == std::string("-maxhz") && c + 1 < argc)
+        {
+            mapOptions.maximumSoundHz = std::stof(argv[++c]);
+        }
+        else if (argv[c] == std::string("-budget") && c + 1 < argc)
+        {
+            if (!mapOptions.setMemoryBudget(argv[++c]))
+            {
+                std::cerr << "ERROR: can't make out a memory budget from \"" << argv[c] << "\", use eg. 512M or 2G\n";
+            }
+        }
+    }
+    if (mapFilename.empty())
+    {
+        std::cerr << "ERROR: no map loaded! use -map \"filename\" to specify a Tiled JSON map.\n";
+        exit(EXIT_FAILURE);
+    }
+    // the window keeps responding while the map loads, showing the tiles as soon as they're in //
+    map.loadAsync(mapFilename, mapOptions, getViewBounds());
+}
+void Application::onEvent(const sf::Event & e)
+{
+    static const float ZOOM_DELTA = -0.00625f;
+    static const float MIN_ZOOM = DEFAULT_ZOOM * 2;
+    static const float MAX_ZOOM = 0.00125f;
+    switch (e.type)
+    {
+    case sf::Event::KeyPressed:
+        // the view can be moved around while loading, but the map can't be touched //
+        if (!map.isReady() && e.key.code != sf::Keyboard::Escape &&
+            e.key.code != sf::Keyboard::J && e.key.code != sf::Keyboard::K)
+        {
+            break;
+        }
+        switch(e.key.code)
+        {
+        case sf::Keyboard::F1:
+            map.toggleVoxelGrid();
+            break;
+        case sf::Keyboard::F2:
+            map.togglePartitionMeta();
+            break;
+        case sf::Keyboard::F3:
+            showStabilityGraph = !showStabilityGraph;
+            break;
+        case sf::Keyboard::Space:
+            map.togglePause();
+            break;
+        case sf::Keyboard::Escape:
+            renderWindow.close();
+            break;
+        case sf::Keyboard::PageUp:
+            map.moveVisibleSlice(1);
+            break;
+        case sf::Keyboard::PageDown:
+            map.moveVisibleSlice(-1);
+            break;
+        case sf::Keyboard::D:
+            map.toggleTile(renderWindow.mapPixelToCoords(sf::Mouse::getPosition(renderWindow)));
+            break;
+        case sf::Keyboard::J:
+            zoomPercent += ZOOM_DELTA*-1;
+            zoomPercent = clampf(zoomPercent, MAX_ZOOM, MIN_ZOOM);
+            updateViewSize();
+            break;
+        case sf::Keyboard::K:
+            zoomPercent += ZOOM_DELTA*1;
+            zoomPercent = clampf(zoomPercent, MAX_ZOOM, MIN_ZOOM);
+            updateViewSize();
+            break;
+        }
+        break;
+    case sf::Event::MouseButtonPressed:
+        switch (e.mouseButton.button)
+        {
+        case sf::Mouse::Left:
+            mouseHeldLeft = true;
+            mouseLeftClickPosition = { e.mouseButton.x, e.mouseButton.y };
+            break;
+        case sf::Mouse::Right:
+            mouseHeldRight = true;
+            mouseRightClickOrigin = { float(e.mouseButton.x), float(e.mouseButton.y) };
+            mouseRightClickCenterScreen = view.getCenter();
+            break;
+        case sf::Mouse::Middle:
+            zoomPercent = DEFAULT_ZOOM;
+            updateViewSize();
+            break;
+        }
+        break;
+    case sf::Event::MouseButtonReleased:
+        switch (e.mouseButton.button)
+        {
+        case sf::Mouse::Left:
+            mouseHeldLeft = false;
+            break;
+        case sf::Mouse::Right:
+            mouseHeldRight = false;
+            break;
+        }
+        break;
+    case sf::Event::MouseMoved:
+        if (mouseHeldRight)
+        {
+            const sf::Vector2f mousePosF(float(e.mouseMove.x), float(e.mouseMove.y));
+            sf::Vector2f fromClickOrigin = mouseRightClickOrigin - mousePosF;
+            fromClickOrigin.y *= -1.f;// need to invert y because it's inverted in screen-space
+            view.setCenter(mouseRightClickCenterScreen + fromClickOrigin*zoomPercent);
+        }
+        break;
+    case sf::Event::MouseWheelScrolled:
+        {
+            //std::cout << "wheelDelta=" << e.mouseWheelScroll.delta << std::endl;
+            zoomPercent += ZOOM_DELTA*e.mouseWheelScroll.delta;
+            zoomPercent = clampf(zoomPercent, MAX_ZOOM, MIN_ZOOM);
+            updateViewSize();
+        }
+        break;
+    }
+}
+void Application::tick(const sf::Time & deltaTime)
+{
+    renderWindow.setView(view);
+    if (!map.isReady())
+    {
+        if (map.hasLoadFailed())
+        {
+            exit(EXIT_FAILURE);
+        }
+        map.draw(renderWindow);
+        drawOrigin();
+        drawLoadProgress();
+        return;
+    }
+    if (mouseHeldLeft)
+    {
+        map.touch(renderWindow.mapPixelToCoords(mouseLeftClickPosition));
+    }
+    map.setViewBounds(getViewBounds());
+    map.stepSimulation();
+    map.draw(renderWindow);
+    drawOrigin();
+    if (showStabilityGraph)
+    {
+        drawStabilityGraph();
+    }
+}
+void Application::drawOrigin()
+{
+    static const float ORIGIN_LINE_SIZE = 1;
+    // First, we get the boundaries of the world that we're drawing
+    //  so that we can prevent the origin from being drawn off-screen //
+    auto viewCenter = view.getCenter();
+    auto viewSize = view.getSize();
+    viewSize.y *= -1;// need to do this because we invert the view size to fix the y-axis
+    auto viewBottomLeft = viewCenter - viewSize*0.5f;
+    auto viewTopRight = viewBottomLeft + viewSize;
+    sf::Vector2f drawLocation(
+        clampf(viewBottomLeft.x + 1.f/999, 0.f, viewTopRight.x - 1.f/9),
+        clampf(viewBottomLeft.y + 1.f/999, 0.f, viewTopRight.y - 1.f/9));
+    // Finally, we draw the origin graphics //
+    sf::VertexArray va(sf::PrimitiveType::Lines, 4);
+    va[0].position = drawLocation + sf::Vector2f{ 0,0 };
+    va[1].position = drawLocation + sf::Vector2f{ 0,ORIGIN_LINE_SIZE };
+    va[0].color = sf::Color::Green;
+    va[1].color = sf::Color::Green;
+    va[2].position = drawLocation + sf::Vector2f{ 0,0 };
+    va[3].position = drawLocation + sf::Vector2f{ ORIGIN_LINE_SIZE,0 };
+    va[2].color = sf::Color::Red;
+    va[3].color = sf::Color::Red;
+    renderWindow.draw(va);
+}
+void Application::drawLoadProgress()
+{
+    static const float BAR_HEIGHT = 6;
+    float progress = 0;
+    const std::string status = map.getLoadStatus(progress);
+    if (status != loadStatus)
+    {
+        loadStatus = status;
+        std::cout << "loading: " << loadStatus << std::endl;
+    }
+    // drawn in pixels, so it stays put however the view is panned & zoomed //
+    const sf::Vector2f windowSize(renderWindow.getSize());
+    renderWindow.setView(renderWindow.getDefaultView());
+    sf::RectangleShape bar({ windowSize.x*progress, BAR_HEIGHT });
+    bar.setPosition({ 0, windowSize.y - BAR_HEIGHT });
+    bar.setFillColor(sf::Color(0, 255, 255, 192));
+    renderWindow.draw(bar);
+    renderWindow.setView(view);
+}
+void Application::drawStabilityGraph()
+{
+    static const sf::Vector2f GRAPH_SIZE = { 256, 64 };
+    static const float MARGIN = 8;
+    const Map::StabilityMonitor& stability = map.getStability();
+    const auto& history = stability.history;
+    if (history.empty())
+    {
+        return;
+    }
+    // scaled to the samples on show, with anything that isn't finite pinned to the top //
+    double lowest = std::numeric_limits<double>::infinity();
+    double highest = -lowest;
+    for (const auto& sample : history)
+    {
+        if (sample.energy > 0 && std::isfinite(sample.energy))
+        {
+            lowest = std::min(lowest, log10(sample.energy));
+            highest = std::max(highest, log10(sample.energy));
+        }
+    }
+    const double range = std::max(highest - lowest, 1.0);
+    const sf::Vector2f windowSize(renderWindow.getSize());
+    const sf::Vector2f corner(windowSize.x - GRAPH_SIZE.x - MARGIN, windowSize.y - GRAPH_SIZE.y - MARGIN);
+    renderWindow.setView(renderWindow.getDefaultView());
+    sf::RectangleShape background(GRAPH_SIZE);
+    background.setPosition(corner);
+    background.setFillColor(sf::Color(0, 0, 0, 160));
+    // outlined red once the watch has seen the energy run away, & kept so while it's paused //
+    background.setOutlineThickness(1);
+    background.setOutlineColor(stability.diverged ? sf::Color::Red :
+        stability.paused ? sf::Color::Yellow : sf::Color(255, 255, 255, 64));
+    renderWindow.draw(background);
+    sf::VertexArray va(sf::PrimitiveType::LineStrip, history.size());
+    for (size_t s = 0; s < history.size(); s++)
+    {
+        const Map::StabilitySample& sample = history[s];
+        double height = 0;
+        if (!std::isfinite(sample.energy))
+        {
+            height = 1;
+        }
+        else if (sample.energy > 0)
+        {
+            height = (log10(sample.energy) - lowest) / range;
+        }
+        va[s].position = corner + sf::Vector2f(
+            GRAPH_SIZE.x*float(s) / float(std::max(stability.historyLength, size_t(2)) - 1),
+            GRAPH_SIZE.y*float(1 - height));
+        // driven samples are meant to grow, so they're told apart from the undriven ones which do //
+        va[s].color = sample.driven ? sf::Color::Cyan : sample.growthRate > 1 ? sf::Color::Yellow : sf::Color::Green;
+    }
+    renderWindow.draw(va);
+    renderWindow.setView(view);
+}
+void Application::updateViewSize()
+{
+    auto winSize = renderWindow.getSize();
+    // Invert the camera's y-axis //
+    sf::Vector2f newSize(float(winSize.x), winSize.y*-1.f);
+    view.setSize(newSize*zoomPercent);
+}
+sf::FloatRect Application::getViewBounds() const
+{
+    // the view's height is negative to flip the y-axis //
+    const sf::Vector2f viewSize(view.getSize().x, -view.getSize().y);
+    const sf::Vector2f viewBottomLeft = view.getCenter() - viewSize*0.5f;
+    return { viewBottomLeft, viewSize };
 }
\ No newline at end of file
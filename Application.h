@@ -1,25 +1,33 @@
-#pragma once
-#include <SFML/Graphics.hpp>
-#include "Map.h"
-class Application
-{
-private:
-    static const float DEFAULT_ZOOM;
-public:
-    Application(sf::RenderWindow& rw, int argc, char** argv);
-    void onEvent(const sf::Event& e);
-    void tick(const sf::Time& deltaTime);
-private:
-    void drawOrigin();
-    void updateViewSize();
-private:
-    sf::RenderWindow& renderWindow;
-    sf::View view;
-    sf::Vector2i mouseLeftClickPosition;
-    sf::Vector2f mouseRightClickOrigin;
-    sf::Vector2f mouseRightClickCenterScreen;
-    bool mouseHeldLeft;
-    bool mouseHeldRight;
-    float zoomPercent;
-    Map map;
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "Map.h"
+class Application
+{
+private:
+    static const float DEFAULT_ZOOM;
+public:
+    Application(sf::RenderWindow& rw, int argc, char** argv);
+    void onEvent(const sf::Event& e);
+    void tick(const sf::Time& deltaTime);
+private:
+    void drawOrigin();
+    // a bar along the bottom of the window while the map is still loading
+    void drawLoadProgress();
+    // the energy of the last stability samples along the bottom right of the window, on a log scale
+    void drawStabilityGraph();
+    void updateViewSize();
+    sf::FloatRect getViewBounds() const;
+private:
+    sf::RenderWindow& renderWindow;
+    sf::View view;
+    sf::Vector2i mouseLeftClickPosition;
+    sf::Vector2f mouseRightClickOrigin;
+    sf::Vector2f mouseRightClickCenterScreen;
+    bool mouseHeldLeft;
+    bool mouseHeldRight;
+    float zoomPercent;
+    bool showStabilityGraph;
+    // the last load status printed //
+    std::string loadStatus;
+    Map map;
 };
\ No newline at end of file
@@ -0,0 +1,464 @@
+#include "Auralizer.h"
+#include "WavFile.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+namespace
+{
+    const unsigned MIN_BLOCK_SIZE = 512;
+    const unsigned MAX_BLOCK_SIZE = 16384;
+    // the filename without its directory or extension
+    std::string fileStem(const std::string& filename)
+    {
+        const size_t slash = filename.find_last_of("/\\");
+        const std::string name = slash == std::string::npos ? filename : filename.substr(slash + 1);
+        return name.substr(0, name.find_last_of('.'));
+    }
+    bool endsWith(const std::string& text, const std::string& suffix)
+    {
+        return text.size() >= suffix.size() &&
+            std::equal(suffix.rbegin(), suffix.rend(), text.rbegin(),
+                [](char a, char b)->bool { return tolower(a) == tolower(b); });
+    }
+    // fftw only promises the new-array execute functions work on arrays aligned like
+    //  the ones the plan was made with, so every buffer comes from fftw_malloc
+    struct FftwBuffer
+    {
+        explicit FftwBuffer(size_t doubles)
+            :data(fftw_alloc_real(doubles))
+        {
+            std::fill(data, data + doubles, 0.0);
+        }
+        ~FftwBuffer()
+        {
+            fftw_free(data);
+        }
+        fftw_complex* complex()
+        {
+            return reinterpret_cast<fftw_complex*>(data);
+        }
+        double* data;
+    };
+}
+Auralizer::PartitionedResponse::PartitionedResponse()
+    :blockSize(0)
+    ,partitionCount(0)
+    ,length(0)
+{
+}
+Auralizer::TransformPlans::TransformPlans()
+    :forward(nullptr)
+    ,inverse(nullptr)
+{
+}
+Auralizer::Auralizer(int argc, char** argv)
+    :outputDirectory(".")
+    ,threadCount(0)
+    ,blockSize(0)
+{
+    // process our arg list, anything which isn't an option is a dry file //
+    for (int c = 1; c < argc; c++)
+    {
+        if (argv[c] == std::string("-auralize") && c + 1 < argc)
+        {
+            responseFilename = argv[++c];
+        }
+        else if (argv[c] == std::string("-threads") && c + 1 < argc)
+        {
+            threadCount = unsigned(std::max(0, std::stoi(argv[++c])));
+        }
+        else if (argv[c] == std::string("-block") && c + 1 < argc)
+        {
+            blockSize = unsigned(std::max(0, std::stoi(argv[++c])));
+        }
+        else if (argv[c] == std::string("-out") && c + 1 < argc)
+        {
+            outputDirectory = argv[++c];
+        }
+        else
+        {
+            dryFilenames.push_back(argv[c]);
+        }
+    }
+}
+Auralizer::~Auralizer()
+{
+    for (auto& plans : plansByBlockSize)
+    {
+        fftw_destroy_plan(plans.second.forward);
+        fftw_destroy_plan(plans.second.inverse);
+    }
+}
+int Auralizer::run()
+{
+    if (responseFilename.empty())
+    {
+        std::cerr << "ERROR: must specify an impulse response CSV or WAV after \"-auralize\"\n";
+        return EXIT_FAILURE;
+    }
+    if (dryFilenames.empty())
+    {
+        std::cerr << "ERROR: no dry WAV files to auralize\n";
+        return EXIT_FAILURE;
+    }
+    if (blockSize != 0 && (blockSize & (blockSize - 1)) != 0)
+    {
+        std::cerr << "ERROR: \"-block\" must be a power of two\n";
+        return EXIT_FAILURE;
+    }
+    if (!loadResponses(responseFilename))
+    {
+        return EXIT_FAILURE;
+    }
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::cout << "auralizing " << dryFilenames.size() << " files with " << responses.size() <<
+        " responses on " << threadCount << " threads\n";
+    size_t failedFiles = 0;
+    for (const auto& dryFilename : dryFilenames)
+    {
+        WavFile dry;
+        if (!dry.read(dryFilename))
+        {
+            failedFiles++;
+            continue;
+        }
+        const auto& partitionedResponses = responsesAt(dry.sampleRate);
+        for (size_t r = 0; r < responses.size(); r++)
+        {
+            const std::string wetFilename =
+                outputDirectory + "/" + fileStem(dryFilename) + "_" + responses[r].name + ".wav";
+            WavFile wet;
+            wet.sampleRate = dry.sampleRate;
+            convolve(partitionedResponses[r], dry.channels, wet.channels);
+            if (!wet.write(wetFilename))
+            {
+                failedFiles++;
+                continue;
+            }
+            std::cout << "\t" << wetFilename << std::endl;
+        }
+    }
+    return failedFiles == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+bool Auralizer::loadResponses(const std::string & filename)
+{
+    if (!(endsWith(filename, ".wav") ? loadResponseWav(filename) : loadResponseCsv(filename)))
+    {
+        return false;
+    }
+    if (responses.empty() || responses[0].samples.empty())
+    {
+        std::cerr << "ERROR: \"" << filename << "\" has no impulse responses in it\n";
+        return false;
+    }
+    return true;
+}
+bool Auralizer::loadResponseCsv(const std::string & filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "ERROR: could not open \"" << filename << "\"\n";
+        return false;
+    }
+    // the header names each probe column after the time column //
+    std::string line;
+    std::getline(file, line);
+    std::stringstream header(line);
+    std::string column;
+    std::getline(header, column, ',');
+    while (std::getline(header, column, ','))
+    {
+        responses.push_back(Response());
+        responses.back().name = column;
+    }
+    std::vector<double> times;
+    try
+    {
+        while (std::getline(file, line))
+        {
+            if (line.empty())
+            {
+                continue;
+            }
+            std::stringstream row(line);
+            std::getline(row, column, ',');
+            times.push_back(std::stod(column));
+            for (auto& response : responses)
+            {
+                if (!std::getline(row, column, ','))
+                {
+                    std::cerr << "ERROR: row " << times.size() << " of \"" << filename << "\" is missing columns\n";
+                    return false;
+                }
+                response.samples.push_back(std::stod(column));
+            }
+        }
+    }
+    catch (const std::exception&)
+    {
+        std::cerr << "ERROR: row " << times.size() << " of \"" << filename << "\" isn't a number\n";
+        return false;
+    }
+    if (times.size() < 2 || times[1] <= times[0])
+    {
+        std::cerr << "ERROR: can't tell the sample rate of \"" << filename << "\" from its time column\n";
+        return false;
+    }
+    for (auto& response : responses)
+    {
+        response.sampleRate = 1.0 / (times[1] - times[0]);
+    }
+    return true;
+}
+bool Auralizer::loadResponseWav(const std::string & filename)
+{
+    WavFile wav;
+    if (!wav.read(filename))
+    {
+        return false;
+    }
+    for (size_t c = 0; c < wav.channels.size(); c++)
+    {
+        Response response;
+        response.name = fileStem(filename);
+        if (wav.channels.size() > 1)
+        {
+            response.name += "_ch" + std::to_string(c);
+        }
+        response.sampleRate = wav.sampleRate;
+        response.samples.assign(wav.channels[c].begin(), wav.channels[c].end());
+        responses.push_back(response);
+    }
+    return true;
+}
+std::vector<double> Auralizer::resample(const std::vector<double>& samples, double fromRate, unsigned toRate)
+{
+    const double ratio = toRate / fromRate;
+    if (fabs(ratio - 1) < 1e-9)
+    {
+        return samples;
+    }
+    // pad with as much silence again so the tail doesn't wrap around onto the start //
+    const size_t paddedLength = 2 * samples.size();
+    const size_t resampledPaddedLength = std::max(size_t(2), 2 * size_t(samples.size()*ratio + 0.5));
+    const size_t bins = paddedLength / 2 + 1;
+    const size_t resampledBins = resampledPaddedLength / 2 + 1;
+    FftwBuffer padded(paddedLength);
+    FftwBuffer spectrum(2 * bins);
+    FftwBuffer resampledSpectrum(2 * resampledBins);
+    FftwBuffer resampled(resampledPaddedLength);
+    std::copy(samples.begin(), samples.end(), padded.data);
+    fftw_plan forward = fftw_plan_dft_r2c_1d(int(paddedLength), padded.data, spectrum.complex(), FFTW_ESTIMATE);
+    fftw_plan inverse = fftw_plan_dft_c2r_1d(int(resampledPaddedLength),
+        resampledSpectrum.complex(), resampled.data, FFTW_ESTIMATE);
+    fftw_execute(forward);
+    // the bins both rates share carry over, and fftw's gain comes back out //
+    const size_t sharedBins = std::min(bins, resampledBins);
+    for (size_t b = 0; b < sharedBins; b++)
+    {
+        resampledSpectrum.complex()[b][0] = spectrum.complex()[b][0] / paddedLength;
+        resampledSpectrum.complex()[b][1] = spectrum.complex()[b][1] / paddedLength;
+    }
+    // the old nyquist bin is split between its positive & negative frequency once it's
+    //  no longer the highest, while the new one has to be real //
+    if (resampledBins > bins)
+    {
+        resampledSpectrum.complex()[bins - 1][0] *= 0.5;
+        resampledSpectrum.complex()[bins - 1][1] *= 0.5;
+    }
+    else
+    {
+        resampledSpectrum.complex()[resampledBins - 1][1] = 0;
+    }
+    fftw_execute(inverse);
+    fftw_destroy_plan(forward);
+    fftw_destroy_plan(inverse);
+    const size_t resampledLength = std::max(size_t(1), size_t(samples.size()*ratio + 0.5));
+    return std::vector<double>(resampled.data, resampled.data + std::min(resampledLength, resampledPaddedLength));
+}
+const std::vector<Auralizer::PartitionedResponse>& Auralizer::responsesAt(unsigned sampleRate)
+{
+    auto existing = responsesBySampleRate.find(sampleRate);
+    if (existing != responsesBySampleRate.end())
+    {
+        return existing->second;
+    }
+    std::vector<std::vector<double>> resampled;
+    double loudestEnergy = 0;
+    size_t longest = 0;
+    for (const auto& response : responses)
+    {
+        resampled.push_back(resample(response.samples, response.sampleRate, sampleRate));
+        double energy = 0;
+        for (double sample : resampled.back())
+        {
+            energy += sample*sample;
+        }
+        loudestEnergy = std::max(loudestEnergy, energy);
+        longest = std::max(longest, resampled.back().size());
+    }
+    const double gain = loudestEnergy > 0 ? 1 / sqrt(loudestEnergy) : 1;
+    // Each output block costs two transforms of twice the block size, plus one spectrum
+    //  multiply per partition, so about 8 partitions balances the two.
+    //  All of a rate's responses share a block size so they share plans too //
+    unsigned responseBlockSize = blockSize;
+    if (responseBlockSize == 0)
+    {
+        responseBlockSize = MIN_BLOCK_SIZE;
+        while (responseBlockSize < MAX_BLOCK_SIZE && responseBlockSize * 8 < longest)
+        {
+            responseBlockSize *= 2;
+        }
+    }
+    std::vector<PartitionedResponse>& partitionedResponses = responsesBySampleRate[sampleRate];
+    for (auto& samples : resampled)
+    {
+        for (double& sample : samples)
+        {
+            sample *= gain;
+        }
+        partitionedResponses.push_back(partition(samples, responseBlockSize));
+    }
+    std::cout << "responses at " << sampleRate << "Hz: length=" << longest << " blockSize=" << responseBlockSize <<
+        " partitions=" << partitionedResponses[0].partitionCount << "\n";
+    return partitionedResponses;
+}
+Auralizer::PartitionedResponse Auralizer::partition(const std::vector<double>& samples, unsigned blockSize)
+{
+    const TransformPlans& plans = plansFor(blockSize);
+    const size_t bins = blockSize + 1;
+    PartitionedResponse partitioned;
+    partitioned.blockSize = blockSize;
+    partitioned.length = samples.size();
+    partitioned.partitionCount = (samples.size() + blockSize - 1) / blockSize;
+    partitioned.spectra.resize(partitioned.partitionCount * 2 * bins);
+    FftwBuffer block(2 * blockSize);
+    FftwBuffer spectrum(2 * bins);
+    for (size_t p = 0; p < partitioned.partitionCount; p++)
+    {
+        const size_t first = p*blockSize;
+        const size_t last = std::min(first + blockSize, samples.size());
+        std::fill(block.data, block.data + 2 * blockSize, 0.0);
+        std::copy(samples.begin() + first, samples.begin() + last, block.data);
+        fftw_execute_dft_r2c(plans.forward, block.data, spectrum.complex());
+        // folding the inverse transform's gain in here saves a pass over every output block //
+        for (size_t i = 0; i < 2 * bins; i++)
+        {
+            partitioned.spectra[p * 2 * bins + i] = spectrum.data[i] / (2 * blockSize);
+        }
+    }
+    return partitioned;
+}
+const Auralizer::TransformPlans& Auralizer::plansFor(unsigned blockSize)
+{
+    auto existing = plansByBlockSize.find(blockSize);
+    if (existing != plansByBlockSize.end())
+    {
+        return existing->second;
+    }
+    // these get reused for every block of every file, so it's worth measuring for the fastest //
+    FftwBuffer block(2 * blockSize);
+    FftwBuffer spectrum(2 * (blockSize + 1));
+    TransformPlans& plans = plansByBlockSize[blockSize];
+    plans.forward = fftw_plan_dft_r2c_1d(int(2 * blockSize), block.data, spectrum.complex(), FFTW_MEASURE);
+    plans.inverse = fftw_plan_dft_c2r_1d(int(2 * blockSize), spectrum.complex(), block.data, FFTW_MEASURE);
+    return plans;
+}
+void Auralizer::convolve(const PartitionedResponse& response, const std::vector<std::vector<float>>& dry,
+    std::vector<std::vector<float>>& wet)
+{
+    const TransformPlans& plans = plansFor(response.blockSize);
+    const size_t blockSize = response.blockSize;
+    const size_t bins = blockSize + 1;
+    const size_t partitionCount = response.partitionCount;
+    const size_t dryLength = dry.empty() ? 0 : dry[0].size();
+    const size_t wetLength = dryLength + response.length - 1;
+    const size_t blockCount = (wetLength + blockSize - 1) / blockSize;
+    wet.assign(dry.size(), std::vector<float>(wetLength));
+    // Every run of output blocks only needs the partitionCount input blocks before it,
+    //  so runs are independent.  Each one costs partitionCount extra forward transforms
+    //  to fill its delay line, so runs are kept several times longer than that //
+    const size_t targetRuns = size_t(threadCount) * 4;
+    const size_t blocksPerRun = std::max(4 * partitionCount,
+        (blockCount*dry.size() + targetRuns - 1) / targetRuns);
+    const size_t runsPerChannel = (blockCount + blocksPerRun - 1) / blocksPerRun;
+    const size_t runCount = runsPerChannel*dry.size();
+    std::atomic<size_t> nextRun(0);
+    auto worker = [&]()->void
+    {
+        FftwBuffer block(2 * blockSize);
+        FftwBuffer spectrum(2 * bins);
+        FftwBuffer accumulated(2 * bins);
+        // the spectra of the last partitionCount input blocks, oldest overwritten first
+        std::vector<double> delayLine(partitionCount * 2 * bins);
+        std::vector<double> previousTail(blockSize);
+        for (size_t run = nextRun++; run < runCount; run = nextRun++)
+        {
+            const std::vector<float>& input = dry[run / runsPerChannel];
+            std::vector<float>& output = wet[run / runsPerChannel];
+            const ptrdiff_t firstBlock = ptrdiff_t(run % runsPerChannel * blocksPerRun);
+            const ptrdiff_t lastBlock = std::min(firstBlock + ptrdiff_t(blocksPerRun), ptrdiff_t(blockCount));
+            // the block before the run is convolved too, only for the tail it overlaps the run with //
+            for (ptrdiff_t b = firstBlock - ptrdiff_t(partitionCount); b < lastBlock; b++)
+            {
+                std::fill(block.data, block.data + 2 * blockSize, 0.0);
+                if (b >= 0 && size_t(b)*blockSize < dryLength)
+                {
+                    const size_t first = size_t(b)*blockSize;
+                    const size_t last = std::min(first + blockSize, dryLength);
+                    std::copy(input.begin() + first, input.begin() + last, block.data);
+                }
+                fftw_execute_dft_r2c(plans.forward, block.data, spectrum.complex());
+                const size_t slot = size_t(b - firstBlock + ptrdiff_t(partitionCount)) % partitionCount;
+                std::copy(spectrum.data, spectrum.data + 2 * bins, &delayLine[slot * 2 * bins]);
+                if (b < firstBlock - 1)
+                {
+                    continue;
+                }
+                // partition p of the response meets the input block p blocks ago //
+                std::fill(accumulated.data, accumulated.data + 2 * bins, 0.0);
+                for (size_t p = 0; p < partitionCount; p++)
+                {
+                    const double* x = &delayLine[(slot + partitionCount - p) % partitionCount * 2 * bins];
+                    const double* h = &response.spectra[p * 2 * bins];
+                    double* y = accumulated.data;
+                    for (size_t i = 0; i < bins; i++)
+                    {
+                        y[2 * i + 0] += x[2 * i + 0] * h[2 * i + 0] - x[2 * i + 1] * h[2 * i + 1];
+                        y[2 * i + 1] += x[2 * i + 0] * h[2 * i + 1] + x[2 * i + 1] * h[2 * i + 0];
+                    }
+                }
+                fftw_execute_dft_c2r(plans.inverse, accumulated.complex(), block.data);
+                if (b >= firstBlock)
+                {
+                    const size_t first = size_t(b)*blockSize;
+                    const size_t last = std::min(first + blockSize, wetLength);
+                    for (size_t i = first; i < last; i++)
+                    {
+                        output[i] = float(block.data[i - first] + previousTail[i - first]);
+                    }
+                }
+                std::copy(block.data + blockSize, block.data + 2 * blockSize, previousTail.begin());
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < std::min(size_t(threadCount), runCount); t++)
+    {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
\ No newline at end of file
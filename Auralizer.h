@@ -0,0 +1,68 @@
+#pragma once
+#include <fftw3.h>
+#include <map>
+#include <string>
+#include <vector>
+/*
+    Offline auralisation: convolves dry recordings with the impulse responses a batch
+    scenario recorded at its probes, by uniformly partitioned overlap-add FFT convolution.
+    Each response is resampled & transformed once, then reused for every dry file,
+    and every convolution with the same block size shares one pair of fftw plans
+*/
+class Auralizer
+{
+private:
+    struct Response
+    {
+        std::string name;
+        double sampleRate;
+        std::vector<double> samples;
+    };
+    // a response cut into blockSize long pieces, each transformed at twice that length
+    struct PartitionedResponse
+    {
+        PartitionedResponse();
+        unsigned blockSize;
+        size_t partitionCount;
+        size_t length;
+        // blockSize + 1 complex bins per partition, already divided by fftw's 2*blockSize gain
+        std::vector<double> spectra;
+    };
+    struct TransformPlans
+    {
+        TransformPlans();
+        fftw_plan forward;
+        fftw_plan inverse;
+    };
+public:
+    Auralizer(int argc, char** argv);
+    ~Auralizer();
+    // returns EXIT_SUCCESS only if every dry file was convolved with every response & written
+    int run();
+private:
+    // a batch runner CSV gives one response per probe column, a WAV one per channel
+    bool loadResponses(const std::string& filename);
+    bool loadResponseCsv(const std::string& filename);
+    bool loadResponseWav(const std::string& filename);
+    // band-limited resampling by zero padding or truncating the spectrum
+    static std::vector<double> resample(const std::vector<double>& samples, double fromRate, unsigned toRate);
+    // every response at the given rate, scaled together so the loudest carries unit energy
+    //  & the rest keep their level relative to it.  Made the first time a rate is needed
+    const std::vector<PartitionedResponse>& responsesAt(unsigned sampleRate);
+    PartitionedResponse partition(const std::vector<double>& samples, unsigned blockSize);
+    // made the first time a block size is needed; planning isn't thread safe, so only call from run()
+    const TransformPlans& plansFor(unsigned blockSize);
+    // wet = dry convolved with the response, every channel & run of blocks on its own worker
+    void convolve(const PartitionedResponse& response, const std::vector<std::vector<float>>& dry,
+        std::vector<std::vector<float>>& wet);
+private:
+    std::string responseFilename;
+    std::vector<std::string> dryFilenames;
+    std::string outputDirectory;
+    unsigned threadCount;
+    // 0 picks one from each response's length
+    unsigned blockSize;
+    std::vector<Response> responses;
+    std::map<unsigned, std::vector<PartitionedResponse>> responsesBySampleRate;
+    std::map<unsigned, TransformPlans> plansByBlockSize;
+};
\ No newline at end of file
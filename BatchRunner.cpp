@@ -0,0 +1,456 @@
+#include "BatchRunner.h"
+#include "toolbox.h"
+#include "ThreadPlacement.h"
+#include <nlohmann\json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <thread>
+using json = nlohmann::json;
+BatchRunner::BatchRunner(int argc, char** argv)
+    :threadCount(0)
+    ,haloName("sfml-wave-sim-halo")
+    ,useMpi(false)
+    ,pinThreads(false)
+{
+    // process our arg list //
+    for (int c = 1; c < argc; c++)
+    {
+        if (argv[c] == std::string("-map") && c + 1 < argc)
+        {
+            mapFilename = argv[++c];
+        }
+        else if (argv[c] == std::string("-batch") && c + 1 < argc)
+        {
+            jobFilename = argv[++c];
+        }
+        else if (argv[c] == std::string("-threads") && c + 1 < argc)
+        {
+            threadCount = unsigned(std::max(0, std::stoi(argv[++c])));
+        }
+        else if (argv[c] == std::string("-3d"))
+        {
+            mapOptions.volumetric = true;
+        }
+        else if (argv[c] == std::string("-regionsize") && c + 1 < argc)
+        {
+            mapOptions.regionTiles = unsigned(std::max(1, std::stoi(argv[++c])));
+        }
+        else if (argv[c] == std::string("-quality") && c + 1 < argc)
+        {
+            if (!mapOptions.setQuality(argv[++c]))
+            {
+                std::cerr << "ERROR: unknown quality \"" << argv[c] << "\", use preview, balanced or final\n";
+            }
+        }
+        else if (argv[c] == std::string("-maxhz") && c + 1 < argc)
+        {
+            mapOptions.maximumSoundHz = std::stof(argv[++c]);
+        }
+        else if (argv[c] == std::string("-budget") && c + 1 < argc)
+        {
+            if (!mapOptions.setMemoryBudget(argv[++c]))
+            {
+                std::cerr << "ERROR: can't make out a memory budget from \"" << argv[c] << "\", use eg. 512M or 2G\n";
+            }
+        }
+        else if (argv[c] == std::string("-ranks") && c + 1 < argc)
+        {
+            mapOptions.rankCount = unsigned(std::max(1, std::stoi(argv[++c])));
+        }
+        else if (argv[c] == std::string("-rank") && c + 1 < argc)
+        {
+            mapOptions.rank = unsigned(std::max(0, std::stoi(argv[++c])));
+        }
+        else if (argv[c] == std::string("-halo") && c + 1 < argc)
+        {
+            haloName = argv[++c];
+        }
+        else if (argv[c] == std::string("-mpi"))
+        {
+            useMpi = true;
+        }
+        else if (argv[c] == std::string("-pin"))
+        {
+            pinThreads = true;
+        }
+        else if (argv[c] == std::string("-watch") && c + 1 < argc)
+        {
+            stabilityWatch.sampleInterval = unsigned(std::max(0, std::stoi(argv[++c])));
+        }
+        else if (argv[c] == std::string("-watchratio") && c + 1 < argc)
+        {
+            stabilityWatch.divergentEnergyRatio = std::stod(argv[++c]);
+        }
+        else if (argv[c] == std::string("-ondiverge") && c + 1 < argc)
+        {
+            // any of log, pause & dump, separated by commas //
+            const std::string actions = argv[++c];
+            stabilityWatch.actions = 0;
+            for (size_t start = 0; start <= actions.size();)
+            {
+                const size_t end = std::min(actions.find(',', start), actions.size());
+                const std::string action = actions.substr(start, end - start);
+                if (action == "log")
+                {
+                    stabilityWatch.actions |= Map::StabilityMonitor::LOG;
+                }
+                else if (action == "pause")
+                {
+                    stabilityWatch.actions |= Map::StabilityMonitor::PAUSE;
+                }
+                else if (action == "dump")
+                {
+                    stabilityWatch.actions |= Map::StabilityMonitor::DUMP_CHECKPOINT;
+                }
+                else
+                {
+                    std::cerr << "ERROR: unknown divergence action \"" << action << "\", use log, pause or dump\n";
+                }
+                start = end + 1;
+            }
+        }
+    }
+}
+int BatchRunner::run()
+{
+    if (mapFilename.empty())
+    {
+        std::cerr << "ERROR: no map loaded! use -map \"filename\" to specify a Tiled JSON map.\n";
+        return EXIT_FAILURE;
+    }
+    if (jobFilename.empty())
+    {
+        std::cerr << "ERROR: must specify job filename after \"-batch\"\n";
+        return EXIT_FAILURE;
+    }
+    if (!loadJobFile(jobFilename))
+    {
+        return EXIT_FAILURE;
+    }
+    if (useMpi)
+    {
+#ifdef USE_MPI
+        transport.reset(new MpiHaloTransport());
+        mapOptions.rank = transport->getRank();
+        mapOptions.rankCount = transport->getRankCount();
+#else
+        std::cerr << "ERROR: \"-mpi\" needs a build with USE_MPI defined\n";
+        return EXIT_FAILURE;
+#endif
+    }
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // every rank has to step the same scenario at the same time //
+    if (mapOptions.rankCount > 1)
+    {
+        threadCount = 1;
+    }
+    threadCount = std::min(threadCount, unsigned(jobs.size()));
+    // each thread's scenario holds its own wave state, which the map plans its resolution around //
+    mapOptions.concurrentScenarios = threadCount;
+    // the expensive part: parsing happens once, and each region is decomposed &
+    //  planned when the first scenario reaches it, then shared by all of them //
+    if (!map.load(mapFilename, mapOptions))
+    {
+        return EXIT_FAILURE;
+    }
+    if (mapOptions.rankCount > 1 && !transport)
+    {
+        // a slot has to hold a whole step's halo strips, plus whatever probes rank 0 is waiting on //
+        size_t maxProbes = 0;
+        for (const auto& job : jobs)
+        {
+            maxProbes = std::max(maxProbes, job.probeLocations.size());
+        }
+        std::unique_ptr<SharedMemoryHaloTransport> sharedMemoryTransport(new SharedMemoryHaloTransport());
+        if (!sharedMemoryTransport->open(haloName, mapOptions.rank, mapOptions.rankCount,
+            map.maxHaloPayload() + maxProbes))
+        {
+            return EXIT_FAILURE;
+        }
+        transport = std::move(sharedMemoryTransport);
+    }
+    std::cout << "running " << jobs.size() << " scenarios on " << threadCount << " threads\n";
+    std::atomic<size_t> nextJob(0);
+    std::atomic<size_t> failedJobs(0);
+    std::mutex coutMutex;
+    // Scenarios allocate & zero their wave state on the worker which steps them,
+    //  so once that worker stays on one core the state stays on its node.
+    //  Ranks sharing a machine each take their own core, the same way //
+    auto worker = [&](unsigned workerIndex)->void
+    {
+        std::unique_ptr<Placement> placement;
+        if (pinThreads)
+        {
+            const unsigned cpu = ThreadPlacement::cpuForWorker(workerIndex);
+            if (ThreadPlacement::pinCurrentThread(cpu))
+            {
+                placement.reset(new Placement(cpu, ThreadPlacement::nodeOfCpu(cpu)));
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock(coutMutex);
+                std::cerr << "ERROR: could not pin worker " << workerIndex << " to cpu " << cpu << "\n";
+            }
+        }
+        for (size_t j = nextJob++; j < jobs.size(); j = nextJob++)
+        {
+            const bool success = runJob(jobs[j], placement.get());
+            if (!success)
+            {
+                failedJobs++;
+            }
+            std::lock_guard<std::mutex> lock(coutMutex);
+            std::cout << "\tscenario \"" << jobs[j].name << "\" " <<
+                (success ? "finished" : "FAILED");
+            if (placement)
+            {
+                std::cout << " on cpu " << placement->cpu << " (node " << placement->node << "): ";
+                if (placement->unknownPages == placement->statePages)
+                {
+                    std::cout << "state page placement unknown";
+                }
+                else
+                {
+                    std::cout << placement->localPages << "/" <<
+                        placement->statePages - placement->unknownPages << " state pages node-local";
+                }
+            }
+            std::cout << std::endl;
+        }
+    };
+    if (pinThreads)
+    {
+        std::cout << "pinning workers across " << ThreadPlacement::nodeCount() << " NUMA nodes\n";
+    }
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back(worker, mapOptions.rankCount > 1 ? mapOptions.rank : t);
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    return failedJobs == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+bool BatchRunner::loadJobFile(const std::string & jobFilename)
+{
+    std::ifstream fileJobs(jobFilename);
+    if (!fileJobs.is_open())
+    {
+        std::cerr << "ERROR: could not open \"" << jobFilename << "\"\n";
+        return false;
+    }
+    // positions are [x,y] or [x,y,z], with z measured up from the floor of a volumetric map //
+    auto toLocation = [](const json& jsonLocation)->sf::Vector3f
+    {
+        return { jsonLocation[0].get<float>(), jsonLocation[1].get<float>(),
+            jsonLocation.size() > 2 ? jsonLocation[2].get<float>() : 0.f };
+    };
+    json jsonJobs;
+    try
+    {
+        fileJobs >> jsonJobs;
+        for (const auto& jsonJob : jsonJobs["scenarios"])
+        {
+            Job job;
+            job.name = jsonJob["name"].get<std::string>();
+            job.sourceLocation = toLocation(jsonJob["source"]);
+            const std::string signal = jsonJob.value("signal", std::string("click"));
+            if (signal == "click")
+            {
+                job.sourceType = Map::PointSource::Type::CLICK;
+            }
+            else if (signal == "gaussian")
+            {
+                job.sourceType = Map::PointSource::Type::GAUSIAN_PULSE;
+            }
+            else if (signal.size() > 4 && (signal.substr(signal.size() - 4) == ".wav" ||
+                signal.substr(signal.size() - 4) == ".WAV"))
+            {
+                job.sourceType = Map::PointSource::Type::WAV_FILE;
+                job.signalFilename = signal;
+            }
+            else
+            {
+                std::cerr << "ERROR: unknown signal \"" << signal << "\" in scenario \"" << job.name << "\"\n";
+                return false;
+            }
+            // 0 for a single step, since the step isn't known until the map has planned its resolution //
+            job.sourceSeconds = jsonJob.value("signalSeconds", 0.f);
+            job.durationSeconds = jsonJob["duration"].get<float>();
+            for (const auto& jsonProbe : jsonJob["probes"])
+            {
+                job.probeLocations.push_back(toLocation(jsonProbe));
+            }
+            job.outputFilename = jsonJob.value("output", job.name + ".csv");
+            jobs.push_back(job);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "ERROR: malformed job file \"" << jobFilename << "\": " << e.what() << "\n";
+        return false;
+    }
+    if (jobs.empty())
+    {
+        std::cerr << "ERROR: job file \"" << jobFilename << "\" has no scenarios\n";
+        return false;
+    }
+    return true;
+}
+bool BatchRunner::runJob(const Job & job, Placement* placement)
+{
+    Map::Scenario scenario = map.createScenario();
+    // nothing but the probes is ever read back //
+    scenario.prunePressures = true;
+    scenario.stability = stabilityWatch;
+    scenario.stability.checkpointFilename = job.outputFilename + ".wsck";
+    Map::StateIndex stateIndex;
+    if (!map.findStateIndex(job.sourceLocation, stateIndex))
+    {
+        std::cerr << "ERROR: source of scenario \"" << job.name << "\" is outside the simulation\n";
+        return false;
+    }
+    std::shared_ptr<SignalStream> signal;
+    if (job.sourceType == Map::PointSource::Type::WAV_FILE)
+    {
+        signal = std::make_shared<SignalStream>();
+        if (!signal->open(job.signalFilename, map.getSimDeltaTime(), map.getMaximumSoundHz()))
+        {
+            map.releaseScenario(scenario);
+            return false;
+        }
+        scenario.pointSources.push_back({ map, stateIndex, signal });
+    }
+    else
+    {
+        scenario.pointSources.push_back({ map, stateIndex,
+            job.sourceSeconds > 0 ? job.sourceSeconds : map.getSimDeltaTime(), job.sourceType });
+    }
+    for (const auto& probeLocation : job.probeLocations)
+    {
+        if (!map.findStateIndex(probeLocation, stateIndex))
+        {
+            std::cerr << "ERROR: probe " << probeLocation << " of scenario \"" << job.name << 
+                "\" is outside the simulation\n";
+            return false;
+        }
+        scenario.probes.push_back(stateIndex);
+    }
+    const size_t steps = size_t(job.durationSeconds / map.getSimDeltaTime());
+    for (auto& probe : scenario.probes)
+    {
+        probe.pressures.reserve(steps);
+    }
+    for (size_t s = 0; s < steps; s++)
+    {
+        map.streamScenario(scenario);
+        if (!map.stepScenario(scenario, transport.get()))
+        {
+            std::cerr << "ERROR: halo exchange failed in scenario \"" << job.name << "\"\n";
+            map.releaseScenario(scenario);
+            return false;
+        }
+        if (scenario.stability.paused)
+        {
+            std::cerr << "ERROR: scenario \"" << job.name << "\" diverged, giving up on it after " <<
+                scenario.stepCount << " steps\n";
+            map.releaseScenario(scenario);
+            return false;
+        }
+    }
+    if (signal && signal->getUnderruns() > 0)
+    {
+        std::cerr << "WARNING: scenario \"" << job.name << "\" outran its signal's loader, which came " <<
+            signal->getUnderruns() << " steps late\n";
+    }
+    if (placement)
+    {
+        measurePlacement(scenario, *placement);
+    }
+    map.releaseScenario(scenario);
+    // the probes from every rank end up on rank 0 //
+    if (mapOptions.rank != 0)
+    {
+        return true;
+    }
+    // write each probe as a column, one row per step //
+    std::ofstream fileOutput(job.outputFilename);
+    if (!fileOutput.is_open())
+    {
+        std::cerr << "ERROR: could not open \"" << job.outputFilename << "\"\n";
+        return false;
+    }
+    fileOutput << "time";
+    for (size_t p = 0; p < scenario.probes.size(); p++)
+    {
+        fileOutput << ",probe" << p;
+    }
+    fileOutput << "\n";
+    for (size_t s = 0; s < steps; s++)
+    {
+        fileOutput << (s + 1)*map.getSimDeltaTime();
+        for (const auto& probe : scenario.probes)
+        {
+            fileOutput << "," << probe.pressures[s];
+        }
+        fileOutput << "\n";
+    }
+    return true;
+}
+void BatchRunner::measurePlacement(const Map::Scenario & scenario, Placement & placement)
+{
+    placement.localPages = 0;
+    placement.unknownPages = 0;
+    placement.statePages = 0;
+    const size_t pageSize = ThreadPlacement::pageSize();
+    auto measureArray = [&](const double* values, size_t count)->void
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        const uintptr_t first = uintptr_t(values) & ~uintptr_t(pageSize - 1);
+        const uintptr_t last = uintptr_t(values + count - 1);
+        for (uintptr_t page = first; page <= last; page += pageSize)
+        {
+            const int node = ThreadPlacement::nodeOfAddress(reinterpret_cast<const void*>(page));
+            placement.statePages++;
+            if (node < 0)
+            {
+                placement.unknownPages++;
+            }
+            else if (node == placement.node)
+            {
+                placement.localPages++;
+            }
+        }
+    };
+    for (const auto& regionState : scenario.regions)
+    {
+        if (!regionState.isActive())
+        {
+            continue;
+        }
+        measureArray(regionState.voxelModes, regionState.stateSize);
+        measureArray(regionState.voxelModesPrevious, regionState.stateSize);
+        measureArray(regionState.voxelForcingTerms, regionState.stateSize);
+        measureArray(regionState.voxelPressures, regionState.stateSize);
+        measureArray(regionState.ghostPressures.data(), regionState.ghostPressures.size());
+    }
+}
+BatchRunner::Placement::Placement(unsigned cpu, int node)
+    :cpu(cpu)
+    ,node(node)
+    ,localPages(0)
+    ,unknownPages(0)
+    ,statePages(0)
+{
+}
\ No newline at end of file
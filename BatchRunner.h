@@ -0,0 +1,61 @@
+#pragma once
+#include "Map.h"
+#include "HaloTransport.h"
+#include <memory>
+#include <string>
+#include <vector>
+/*
+    Headless runner which loads & decomposes a map once,
+    then steps many independent scenarios from a json job file across all cores.
+    Several of these can also split one map's regions between them, one process per rank
+*/
+class BatchRunner
+{
+private:
+    struct Job
+    {
+        std::string name;
+        sf::Vector3f sourceLocation;
+        Map::PointSource::Type sourceType;
+        float sourceSeconds;
+        // WAV_FILE sources stream this in, each scenario its own copy
+        std::string signalFilename;
+        float durationSeconds;
+        std::vector<sf::Vector3f> probeLocations;
+        std::string outputFilename;
+    };
+    // where a pinned worker ran a scenario, & where that scenario's wave state ended up
+    struct Placement
+    {
+        Placement(unsigned cpu = 0, int node = 0);
+        unsigned cpu;
+        int node;
+        size_t localPages;
+        size_t unknownPages;
+        size_t statePages;
+    };
+public:
+    BatchRunner(int argc, char** argv);
+    // returns EXIT_SUCCESS only if every scenario ran & wrote its probe outputs
+    int run();
+private:
+    bool loadJobFile(const std::string& jobFilename);
+    // placement is only measured for pinned workers, so it can be nullptr
+    bool runJob(const Job& job, Placement* placement);
+    static void measurePlacement(const Map::Scenario& scenario, Placement& placement);
+private:
+    std::string mapFilename;
+    std::string jobFilename;
+    unsigned threadCount;
+    Map::LoadOptions mapOptions;
+    // name of the shared memory segment local ranks exchange halos through //
+    std::string haloName;
+    bool useMpi;
+    // pin each worker to its own core & report how much of its state is node-local
+    bool pinThreads;
+    // how every scenario watches its own energy; pausing gives up on a scenario which diverges //
+    Map::StabilityMonitor stabilityWatch;
+    std::unique_ptr<HaloTransport> transport;
+    std::vector<Job> jobs;
+    Map map;
+};
\ No newline at end of file
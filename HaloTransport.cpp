@@ -0,0 +1,244 @@
+#include "HaloTransport.h"
+#include <iostream>
+#include <thread>
+#include <cstring>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+HaloTransport::~HaloTransport()
+{
+}
+SharedMemoryHaloTransport::SharedMemoryHaloTransport()
+    :rank(0)
+    ,rankCount(1)
+    ,slotCapacity(0)
+    ,parity(0)
+    ,segmentSize(0)
+    ,segment(nullptr)
+    ,mappingHandle(nullptr)
+{
+}
+SharedMemoryHaloTransport::~SharedMemoryHaloTransport()
+{
+    close();
+}
+bool SharedMemoryHaloTransport::open(const std::string& name, unsigned rank, unsigned rankCount, size_t slotCapacity)
+{
+    close();
+    if (rankCount < 1 || rank >= rankCount)
+    {
+        std::cerr << "ERROR: invalid rank " << rank << " of " << rankCount << "\n";
+        return false;
+    }
+    this->name = name;
+    this->rank = rank;
+    this->rankCount = rankCount;
+    this->slotCapacity = slotCapacity;
+    parity = 0;
+    // header, then [parity][fromRank][toRank] slots of { payload size, payload... } //
+    const size_t slotCount = 2 * size_t(rankCount)*rankCount;
+    segmentSize = sizeof(double) + slotCount*(1 + slotCapacity)*sizeof(double);
+    static_assert(sizeof(Header) <= sizeof(double), "Header must fit before the first slot");
+#ifdef _WIN32
+    const std::string mappingName = "Local\\" + name;
+    HANDLE handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        DWORD(uint64_t(segmentSize) >> 32), DWORD(segmentSize & 0xFFFFFFFF), mappingName.c_str());
+    if (!handle)
+    {
+        std::cerr << "ERROR: could not create shared memory '" << name << "'\n";
+        return false;
+    }
+    segment = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, segmentSize);
+    if (!segment)
+    {
+        std::cerr << "ERROR: could not map shared memory '" << name << "'\n";
+        CloseHandle(handle);
+        return false;
+    }
+    mappingHandle = handle;
+#else
+    const std::string mappingName = "/" + name;
+    const int fd = shm_open(mappingName.c_str(), O_CREAT | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        std::cerr << "ERROR: could not create shared memory '" << name << "'\n";
+        return false;
+    }
+    // every rank sizes it the same, so it doesn't matter who gets here first.
+    //  The freshly grown pages read as zero, which is also a valid idle Header
+    if (ftruncate(fd, off_t(segmentSize)) != 0)
+    {
+        std::cerr << "ERROR: could not size shared memory '" << name << "'\n";
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        std::cerr << "ERROR: could not map shared memory '" << name << "'\n";
+        return false;
+    }
+    segment = mapped;
+#endif
+    // nobody goes near the slots until every rank has the segment mapped //
+    waitForAllRanks();
+    return true;
+}
+void SharedMemoryHaloTransport::close()
+{
+    if (!segment)
+    {
+        return;
+    }
+    // don't pull the segment out from under ranks still reading this step //
+    waitForAllRanks();
+#ifdef _WIN32
+    UnmapViewOfFile(segment);
+    CloseHandle(HANDLE(mappingHandle));
+#else
+    munmap(segment, segmentSize);
+    if (rank == 0)
+    {
+        shm_unlink(("/" + name).c_str());
+    }
+#endif
+    segment = nullptr;
+    mappingHandle = nullptr;
+}
+unsigned SharedMemoryHaloTransport::getRank() const
+{
+    return rank;
+}
+unsigned SharedMemoryHaloTransport::getRankCount() const
+{
+    return rankCount;
+}
+double* SharedMemoryHaloTransport::slot(unsigned parity, unsigned fromRank, unsigned toRank)
+{
+    const size_t slotIndex = (size_t(parity)*rankCount + fromRank)*rankCount + toRank;
+    return reinterpret_cast<double*>(segment) + 1 + slotIndex*(1 + slotCapacity);
+}
+void SharedMemoryHaloTransport::waitForAllRanks()
+{
+    Header* header = reinterpret_cast<Header*>(segment);
+    const unsigned generation = header->generation.load(std::memory_order_acquire);
+    if (header->arrivedRanks.fetch_add(1, std::memory_order_acq_rel) + 1 == rankCount)
+    {
+        header->arrivedRanks.store(0, std::memory_order_relaxed);
+        header->generation.fetch_add(1, std::memory_order_acq_rel);
+        return;
+    }
+    while (header->generation.load(std::memory_order_acquire) == generation)
+    {
+        std::this_thread::yield();
+    }
+}
+bool SharedMemoryHaloTransport::exchange(const std::vector<std::vector<double>>& outgoing,
+    std::vector<std::vector<double>>& incoming)
+{
+    if (!segment)
+    {
+        return false;
+    }
+    for (unsigned peer = 0; peer < rankCount; peer++)
+    {
+        if (peer == rank)
+        {
+            continue;
+        }
+        if (outgoing[peer].size() > slotCapacity)
+        {
+            std::cerr << "ERROR: halo payload of " << outgoing[peer].size() <<
+                " exceeds the shared memory slot capacity of " << slotCapacity << "\n";
+            return false;
+        }
+        double* destination = slot(parity, rank, peer);
+        destination[0] = double(outgoing[peer].size());
+        if (!outgoing[peer].empty())
+        {
+            memcpy(destination + 1, outgoing[peer].data(), outgoing[peer].size()*sizeof(double));
+        }
+    }
+    waitForAllRanks();
+    for (unsigned peer = 0; peer < rankCount; peer++)
+    {
+        if (peer == rank)
+        {
+            continue;
+        }
+        const double* source = slot(parity, peer, rank);
+        const size_t size = size_t(source[0]);
+        if (size != incoming[peer].size())
+        {
+            std::cerr << "ERROR: expected " << incoming[peer].size() << " halo values from rank " <<
+                peer << " but received " << size << "\n";
+            return false;
+        }
+        if (size > 0)
+        {
+            memcpy(incoming[peer].data(), source + 1, size*sizeof(double));
+        }
+    }
+    parity ^= 1;
+    return true;
+}
+#ifdef USE_MPI
+MpiHaloTransport::MpiHaloTransport()
+    :rank(0)
+    ,rankCount(1)
+{
+    MPI_Init(nullptr, nullptr);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &rankCount);
+}
+MpiHaloTransport::~MpiHaloTransport()
+{
+    MPI_Finalize();
+}
+unsigned MpiHaloTransport::getRank() const
+{
+    return unsigned(rank);
+}
+unsigned MpiHaloTransport::getRankCount() const
+{
+    return unsigned(rankCount);
+}
+bool MpiHaloTransport::exchange(const std::vector<std::vector<double>>& outgoing,
+    std::vector<std::vector<double>>& incoming)
+{
+    std::vector<MPI_Request> requests;
+    for (int peer = 0; peer < rankCount; peer++)
+    {
+        // ranks sharing no region edge have nothing to say to each other //
+        if (peer == rank || incoming[peer].empty())
+        {
+            continue;
+        }
+        requests.push_back(MPI_Request());
+        MPI_Irecv(incoming[peer].data(), int(incoming[peer].size()), MPI_DOUBLE, peer, 0,
+            MPI_COMM_WORLD, &requests.back());
+    }
+    for (int peer = 0; peer < rankCount; peer++)
+    {
+        if (peer == rank || outgoing[peer].empty())
+        {
+            continue;
+        }
+        requests.push_back(MPI_Request());
+        MPI_Isend(const_cast<double*>(outgoing[peer].data()), int(outgoing[peer].size()), MPI_DOUBLE,
+            peer, 0, MPI_COMM_WORLD, &requests.back());
+    }
+    return MPI_Waitall(int(requests.size()), requests.data(), MPI_STATUSES_IGNORE) == MPI_SUCCESS;
+}
+#endif
\ No newline at end of file
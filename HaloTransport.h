@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <vector>
+/*
+    Moves the halo strips along region edges between the processes (ranks)
+    splitting up one simulation.  Every rank calls exchange once per step,
+    and nobody gets past it until every rank has sent its data for that step
+*/
+class HaloTransport
+{
+public:
+    virtual ~HaloTransport();
+    virtual unsigned getRank() const = 0;
+    virtual unsigned getRankCount() const = 0;
+    // sends outgoing[peer] to every other rank & receives incoming[peer] from each of them.
+    //  Both are indexed by rank, and the caller sizes incoming to match what each peer sends
+    virtual bool exchange(const std::vector<std::vector<double>>& outgoing,
+        std::vector<std::vector<double>>& incoming) = 0;
+};
+// Ranks on the same machine, each reading the others' slots in one named shared memory segment
+class SharedMemoryHaloTransport : public HaloTransport
+{
+private:
+    struct Header
+    {
+        std::atomic<unsigned> arrivedRanks;
+        std::atomic<unsigned> generation;
+    };
+public:
+    SharedMemoryHaloTransport();
+    ~SharedMemoryHaloTransport();
+    // every rank must open the same name with the same rankCount & slotCapacity.
+    //  slotCapacity is the most doubles one rank ever sends another in a single step
+    bool open(const std::string& name, unsigned rank, unsigned rankCount, size_t slotCapacity);
+    unsigned getRank() const override;
+    unsigned getRankCount() const override;
+    bool exchange(const std::vector<std::vector<double>>& outgoing,
+        std::vector<std::vector<double>>& incoming) override;
+private:
+    double* slot(unsigned parity, unsigned fromRank, unsigned toRank);
+    void waitForAllRanks();
+    void close();
+private:
+    std::string name;
+    unsigned rank;
+    unsigned rankCount;
+    size_t slotCapacity;
+    // steps alternate between two sets of slots, so a rank which races ahead
+    //  never overwrites what a slower one is still reading
+    unsigned parity;
+    size_t segmentSize;
+    void* segment;
+    void* mappingHandle;
+};
+#ifdef USE_MPI
+// Ranks anywhere on a cluster, one message per neighboring rank per step
+class MpiHaloTransport : public HaloTransport
+{
+public:
+    MpiHaloTransport();
+    ~MpiHaloTransport();
+    unsigned getRank() const override;
+    unsigned getRankCount() const override;
+    bool exchange(const std::vector<std::vector<double>>& outgoing,
+        std::vector<std::vector<double>>& incoming) override;
+private:
+    int rank;
+    int rankCount;
+};
+#endif
\ No newline at end of file
@@ -1,818 +1,3857 @@
-#include "Map.h"
-#include "toolbox.h"
-const float Map::SOUND_SPEED_METERS_PER_SECOND = 340;
-const float Map::MAXIMUM_SOUND_HZ = 2000;
-const float Map::SIM_VOXEL_SPACING = SOUND_SPEED_METERS_PER_SECOND/(2*MAXIMUM_SOUND_HZ);
-const float Map::SIM_DELTA_TIME = SIM_VOXEL_SPACING/(SOUND_SPEED_METERS_PER_SECOND*sqrtf(3));
-Map::Map()
-    :m_showVoxelGrid(false)
-    ,m_showPartitionMeta(false)
-{
-}
-Map::~Map()
-{
-    nullify();
-}
-bool Map::load(const std::string & jsonMapFilename)
-{
-    nullify();
-    if (!loadJsonMap(jsonMapFilename))
-    {
-        return false;
-    }
-    if (!loadTileset(jsonMapFilename))
-    {
-        return false;
-    }
-    buildMapTileVBO();
-    buildVoxelGridVBO();
-    buildVoxelPressureVBO();
-    decomposeVoxelsIntoPartitions();
-    buildPartitionVBO();
-    calculatePartitionInterfaces();
-    buildInterfaceVBO();
-    return true;
-}
-void Map::draw(sf::RenderTarget & rt)
-{
-    rt.draw(vaTiles, sf::RenderStates(&texTileset));
-    if (m_showVoxelGrid)
-    {
-        rt.draw(vaSimGridLines);
-    }
-    if (m_showPartitionMeta)
-    {
-        rt.draw(vaSimPartitions);
-        rt.draw(vaSimPartitionInterfaces);
-        /// TODO: draw a line from each partition to its neighbor via partitionIndexOther
-        /// so I can actually tell where the fuck they are actually going to read data from
-    }
-    rt.draw(vaSimGridPressures);
-}
-void Map::stepSimulation()
-{
-    // Update modes within each partition using equation (8) //
-    for (auto& partition : partitions)
-    {
-        for (size_t y = 0; y < partition.voxelLengthY; y++)
-        {
-            for (size_t x = 0; x < partition.voxelLengthX; x++)
-            {
-                const size_t i = y*partition.voxelLengthX + x;
-                // first, we need to calculate omega[i] //
-                ///TODO: precompute these terms
-                ///TODO: use world-space to compute "k" instead of local index space?..
-                /// (does it even actually matter?..)
-                const double k_i_2 = pow(PI, 2)*
-                    (pow(x + 1,2)/pow(partition.voxelLengthX,2) +
-                     pow(y + 1,2)/pow(partition.voxelLengthY,2));
-                const double k_i = sqrt(k_i_2);
-                const double omega_i = SOUND_SPEED_METERS_PER_SECOND*k_i;
-                // then, accumulate the modal terms //
-                ///TODO: pecompute the cosTerms as well
-                const double cosTerm = cos(omega_i*SIM_DELTA_TIME);
-                const double currMode = partition.voxelModes[i];
-                const double forcingModalComponent =
-                    (2 * partition.voxelForcingTerms[i] / pow(omega_i, 2))*(1 - cosTerm);
-                assert(!_isnan(currMode));
-                // Equation (8):
-                partition.voxelModes[i] =
-                    2 * currMode*cosTerm -
-                    partition.voxelModesPrevious[i] +
-                    ///TODO: figure out why this is fucked probably?
-                    (omega_i > 0 ? forcingModalComponent : 0);//some bullshit right here
-                assert(!_isnan(partition.voxelModes[i]));
-                partition.voxelModesPrevious[i] = currMode;
-            }
-        }
-    }
-    // Transform modes to pressure values via IDCT //
-    for (auto& partition : partitions)
-    {
-        fftw_execute(partition.planModeToPressure);
-        // normalize the iDCT result by dividing each cell by 2*size //
-        ///TODO: figure out if I even need this???
-        const double normalization = 2*sqrt(partition.voxelLengthY * partition.voxelLengthX);
-        //const double normalization = 2*partition.voxelLengthY * 2*partition.voxelLengthX;
-        for (size_t y = 0; y < partition.voxelLengthY; y++)
-        {
-            for (size_t x = 0; x < partition.voxelLengthX; x++)
-            {
-                const size_t i = y*partition.voxelLengthX + x;
-                partition.voxelPressures[i] /= normalization;
-                ///DEBUG
-                if (partition.ps.printMeTime > 0 && i == partition.ps.voxelIndex)
-                {
-                    std::cout << "pointSourcePressure=" << partition.voxelPressures[i] << std::endl;
-                    partition.ps.printMeTime -= SIM_DELTA_TIME;
-                }
-            }
-        }
-    }
-    // Compute & accumulate forcing terms at each cell.
-    //  for cells at interfaces, use equation (9),
-    //  and for cells with point sources, use the sample value //
-    for (auto& partition : partitions)
-    {
-        for (size_t y = 0; y < partition.voxelLengthY; y++)
-        {
-            for (size_t x = 0; x < partition.voxelLengthX; x++)
-            {
-                // zero out the forcing terms first //
-                const size_t i = y*partition.voxelLengthX + x;
-                partition.voxelForcingTerms[i] = 0;
-                // While we're at it, let's update the visuals for grid pressures //
-                const size_t globalGridX = partition.voxelX + x;
-                const size_t globalGridY = partition.voxelY + y;
-                const size_t v = globalGridY*voxelGridLengthX + globalGridX;
-                const size_t vLocal = y*partition.voxelLengthX + x;
-                /// TODO: figure out wtf this even should be?? and wtf does it mean??
-                static const double MAX_PRESSURE_MAGNITUDE = 1.0;
-                const double alphaPercent =
-                    std::min(abs(partition.voxelPressures[vLocal]) / MAX_PRESSURE_MAGNITUDE, 1.0);
-                const sf::Uint8 alpha = sf::Uint8(alphaPercent * 255);
-                sf::Color color = partition.voxelPressures[vLocal] > 0 ?
-                    sf::Color(0, 0, 255, alpha) : sf::Color(255, 0, 0, alpha);
-                if (_isnan(partition.voxelPressures[vLocal]))
-                {
-                    color = sf::Color::Green;
-                }
-                for (unsigned i = 0; i < 4; i++)
-                {
-                    vaSimGridPressures[4 * v + i].color = color;
-                }
-            }
-        }
-        static const sf::Vector2i DIRECTION_VECS[] = {
-            {0,1}, {0,-1}, {-1,0}, {1,0}
-        };
-        for (auto& iFace : partition.interfaces)
-        {
-            const unsigned iFaceRight = iFace.voxelX + iFace.voxelLengthX;
-            const unsigned iFaceTop = iFace.voxelY + iFace.voxelLengthY;
-            const sf::Vector2i& iFaceDirection = DIRECTION_VECS[size_t(iFace.dir)];
-            for (unsigned x = iFace.voxelX; x < iFaceRight; x++)
-            {
-                for (unsigned y = iFace.voxelY; y < iFaceTop; y++)
-                {
-                    const sf::Vector2i i{ int(x),int(y) };
-                    double pressureStencil = 0;
-                    static const double STENCIL_WEIGHTS[] = {
-                        -2, 27, -270, 270, -27, 2
-                    };
-                    for (int di = -2; di <= 3; di++)
-                    {
-                        const sf::Vector2i stencil_i = i + iFaceDirection*di;
-                        if (stencil_i.x < 0 || stencil_i.x >= int(voxelGridLengthX) ||
-                            stencil_i.y < 0 || stencil_i.y >= int(voxelGridLengthY))
-                        {
-                            // Just discard parts of the stencil that lie out of bounds??...
-                            continue;
-                        }
-                        double* pPressure = globalPressureLookupTable[stencil_i.y][stencil_i.x];
-                        if (!pPressure)
-                        {
-                            // Just discard parts of the stencil that are outside partitions??...
-                            continue;
-                        }
-                        assert(!_isnan(*pPressure));
-                        pressureStencil += STENCIL_WEIGHTS[di + 2] * (*pPressure);
-                    }
-                    unsigned partitionVoxelX = x - partition.voxelX;
-                    unsigned partitionVoxelY = y - partition.voxelY;
-                    const size_t partitionI = partitionVoxelY*partition.voxelLengthX + partitionVoxelX;
-                    // Equation (9): (hopefully?..)
-                    partition.voxelForcingTerms[partitionI] += pow(SOUND_SPEED_METERS_PER_SECOND, 2)*
-                        (1.0 / (180 * pow(SIM_VOXEL_SPACING,2)))*pressureStencil;
-                    assert(!_isnan(partition.voxelForcingTerms[partitionI]));
-                }
-            }
-        }
-        // if this partition has an active point-source, apply its pressure value //
-        if (partition.ps.timeLeft > 0)
-        {
-            partition.voxelForcingTerms[partition.ps.voxelIndex] = partition.ps.step();
-            assert(!_isnan(partition.voxelForcingTerms[partition.ps.voxelIndex]));
-        }
-    }
-    // Transform forcing terms back to modal space via DCT //
-    for (auto& partition : partitions)
-    {
-        fftw_execute(partition.planForcingToModes);
-        const double normalization = 2 * sqrt(partition.voxelLengthY * partition.voxelLengthX);
-        for (size_t y = 0; y < partition.voxelLengthY; y++)
-        {
-            for (size_t x = 0; x < partition.voxelLengthX; x++)
-            {
-                const size_t i = y*partition.voxelLengthX + x;
-                partition.voxelForcingTerms[i] /= normalization;
-            }
-        }
-    }
-}
-void Map::toggleVoxelGrid()
-{
-    m_showVoxelGrid = !m_showVoxelGrid;
-}
-void Map::togglePartitionMeta()
-{
-    m_showPartitionMeta = !m_showPartitionMeta;
-}
-void Map::touch(const sf::Vector2f & worldSpaceLocation)
-{
-    std::cout << "worldSpaceLocation=" << worldSpaceLocation<<std::endl;
-    // first, we need to find out which partition we're in, if any //
-    for (auto& partition : partitions)
-    {
-        const float pLeft = float(partition.voxelX*SIM_VOXEL_SPACING);
-        const float pRight = float((partition.voxelX + partition.voxelLengthX)*SIM_VOXEL_SPACING);
-        const float pTop = float((partition.voxelY + partition.voxelLengthY)*SIM_VOXEL_SPACING);
-        const float pBottom = float(partition.voxelY*SIM_VOXEL_SPACING);
-        if (worldSpaceLocation.x >= pLeft && worldSpaceLocation.x < pRight &&
-            worldSpaceLocation.y >= pBottom && worldSpaceLocation.y < pTop)
-        {
-            std::cout << "\tpartition[x,y]=[" << partition.voxelX << "," << partition.voxelY << "]\n";
-            std::cout << "\tpartition[w,h]=[" << partition.voxelLengthX << "," << partition.voxelLengthY << "]\n";
-            // next, we need to update the simulation to assign 
-            //  a forcing term at this cell during the simulation's step //
-            const sf::Vector2f localPosition = worldSpaceLocation - sf::Vector2f{ pLeft,pBottom };
-            const size_t localGridX = size_t(localPosition.x / SIM_VOXEL_SPACING);
-            const size_t localGridY = size_t(localPosition.y / SIM_VOXEL_SPACING);
-            const size_t i = localGridY*partition.voxelLengthX + localGridX;
-            partition.ps = {i, SIM_DELTA_TIME , PointSource::Type::CLICK};
-            partition.ps.printMeTime = 1;
-            std::cout << "\t added a click! pressure="<<partition.voxelPressures[i]<<"\n";
-            return;
-        }
-    }
-}
-bool Map::loadJsonMap(const std::string& jsonMapFilename)
-{
-    std::ifstream fileJsonMap(jsonMapFilename);
-    if (fileJsonMap.is_open())
-    {
-        fileJsonMap >> jsonMap;
-    }
-    else
-    {
-        std::cerr << "ERROR: could not open \"" << jsonMapFilename << "\"\n";
-        return false;
-    }
-    return true;
-}
-bool Map::loadTileset(const std::string& jsonMapFilename)
-{
-    // extract the map's folder string //
-    std::string strMapAssetFolder;
-    size_t folderSlashIndex = jsonMapFilename.find_last_of("/");
-    if (folderSlashIndex != std::string::npos)
-    {
-        strMapAssetFolder = jsonMapFilename.substr(0, folderSlashIndex + 1);
-    }
-    // extract first tileset image filename //
-    std::string strTilesetFilename = jsonMap["tilesets"][0]["image"];
-    strTilesetFilename = strMapAssetFolder + strTilesetFilename;
-    // load the tileset image into a Sprite //
-    if (!texTileset.loadFromFile(strTilesetFilename))
-    {
-        std::cerr << "ERROR: could not load tileset image! \"" << strTilesetFilename << "\"";
-        return false;
-    }
-    return true;
-}
-void Map::buildMapTileVBO()
-{
-    tilePixW = jsonMap["tilesets"][0]["tilewidth"];
-    tilePixH = jsonMap["tilesets"][0]["tileheight"];
-    tilesetColumns = jsonMap["tilesets"][0]["columns"];
-    mapRows = jsonMap["layers"][0]["height"];
-    mapCols = jsonMap["layers"][0]["width"];
-    mapPixelHeight = float(mapRows);// *tilePixH);
-    vaTiles = sf::VertexArray(sf::PrimitiveType::Quads, 4 * mapRows*mapCols);
-    for (unsigned r = 0; r < mapRows; r++)
-    {
-        for (unsigned c = 0; c < mapCols; c++)
-        {
-            unsigned tileArrayIndex = r*mapCols + c;
-            int tileId = jsonMap["layers"][0]["data"][tileArrayIndex] - 1;
-            if (tileId < 0)
-            {
-                continue;
-            }
-            vaTiles[4 * tileArrayIndex + 0].position = { float(c * 1),    float(mapPixelHeight - (r) * 1) };
-            vaTiles[4 * tileArrayIndex + 1].position = { float((c + 1) * 1),float(mapPixelHeight - (r) * 1) };
-            vaTiles[4 * tileArrayIndex + 2].position = { float((c + 1) * 1),float(mapPixelHeight - (r + 1) * 1) };
-            vaTiles[4 * tileArrayIndex + 3].position = { float(c * 1),    float(mapPixelHeight - (r + 1) * 1) };
-            const int TILESET_ROW = tileId / tilesetColumns;
-            const int TILESET_COL = tileId % tilesetColumns;
-            const sf::Vector2f TILE_UPPER_LEFT(float(TILESET_COL*tilePixW), float(TILESET_ROW*tilePixH));
-            vaTiles[4 * tileArrayIndex + 0].texCoords = TILE_UPPER_LEFT + sf::Vector2f{ 0.f,0.f };
-            vaTiles[4 * tileArrayIndex + 1].texCoords = TILE_UPPER_LEFT + sf::Vector2f{ float(tilePixW),0.f };
-            vaTiles[4 * tileArrayIndex + 2].texCoords = TILE_UPPER_LEFT + sf::Vector2f{ float(tilePixW),float(tilePixH) };
-            vaTiles[4 * tileArrayIndex + 3].texCoords = TILE_UPPER_LEFT + sf::Vector2f{ 0.f,float(tilePixH) };
-        }
-    }
-}
-void Map::buildVoxelGridVBO()
-{
-    voxelGridLengthY = unsigned(mapRows / SIM_VOXEL_SPACING);
-    voxelGridLengthX = unsigned(mapCols / SIM_VOXEL_SPACING);
-    std::cout << "voxel grid={" << voxelGridLengthX << "x" << voxelGridLengthY << "}\n";
-    vaSimGridLines = sf::VertexArray(sf::PrimitiveType::Lines, 2 * (voxelGridLengthY + 1) + 2 * (voxelGridLengthX + 1));
-    const float MAP_LEFT = 0;
-    const float MAP_RIGHT = float(mapCols);
-    for (unsigned r = 0; r < voxelGridLengthY + 1; r++)
-    {
-        vaSimGridLines[2 * r + 0].position = { MAP_LEFT, float(r*SIM_VOXEL_SPACING) };
-        vaSimGridLines[2 * r + 1].position = { MAP_RIGHT, float(r*SIM_VOXEL_SPACING) };
-    }
-    const float MAP_TOP = float(mapRows);
-    const float MAP_BOTTOM = 0;
-    for (unsigned c = 0; c < voxelGridLengthX + 1; c++)
-    {
-        vaSimGridLines[2 * (voxelGridLengthY + 1) + 2 * c + 0].position = { float(c*SIM_VOXEL_SPACING), MAP_TOP };
-        vaSimGridLines[2 * (voxelGridLengthY + 1) + 2 * c + 1].position = { float(c*SIM_VOXEL_SPACING), MAP_BOTTOM };
-    }
-}
-void Map::buildVoxelPressureVBO()
-{
-    vaSimGridPressures = sf::VertexArray(sf::PrimitiveType::Quads, voxelGridLengthY*voxelGridLengthX * 4);
-    for (size_t v = 0; v < voxelGridLengthY*voxelGridLengthX; v++)
-    {
-        const unsigned gridX = v % voxelGridLengthX;
-        const unsigned gridY = v / voxelGridLengthX;
-        const float left = gridX*SIM_VOXEL_SPACING;
-        const float right = (gridX + 1)*SIM_VOXEL_SPACING;
-        const float bottom = gridY*SIM_VOXEL_SPACING;
-        const float top = (gridY + 1)*SIM_VOXEL_SPACING;
-        vaSimGridPressures[4 * v + 0].position = { left, bottom };
-        vaSimGridPressures[4 * v + 1].position = { right, bottom };
-        vaSimGridPressures[4 * v + 2].position = { right, top };
-        vaSimGridPressures[4 * v + 3].position = { left, top };
-        for (size_t i = 0; i < 4; i++)
-        {
-            vaSimGridPressures[4 * v + i].color = sf::Color::Transparent;
-        }
-    }
-}
-void Map::decomposeVoxelsIntoPartitions()
-{
-    globalPressureLookupTable.clear();
-    globalPressureLookupTable.resize(voxelGridLengthY, std::vector<double*>(voxelGridLengthX, nullptr));
-    voxelMeta.clear();
-    voxelMeta.resize(voxelGridLengthY, std::vector<VoxelMeta>(voxelGridLengthX));
-    auto checkNextPartitionRow = [&](unsigned partitionBottomRow, unsigned partitionLeftCol,
-        unsigned currPartitionW, unsigned currPartitionH)->bool
-    {
-        if (partitionBottomRow + currPartitionH >= voxelGridLengthY)
-        {
-            return false;
-        }
-        // we iterate along the -Y edge of the partition
-        //      (because of the way the json map stores the map tiles)
-        //  and return true if all the voxels below are empty space
-        for (unsigned c = 0; c < currPartitionW; c++)
-        {
-            const unsigned vc = partitionLeftCol + c;
-            const unsigned vr = partitionBottomRow + currPartitionH;
-            const sf::Vector2f worldPos((vc + 0.5f)*SIM_VOXEL_SPACING,
-                mapPixelHeight - (vr + 0.5f)*SIM_VOXEL_SPACING);
-            // because our units are meters, and each map tile is 1m^s,
-            //  we can just cast to ints to obtain map tile indexes:
-            const unsigned mapRow = unsigned(worldPos.y);
-            const unsigned mapCol = unsigned(worldPos.x);
-            unsigned tileArrayIndex = mapRow*mapCols + mapCol;
-            int tileId = jsonMap["layers"][0]["data"][tileArrayIndex];
-            if (tileId > 0 || voxelMeta[vr][vc].partitionIndex >= 0)
-            {
-                return false;
-            }
-        }
-        return true;
-    };
-    auto checkNextPartitionCol = [&](unsigned partitionBottomRow, unsigned partitionLeftCol,
-        unsigned currPartitionW, unsigned currPartitionH)->bool
-    {
-        if (partitionLeftCol + currPartitionW >= voxelGridLengthX)
-        {
-            return false;
-        }
-        // we iterate along the +X edge of the partition 
-        //  and return true if all the voxels below are empty space
-        for (unsigned r = 0; r < currPartitionH; r++)
-        {
-            const unsigned vc = partitionLeftCol + currPartitionW;
-            const unsigned vr = partitionBottomRow + r;
-            const sf::Vector2f worldPos((vc + 0.5f)*SIM_VOXEL_SPACING,
-                mapPixelHeight - (vr + 0.5f)*SIM_VOXEL_SPACING);
-            // because our units are meters, and each map tile is 1m^s,
-            //  we can just cast to ints to obtain map tile indexes:
-            const unsigned mapRow = unsigned(worldPos.y);
-            const unsigned mapCol = unsigned(worldPos.x);
-            unsigned tileArrayIndex = mapRow*mapCols + mapCol;
-            int tileId = jsonMap["layers"][0]["data"][tileArrayIndex];
-            if (tileId > 0 || voxelMeta[vr][vc].partitionIndex >= 0)
-            {
-                return false;
-            }
-        }
-        return true;
-    };
-    unsigned simulationVoxelTotal = 0;///DEBUG
-    for (unsigned r = 0; r < voxelGridLengthY; r++)
-    {
-        for (unsigned c = 0; c < voxelGridLengthX; c++)
-        {
-            const sf::Vector2f worldPos((c + 0.5f)*SIM_VOXEL_SPACING,
-                mapPixelHeight - (r + 0.5f)*SIM_VOXEL_SPACING);
-            // because our units are meters, and each map tile is 1m^s,
-            //  we can just cast to ints to obtain map tile indexes:
-            const unsigned mapRow = unsigned(worldPos.y);
-            const unsigned mapCol = unsigned(worldPos.x);
-            unsigned tileArrayIndex = mapRow*mapCols + mapCol;
-            int tileId = jsonMap["layers"][0]["data"][tileArrayIndex];
-            if (tileId > 0 || voxelMeta[r][c].partitionIndex >= 0)
-            {
-                // every non-zero tile is considered solid
-                //  as well as every previously decomposed voxel
-                continue;
-            }
-            unsigned partitionW = 1;
-            unsigned partitionH = 1;
-            while (checkNextPartitionRow(r, c, partitionW, partitionH))
-            {
-                partitionH++;
-            }
-            while (checkNextPartitionCol(r, c, partitionW, partitionH))
-            {
-                partitionW++;
-            }
-            // we need to mark the voxels in this partition as decomposed
-            //  so they don't go into new partitions
-            for (unsigned vr = r; vr < r + partitionH; vr++)
-            {
-                for (unsigned vc = c; vc < c + partitionW; vc++)
-                {
-                    voxelMeta[vr][vc].partitionIndex = partitions.size();
-                }
-            }
-            simulationVoxelTotal += partitionW*partitionH;
-            partitions.push_back({ r,c,partitionW,partitionH });
-        }
-    }
-    std::cout << "simulationVoxelTotal=" << simulationVoxelTotal << std::endl;
-    // add all partition's pressure pointers to the globalPressureLookupTable //
-    //  need to do this after they have all been allocated
-    //  because memory addresses will change if the vector gets resized I think!!!
-    for (auto& partition : partitions)
-    {
-        for (size_t y = 0; y < partition.voxelLengthY; y++)
-        {
-            for (size_t x = 0; x < partition.voxelLengthX; x++)
-            {
-                const size_t i = y*partition.voxelLengthX + x;
-                globalPressureLookupTable[partition.voxelY + y][partition.voxelX + x] =
-                    &(partition.voxelPressures[i]);
-            }
-        }
-    }
-}
-void Map::buildPartitionVBO()
-{
-    vaSimPartitions = sf::VertexArray(sf::PrimitiveType::Quads, 4 * 4 * partitions.size());
-    for (size_t p = 0; p < partitions.size(); p++)
-    {
-        static const sf::Color color(0, 255, 255, 64);
-        static const float OUTLINE_SIZE = SIM_VOXEL_SPACING*0.5f;
-        const auto& partition = partitions[p];
-        const float pLeft = float(partition.voxelX*SIM_VOXEL_SPACING);
-        const float pRight = float((partition.voxelX + partition.voxelLengthX)*SIM_VOXEL_SPACING);
-        const float pTop = float((partition.voxelY + partition.voxelLengthY)*SIM_VOXEL_SPACING);
-        const float pBottom = float(partition.voxelY*SIM_VOXEL_SPACING);
-        // left side //
-        vaSimPartitions[4 * 4 * p + 0].position = { pLeft, pBottom };
-        vaSimPartitions[4 * 4 * p + 1].position = { pLeft + OUTLINE_SIZE, pBottom };
-        vaSimPartitions[4 * 4 * p + 2].position = { pLeft + OUTLINE_SIZE, pTop };
-        vaSimPartitions[4 * 4 * p + 3].position = { pLeft, pTop };
-        // right side //
-        vaSimPartitions[4 * 4 * p + 4].position = { pRight - OUTLINE_SIZE, pBottom };
-        vaSimPartitions[4 * 4 * p + 5].position = { pRight, pBottom };
-        vaSimPartitions[4 * 4 * p + 6].position = { pRight, pTop };
-        vaSimPartitions[4 * 4 * p + 7].position = { pRight - OUTLINE_SIZE, pTop };
-        // top side //
-        vaSimPartitions[4 * 4 * p + 8].position = { pLeft + OUTLINE_SIZE, pTop - OUTLINE_SIZE };
-        vaSimPartitions[4 * 4 * p + 9].position = { pRight - OUTLINE_SIZE, pTop - OUTLINE_SIZE };
-        vaSimPartitions[4 * 4 * p + 10].position = { pRight - OUTLINE_SIZE, pTop };
-        vaSimPartitions[4 * 4 * p + 11].position = { pLeft + OUTLINE_SIZE, pTop };
-        // bottom side //
-        vaSimPartitions[4 * 4 * p + 12].position = { pLeft + OUTLINE_SIZE, pBottom };
-        vaSimPartitions[4 * 4 * p + 13].position = { pRight - OUTLINE_SIZE, pBottom };
-        vaSimPartitions[4 * 4 * p + 14].position = { pRight - OUTLINE_SIZE, pBottom + OUTLINE_SIZE };
-        vaSimPartitions[4 * 4 * p + 15].position = { pLeft + OUTLINE_SIZE, pBottom + OUTLINE_SIZE };
-        for (size_t i = 0; i < 4 * 4; i++)
-        {
-            vaSimPartitions[4 * 4 * p + i].color = color;
-        }
-    }
-}
-void Map::calculatePartitionInterfaces()
-{
-    auto addPartitionInterfaceMeta = [&](const PartitionInterface& i)->void
-    {
-        for (unsigned r = i.voxelY; r < i.voxelY + i.voxelLengthY; r++)
-        {
-            for (unsigned c = i.voxelX; c < i.voxelX + i.voxelLengthX; c++)
-            {
-                voxelMeta[r][c].interfacedDirectionFlags |= (1 << int(i.dir));
-            }
-        }
-    };
-    numInterfaces = 0;
-    auto addTransientInterface = [&](Map::Partition& partition,
-        PartitionInterface& transientInterface,
-        PartitionInterface::Direction opposingInterfaceDir,
-        const sf::Vector2i& edgeNeighborOffset,
-        size_t partitionIndex)->void
-    {
-        const sf::Vector2i interfaceBaseVoxelIndex(
-            transientInterface.voxelX,
-            transientInterface.voxelY);
-        const sf::Vector2i edgeNeighborIndex = interfaceBaseVoxelIndex + edgeNeighborOffset;
-        Map::VoxelMeta& edgeNeighborVoxel = voxelMeta[edgeNeighborIndex.y][edgeNeighborIndex.x];
-        //transientInterface.partitionIndexOther = size_t(edgeNeighborVoxel.partitionIndex);
-        partition.interfaces.push_back(transientInterface);
-        addPartitionInterfaceMeta(transientInterface);
-        // Add the corresponding interface for the the adjacent partition
-        //  as well as the meta info so we don't repeat any interfaces!
-        transientInterface.dir = opposingInterfaceDir;
-        transientInterface.voxelX += edgeNeighborOffset.x;
-        transientInterface.voxelY += edgeNeighborOffset.y;
-        //transientInterface.partitionIndexOther = partitionIndex;
-        partitions[edgeNeighborVoxel.partitionIndex].interfaces.push_back(transientInterface);
-        addPartitionInterfaceMeta(transientInterface);
-        numInterfaces += 2;
-    };
-    auto processPartitionEdge = [&](Map::Partition& partition,
-        const sf::Vector2i& partitionEdgeVoxelIndex,
-        const sf::Vector2i& edgeNeighborOffset,
-        PartitionInterface::Direction interfaceDir,
-        PartitionInterface::Direction opposingInterfaceDir,
-        PartitionInterface& transientInterface,
-        int& transientNeighborPartitionIndex)->void
-    {
-        const sf::Vector2i edgeNeighborIndex = partitionEdgeVoxelIndex + edgeNeighborOffset;
-        if (edgeNeighborIndex.x < 0 ||
-            edgeNeighborIndex.x >= int(voxelGridLengthX) ||
-            edgeNeighborIndex.y < 0 ||
-            edgeNeighborIndex.y >= int(voxelGridLengthY))
-        {
-            return;
-        }
-        Map::VoxelMeta& edgeVoxel = voxelMeta[partitionEdgeVoxelIndex.y][partitionEdgeVoxelIndex.x];
-        Map::VoxelMeta& edgeNeighborVoxel = voxelMeta[edgeNeighborIndex.y][edgeNeighborIndex.x];
-        if (edgeNeighborVoxel.partitionIndex >= 0)
-        {
-            uint8_t iFlags = edgeVoxel.interfacedDirectionFlags;
-            if (!(iFlags & (1 << int(interfaceDir))))
-            {
-                if (edgeNeighborVoxel.partitionIndex == transientNeighborPartitionIndex)
-                {
-                    // extend the size of our transient interface //
-                    if (edgeNeighborOffset.x != 0)
-                    {
-                        transientInterface.voxelLengthY++;
-                    }
-                    else
-                    {
-                        transientInterface.voxelLengthX++;
-                    }
-                }
-                else
-                {
-                    // if we have been building an interface already, 
-                    //  add the previous interface to our list
-                    if (transientNeighborPartitionIndex >= 0)
-                    {
-                        addTransientInterface(partition,
-                            transientInterface,
-                            opposingInterfaceDir,
-                            edgeNeighborOffset,
-                            edgeVoxel.partitionIndex);
-                    }
-                    transientNeighborPartitionIndex = edgeNeighborVoxel.partitionIndex;
-                    // in any case, reset our transient interface object
-                    transientInterface = { interfaceDir,
-                        unsigned(partitionEdgeVoxelIndex.x),
-                        unsigned(partitionEdgeVoxelIndex.y), 1,1 };
-                }
-            }
-        }
-    };
-    size_t partitionIndex = 0;
-    for (auto& partition : partitions)
-    {
-        const unsigned partitionTop = partition.voxelY + partition.voxelLengthY;
-        const unsigned partitionRight = partition.voxelX + partition.voxelLengthX;
-        // Search along the left & right sides to find partition interfaces //
-        PartitionInterface transientInterfaceLeft;
-        int partitionIndexLeft = -1;
-        PartitionInterface transientInterfaceRight;
-        int partitionIndexRight = -1;
-        for (unsigned r = partition.voxelY; r < partitionTop; r++)
-        {
-            // Left Side... //
-            processPartitionEdge(partition,
-            { int(partition.voxelX), int(r) }, { -1, 0 },
-                PartitionInterface::Direction::X_NEGATIVE,
-                PartitionInterface::Direction::X_POSITIVE,
-                transientInterfaceLeft, partitionIndexLeft);
-            // Right Side... //
-            processPartitionEdge(partition,
-            { int(partitionRight - 1), int(r) }, { 1, 0 },
-                PartitionInterface::Direction::X_POSITIVE,
-                PartitionInterface::Direction::X_NEGATIVE,
-                transientInterfaceRight, partitionIndexRight);
-        }
-        // Add the last transient interfaces, as long as we have found one
-        if (partitionIndexLeft >= 0)
-        {
-            addTransientInterface(partition,
-                transientInterfaceLeft,
-                PartitionInterface::Direction::X_POSITIVE,
-                { -1, 0 },
-                partitionIndex);
-        }
-        if (partitionIndexRight >= 0)
-        {
-            addTransientInterface(partition,
-                transientInterfaceRight,
-                PartitionInterface::Direction::X_NEGATIVE,
-                { 1,0 },
-                partitionIndex);
-        }
-        // Search along the top and bottom sides to find partition interfaces //
-        PartitionInterface transientInterfaceTop;
-        int partitionIndexTop = -1;
-        PartitionInterface transientInterfaceBottom;
-        int partitionIndexBottom = -1;
-        for (unsigned c = partition.voxelX; c < partitionRight; c++)
-        {
-            // Top side... //
-            processPartitionEdge(partition,
-            { int(c), int(partitionTop - 1) }, { 0, 1 },
-                PartitionInterface::Direction::Y_POSITIVE,
-                PartitionInterface::Direction::Y_NEGATIVE,
-                transientInterfaceTop, partitionIndexTop);
-            // Bottom side... //
-            processPartitionEdge(partition,
-            { int(c), int(partition.voxelY) }, { 0, -1 },
-                PartitionInterface::Direction::Y_NEGATIVE,
-                PartitionInterface::Direction::Y_POSITIVE,
-                transientInterfaceBottom, partitionIndexBottom);
-        }
-        // Add the last transient interfaces, as long as we have found one
-        if (partitionIndexTop >= 0)
-        {
-            addTransientInterface(partition,
-                transientInterfaceTop,
-                PartitionInterface::Direction::Y_NEGATIVE,
-                { 0,1 },
-                partitionIndex);
-        }
-        if (partitionIndexBottom >= 0)
-        {
-            addTransientInterface(partition,
-                transientInterfaceBottom,
-                PartitionInterface::Direction::Y_POSITIVE,
-                { 0,-1 },
-                partitionIndex);
-        }
-        partitionIndex++;
-    }
-    std::cout << "numInterfaces=" << numInterfaces << std::endl;
-}
-void Map::buildInterfaceVBO()
-{
-    vaSimPartitionInterfaces = sf::VertexArray(sf::PrimitiveType::Quads, 4 * numInterfaces);
-    unsigned currInterface = 0;
-    for (const auto& partition : partitions)
-    {
-        for (const auto& interface : partition.interfaces)
-        {
-            static const sf::Color color(255, 128, 0, 64);
-            const float iLeft = float(interface.voxelX*SIM_VOXEL_SPACING);
-            const float iRight = float((interface.voxelX + interface.voxelLengthX)*SIM_VOXEL_SPACING);
-            const float iTop = float((interface.voxelY + interface.voxelLengthY)*SIM_VOXEL_SPACING);
-            const float iBottom = float(interface.voxelY*SIM_VOXEL_SPACING);
-            vaSimPartitionInterfaces[4 * currInterface + 0].position = { iLeft, iBottom };
-            vaSimPartitionInterfaces[4 * currInterface + 1].position = { iRight, iBottom };
-            vaSimPartitionInterfaces[4 * currInterface + 2].position = { iRight, iTop };
-            vaSimPartitionInterfaces[4 * currInterface + 3].position = { iLeft, iTop };
-            for (unsigned i = 0; i < 4; i++)
-            {
-                vaSimPartitionInterfaces[4 * currInterface + i].color = color;
-            }
-            currInterface++;
-        }
-    }
-}
-void Map::nullify()
-{
-    partitions.clear();
-    voxelMeta.clear();
-}
-Map::VoxelMeta::VoxelMeta(int partitionIndex, uint8_t interfacedDirs)
-    :partitionIndex(partitionIndex)
-    ,interfacedDirectionFlags(interfacedDirs)
-{
-}
-Map::Partition::Partition(unsigned y, unsigned x, unsigned lx, unsigned ly)
-    :voxelY(y)
-    ,voxelX(x)
-    ,voxelLengthX(lx)
-    ,voxelLengthY(ly)
-{
-    const size_t gridSize = voxelLengthX*voxelLengthY;
-    voxelModes = new double[gridSize];
-    voxelModesPrevious = new double[gridSize];
-    voxelForcingTerms = new double[gridSize];
-    voxelPressures = new double[gridSize];
-    for (size_t c = 0; c < gridSize; c++)
-    {
-        //voxelModes[c][0] = voxelModes[c][1] = 0;
-        //voxelModesPrevious[c][0] = voxelModesPrevious[c][1] = 0;
-        //voxelPressures[c][0] = voxelPressures[c][1] = 0;
-        voxelModes[c] = 0;
-        voxelModesPrevious[c] = 0;
-        voxelForcingTerms[c] = 0;
-        voxelPressures[c] = 0;
-    }
-    planModeToPressure = fftw_plan_r2r_2d(voxelLengthY, voxelLengthX,
-        voxelModes, voxelPressures,
-        FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE);
-    planForcingToModes = fftw_plan_r2r_2d(voxelLengthY, voxelLengthX,
-        voxelForcingTerms, voxelForcingTerms,
-        FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE);
-}
-Map::Partition::Partition(const Partition & other)
-    :voxelY(other.voxelY)
-    ,voxelX(other.voxelX)
-    ,voxelLengthX(other.voxelLengthX)
-    ,voxelLengthY(other.voxelLengthY)
-    ,interfaces(other.interfaces)
-{
-    const size_t gridSize = voxelLengthX*voxelLengthY;
-    voxelModes = new double[gridSize];
-    voxelModesPrevious = new double[gridSize];
-    voxelForcingTerms = new double[gridSize];
-    voxelPressures = new double[gridSize];
-    for (size_t c = 0; c < gridSize; c++)
-    {
-        //for (size_t i = 0; i < 2; i++)
-        //{
-        //    voxelModes[c][i] = other.voxelModes[c][i];
-        //    voxelModesPrevious[c][i] = other.voxelModesPrevious[c][i];
-        //    voxelPressures[c][i] = other.voxelPressures[c][i];
-        //}
-        voxelModes[c] = other.voxelModes[c];
-        voxelModesPrevious[c] = other.voxelModesPrevious[c];
-        voxelForcingTerms[c] = other.voxelModesPrevious[c];
-        voxelPressures[c] = other.voxelPressures[c];
-    }
-    planModeToPressure = fftw_plan_r2r_2d(voxelLengthY, voxelLengthX,
-        voxelModes, voxelPressures,
-        FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE);
-    planForcingToModes = fftw_plan_r2r_2d(voxelLengthY, voxelLengthX,
-        voxelForcingTerms, voxelForcingTerms,
-        FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE);
-}
-Map::Partition::~Partition()
-{
-    if (voxelModes) delete[] voxelModes;
-    if (voxelModesPrevious) delete[] voxelModesPrevious;
-    if (voxelForcingTerms) delete[] voxelForcingTerms;
-    if (voxelPressures) delete[] voxelPressures;
-}
-Map::PointSource::PointSource(size_t voxelIndex, float time, Type t)
-    :voxelIndex(voxelIndex)
-    ,type(t)
-    ,timeLeft(time)
-    ,totalTime(time)
-    ,printMeTime(0.f)
-{
-}
-double Map::PointSource::step()
-{
-    timeLeft -= SIM_DELTA_TIME;
-    switch (type)
-    {
-    case PointSource::Type::CLICK:
-        std::cout << "\tclick stepped!\n";
-        return 1.0*(1.0/SIM_DELTA_TIME)*(1.0/pow(SIM_VOXEL_SPACING,2));///WTF does this even mean?..  what units are  these?..
-    case PointSource::Type::GAUSIAN_PULSE:
-        ///TODO: calculate a broadband gausian pulse of unit amplitude or w/e
-        /// Kinda like this: http://www.gaussianwaves.com/2014/07/generating-basic-signals-gaussian-pulse-and-power-spectral-density-using-fft/
-    default:
-        return 0;
-    }
+#include "Map.h"
+#include "toolbox.h"
+#include "SmallDct.h"
+#include "HaloTransport.h"
+#include "TiledMapReader.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <map>
+#include <tuple>
+const float Map::SOUND_SPEED_METERS_PER_SECOND = 340;
+const float Map::MIN_SOUND_HZ = SOUND_SPEED_METERS_PER_SECOND/2;
+const double Map::REGION_ACTIVITY_PRESSURE = 1e-6;
+const float Map::REGION_QUIET_SECONDS = 0.05f;
+const unsigned Map::REGION_QUIET_CHECK_STEPS = 64;
+const unsigned Map::STABILITY_SAMPLE_STEPS = 16;
+// the 6 tap stencil sits on the last voxel before the interface, so it reaches 3 past it
+const unsigned Map::HALO_DEPTH = 3;
+const int Map::GHOST_SOURCE_ABSENT = -1;
+const int Map::GHOST_SOURCE_ACROSS_REGION = -2;
+const float Map::MIN_TRANSMISSION = 0.01f;
+namespace
+{
+    // unit steps of each PartitionInterface::Direction //
+    const sf::Vector3i DIRECTION_VECS[] = {
+        {0,1,0}, {0,-1,0}, {-1,0,0}, {1,0,0}, {0,0,1}, {0,0,-1}
+    };
+    // tiles without any material properties are rigid walls //
+    const uint8_t MATERIAL_AIR = 0;
+    const uint8_t MATERIAL_RIGID = 1;
+    // fftw's planner isn't thread-safe, & regions can be planned on several threads while loading //
+    std::mutex fftwPlannerMutex;
+    // Interface stencils of each order, over 1/180h^2: the three voxels before the
+    //  interface, nearest last, then the three after it.  Each is the difference
+    //  between that order's central Laplacian & the rigid one each partition
+    //  already gets from its own modes //
+    const double* interfaceStencilWeights(unsigned stencilOrder)
+    {
+        static const double WEIGHTS_2[] = { 0, 0, -180, 180, 0, 0 };
+        static const double WEIGHTS_4[] = { 0, 15, -240, 240, -15, 0 };
+        static const double WEIGHTS_6[] = { -2, 27, -270, 270, -27, 2 };
+        return stencilOrder <= 2 ? WEIGHTS_2 : stencilOrder <= 4 ? WEIGHTS_4 : WEIGHTS_6;
+    }
+}
+float Map::getSimDeltaTime() const
+{
+    return simDeltaTime;
+}
+float Map::getVoxelSpacing() const
+{
+    return simVoxelSpacing;
+}
+float Map::getMaximumSoundHz() const
+{
+    return maximumSoundHz;
+}
+Map::Map()
+    :m_showVoxelGrid(false)
+    ,m_showPartitionMeta(false)
+    ,voxelGridLengthZ(1)
+    ,visibleVoxelZ(0)
+    ,pressureRevision(1)
+    ,regionVoxelLength(0)
+    ,regionColumns(0)
+    ,loadStage(LoadStage::NONE)
+    ,tilesReady(false)
+    ,cancelLoad(false)
+    ,regionsToPrepare(0)
+    ,regionsPrepared(0)
+    ,mapLayers(0)
+    ,materialLayers(0)
+{
+    setMaximumSoundHz(options.maximumSoundHz);
+}
+Map::~Map()
+{
+    nullify();
+}
+bool Map::load(const std::string & jsonMapFilename, const LoadOptions& options)
+{
+    nullify();
+    this->options = options;
+    return runLoad(jsonMapFilename, sf::FloatRect());
+}
+void Map::loadAsync(const std::string & jsonMapFilename, const LoadOptions & options,
+    const sf::FloatRect & worldSpaceViewBounds)
+{
+    nullify();
+    this->options = options;
+    loadThread = std::thread([this, jsonMapFilename, worldSpaceViewBounds]()
+    {
+        runLoad(jsonMapFilename, worldSpaceViewBounds);
+    });
+}
+bool Map::isReady() const
+{
+    return loadStage == LoadStage::READY;
+}
+bool Map::hasLoadFailed() const
+{
+    return loadStage == LoadStage::FAILED;
+}
+std::string Map::getLoadStatus(float & progress) const
+{
+    const size_t prepared = regionsPrepared;
+    const size_t toPrepare = std::max(size_t(1), regionsToPrepare.load());
+    switch (loadStage.load())
+    {
+    case LoadStage::PARSING:
+        progress = 0;
+        return "parsing the map";
+    case LoadStage::BUILDING_REGIONS:
+        progress = 0.2f;
+        return "building regions";
+    case LoadStage::PREPARING_REGIONS:
+        progress = 0.3f + 0.7f*prepared / toPrepare;
+        return "decomposing & planning regions in view (" + std::to_string(prepared) + "/" +
+            std::to_string(regionsToPrepare.load()) + ")";
+    case LoadStage::READY:
+        progress = 1;
+        return "ready";
+    case LoadStage::FAILED:
+        progress = 1;
+        return "failed";
+    default:
+        progress = 0;
+        return "not loaded";
+    }
+}
+bool Map::runLoad(const std::string & jsonMapFilename, const sf::FloatRect & worldSpaceViewBounds)
+{
+    // every early return is a failure, unless loading got to the end //
+    loadStage = LoadStage::PARSING;
+    struct FailUnlessReady
+    {
+        std::atomic<LoadStage>& stage;
+        ~FailUnlessReady()
+        {
+            if (stage != LoadStage::READY) stage = LoadStage::FAILED;
+        }
+    } failUnlessReady{ loadStage };
+    visibleVoxelZ = 0;
+    if (options.rankCount < 1 || options.rank >= options.rankCount)
+    {
+        std::cerr << "ERROR: rank " << options.rank << " is outside of the " << options.rankCount << " ranks\n";
+        return false;
+    }
+    if (options.stencilOrder != 2 && options.stencilOrder != 4 && options.stencilOrder != 6)
+    {
+        std::cerr << "ERROR: interface stencils can only be of order 2, 4 or 6, not " << options.stencilOrder << "\n";
+        return false;
+    }
+    if (!loadJsonMap(jsonMapFilename))
+    {
+        return false;
+    }
+    // before anything the size of the voxel grid gets allocated //
+    if (!chooseResolution())
+    {
+        return false;
+    }
+    // The tiles & the solver's regions don't share anything, so the tile images load
+    //  & the tile VBO builds alongside the region decomposition.  The tiles can be drawn
+    //  as soon as they're in, well before the solver is ready //
+    bool tilesLoaded = false;
+    std::thread tileThread([this, &jsonMapFilename, &tilesLoaded]()
+    {
+        tilesLoaded = loadTilesets(jsonMapFilename);
+        if (tilesLoaded)
+        {
+            buildMapTileVBO();
+            tilesReady = true;
+        }
+    });
+    loadStage = LoadStage::BUILDING_REGIONS;
+    sizeVoxelGrid();
+    buildRegions();
+    assignRegionRanks();
+    buildHaloLinks();
+    scenario = createScenario();
+    scenario.viewBounds = worldSpaceViewBounds;
+    // stop for a look should it ever run away, rather than going on drawing garbage //
+    scenario.stability.sampleInterval = STABILITY_SAMPLE_STEPS;
+    scenario.stability.actions = StabilityMonitor::LOG | StabilityMonitor::PAUSE;
+    // The regions the view starts on are decomposed, their interfaces found & their VBOs
+    //  built all at once, each on a worker of its own.  Only fftw's planner is shared,
+    //  so planning takes turns //
+    std::vector<bool> pinnedRegions(regions.size(), false);
+    pinViewRegions(worldSpaceViewBounds, pinnedRegions);
+    std::vector<size_t> regionsInView;
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        if (pinnedRegions[r] && isRegionOwned(r))
+        {
+            regionsInView.push_back(r);
+        }
+    }
+    regionsToPrepare = regionsInView.size();
+    loadStage = LoadStage::PREPARING_REGIONS;
+    std::atomic<size_t> nextRegion(0);
+    auto prepareRegions = [this, &regionsInView, &nextRegion]()
+    {
+        for (size_t i = nextRegion++; i < regionsInView.size() && !cancelLoad; i = nextRegion++)
+        {
+            makeRegionResident(regionsInView[i]);
+            regionsPrepared++;
+        }
+    };
+    const unsigned workerCount = std::min(std::max(1u, std::thread::hardware_concurrency()),
+        unsigned(regionsInView.size()));
+    std::vector<std::thread> workers;
+    for (unsigned w = 1; w < workerCount; w++)
+    {
+        workers.emplace_back(prepareRegions);
+    }
+    prepareRegions();
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    tileThread.join();
+    if (!tilesLoaded || cancelLoad)
+    {
+        return false;
+    }
+    loadStage = LoadStage::READY;
+    return true;
+}
+void Map::draw(sf::RenderTarget & rt)
+{
+    // grid lines closer together than this many pixels are thinned out //
+    static const float MIN_GRID_LINE_PIXELS = 4;
+    // while loading, the tiles show up as soon as they're in & the solver once it's ready //
+    if (!tilesReady)
+    {
+        return;
+    }
+    for (const auto& batch : tileBatches)
+    {
+        rt.draw(batch.vertices, sf::RenderStates(&tileSheets[batch.sheetIndex].texture));
+    }
+    if (!isReady())
+    {
+        return;
+    }
+    // Only voxels inside the view get coloured or drawn, and once several of them
+    //  share a pixel they're drawn a level of detail down, so the work done here
+    //  follows the size of the screen instead of the size of the map //
+    const sf::View& view = rt.getView();
+    const sf::Vector2f viewSize(fabs(view.getSize().x), fabs(view.getSize().y));
+    const sf::Vector2f viewBottomLeft = view.getCenter() - viewSize*0.5f;
+    const int visibleLeft = std::max(int(floor(viewBottomLeft.x / simVoxelSpacing)), 0);
+    const int visibleBottom = std::max(int(floor(viewBottomLeft.y / simVoxelSpacing)), 0);
+    const int visibleRight = std::min(int(ceil((viewBottomLeft.x + viewSize.x) / simVoxelSpacing)), int(voxelGridLengthX));
+    const int visibleTop = std::min(int(ceil((viewBottomLeft.y + viewSize.y) / simVoxelSpacing)), int(voxelGridLengthY));
+    if (visibleRight <= visibleLeft || visibleTop <= visibleBottom)
+    {
+        return;
+    }
+    const sf::IntRect visibleVoxels(visibleLeft, visibleBottom, visibleRight - visibleLeft, visibleTop - visibleBottom);
+    const float voxelsPerPixel = viewSize.x / (rt.getSize().x*simVoxelSpacing);
+    unsigned lod = 0;
+    while (float(2u << lod) <= voxelsPerPixel && (1u << lod) < regionVoxelLength)
+    {
+        lod++;
+    }
+    if (m_showVoxelGrid)
+    {
+        unsigned gridLod = 0;
+        while (float(1u << gridLod) < MIN_GRID_LINE_PIXELS*voxelsPerPixel)
+        {
+            gridLod++;
+        }
+        buildVoxelGridLines(visibleVoxels, gridLod);
+        rt.draw(vaSimGridLines);
+    }
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        Region& region = regions[r];
+        const sf::IntRect regionVoxels(region.voxelX, region.voxelY, region.voxelLengthX, region.voxelLengthY);
+        if (!region.resident || !regionVoxels.intersects(visibleVoxels))
+        {
+            continue;
+        }
+        if (m_showPartitionMeta)
+        {
+            rt.draw(region.vaPartitions);
+            rt.draw(region.vaInterfaces);
+            /// TODO: draw a line from each partition to its neighbor via partitionIndexOther
+            /// so I can actually tell where the fuck they are actually going to read data from
+        }
+        const RegionState& regionState = scenario.regions[r];
+        if (!regionState.isActive())
+        {
+            continue;
+        }
+        // the region's texels that the view overlaps, in region space //
+        const int texelSize = 1 << lod;
+        const int left = std::max(visibleLeft, int(region.voxelX)) - int(region.voxelX);
+        const int bottom = std::max(visibleBottom, int(region.voxelY)) - int(region.voxelY);
+        const int right = std::min(visibleRight, int(region.voxelX + region.voxelLengthX)) - int(region.voxelX);
+        const int top = std::min(visibleTop, int(region.voxelY + region.voxelLengthY)) - int(region.voxelY);
+        const sf::IntRect texels(left >> lod, bottom >> lod,
+            ((right + texelSize - 1) >> lod) - (left >> lod), ((top + texelSize - 1) >> lod) - (bottom >> lod));
+        if (region.pressureRevision != pressureRevision || region.pressureLod != lod ||
+            region.pressureTexels != texels)
+        {
+            updatePressureVisuals(region, regionState, lod, texels);
+        }
+        rt.draw(region.vaPressures, sf::RenderStates(&region.texPressures));
+    }
+}
+void Map::stepSimulation()
+{
+    if (scenario.stability.paused)
+    {
+        return;
+    }
+    streamScenario(scenario);
+    stepScenario(scenario);
+    pressureRevision++;
+}
+bool Map::stepScenario(Scenario& scenario, HaloTransport* transport) const
+{
+    // Each group has its modes stepped & transformed to pressures, then as soon as every group
+    //  its interface stencils read has done the same, its forcing is worked out & transformed
+    //  back.  That way most groups go through both halves of the step while their state is
+    //  still in cache, instead of every pass sweeping over all of it in turn //
+    const bool exchangingHalos = options.rankCount > 1;
+    StabilityMonitor& stability = scenario.stability;
+    const bool sampling = stability.sampleInterval > 0 && (scenario.stepCount + 1) % stability.sampleInterval == 0;
+    if (sampling)
+    {
+        for (size_t r = 0; r < regions.size(); r++)
+        {
+            RegionState& regionState = scenario.regions[r];
+            if (!regionState.isActive())
+            {
+                continue;
+            }
+            // resting groups' partitions are left at nothing //
+            const size_t partitionCount = regions[r].partitions.size();
+            regionState.partitionEnergies.assign(partitionCount, 0.0);
+            regionState.partitionPeakModes.assign(partitionCount, 0.0);
+            if (regionState.partitionEnergiesPrevious.size() != partitionCount)
+            {
+                regionState.partitionEnergiesPrevious.assign(partitionCount, 0.0);
+            }
+        }
+    }
+    std::vector<int> sourceGroups(scenario.pointSources.size(), -1);
+    for (size_t s = 0; s < scenario.pointSources.size(); s++)
+    {
+        const PointSource& ps = scenario.pointSources[s];
+        if (!ps.isSounding() || !scenario.regions[ps.stateIndex.region].isActive())
+        {
+            continue;
+        }
+        const auto& groups = regions[ps.stateIndex.region].partitionGroups;
+        for (size_t g = 0; g < groups.size(); g++)
+        {
+            if (ps.stateIndex.local >= groups[g].stateOffset && ps.stateIndex.local <
+                groups[g].stateOffset + groups[g].partitionIndices.size()*groups[g].stateStride)
+            {
+                sourceGroups[s] = int(g);
+                break;
+            }
+        }
+    }
+    // how many groups' pressures each group is still waiting on, its own included //
+    std::vector<std::vector<unsigned>> groupsAwaited(regions.size());
+    // groups of the region whose pressures are still to come, and the groups across waiting on them //
+    std::vector<size_t> groupsLeft(regions.size(), 0);
+    std::vector<std::vector<std::pair<size_t, size_t>>> waitingAcross(regions.size());
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        if (!scenario.regions[r].isActive())
+        {
+            continue;
+        }
+        const auto& groups = regions[r].partitionGroups;
+        groupsAwaited[r].resize(groups.size());
+        groupsLeft[r] = groups.size();
+        for (size_t g = 0; g < groups.size(); g++)
+        {
+            groupsAwaited[r][g] = 1 + groups[g].dependencyCount;
+            // other ranks' regions only come in with the exchange, which waits for every group anyway //
+            for (const size_t across : groups[g].acrossRegions)
+            {
+                if (isRegionOwned(across) && scenario.regions[across].isActive())
+                {
+                    groupsAwaited[r][g]++;
+                    waitingAcross[across].push_back({ r, g });
+                }
+            }
+        }
+    }
+    std::vector<std::pair<size_t, size_t>> readyGroups;
+    auto pressuresDone = [&](size_t r, size_t g)
+    {
+        if (--groupsAwaited[r][g] == 0)
+        {
+            readyGroups.push_back({ r, g });
+        }
+    };
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        RegionState& regionState = scenario.regions[r];
+        if (!regionState.isActive())
+        {
+            continue;
+        }
+        const auto& groups = regions[r].partitionGroups;
+        for (size_t g = 0; g < groups.size(); g++)
+        {
+            updateGroupPressures(regions[r], regionState, g, scenario.prunePressures, sampling);
+            pressuresDone(r, g);
+            for (const size_t dependent : groups[g].dependentGroups)
+            {
+                pressuresDone(r, dependent);
+            }
+            if (--groupsLeft[r] == 0)
+            {
+                for (const auto& waiting : waitingAcross[r])
+                {
+                    pressuresDone(waiting.first, waiting.second);
+                }
+            }
+            while (!exchangingHalos && !readyGroups.empty())
+            {
+                const std::pair<size_t, size_t> ready = readyGroups.back();
+                readyGroups.pop_back();
+                updateGroupForcing(scenario, ready.first, ready.second, sourceGroups);
+            }
+        }
+    }
+    // nothing after the IDCTs changes the pressures, so it doesn't matter that most forcing is done //
+    for (auto& probe : scenario.probes)
+    {
+        probe.pressures.push_back(probePressure(scenario, probe.stateIndex));
+    }
+    // the forcing reads across region edges, so other ranks' edges have to be in first //
+    if (exchangingHalos)
+    {
+        assert(transport);
+        if (!transport || !exchangeHalos(scenario, *transport))
+        {
+            return false;
+        }
+        for (const auto& ready : readyGroups)
+        {
+            updateGroupForcing(scenario, ready.first, ready.second, sourceGroups);
+        }
+    }
+    scenario.stepCount++;
+    if (sampling)
+    {
+        sampleStability(scenario);
+    }
+    // this step's forcing only reaches the modes next step, so it counts towards the next sample //
+    if (!scenario.pointSources.empty())
+    {
+        stability.drivenSinceSample = true;
+    }
+    scenario.pointSources.erase(std::remove_if(scenario.pointSources.begin(), scenario.pointSources.end(),
+        [](const PointSource& ps)->bool { return !ps.isSounding(); }),
+        scenario.pointSources.end());
+    return true;
+}
+void Map::updateGroupPressures(const Region& region, RegionState& regionState, size_t groupIndex,
+    bool prune, bool sample) const
+{
+    const PartitionGroup& group = region.partitionGroups[groupIndex];
+    // resting groups' pressures are still the zeros they started with //
+    if (regionState.restingGroups[groupIndex])
+    {
+        return;
+    }
+    // Update modes within each partition using equation (8) //
+    const size_t gridSize = group.voxelLengthX*group.voxelLengthY*group.voxelLengthZ;
+    for (size_t p = 0; p < group.partitionIndices.size(); p++)
+    {
+        const size_t memberOffset = group.stateOffset + p*group.stateStride;
+        double* modes = regionState.voxelModes + memberOffset;
+        double* modesPrevious = regionState.voxelModesPrevious + memberOffset;
+        const double* forcingTerms = regionState.voxelForcingTerms + memberOffset;
+        if (sample)
+        {
+            // the same energy acousticEnergy works out, while both steps' modes are still in cache //
+            double energy = 0;
+            double peakMode = 0;
+            for (size_t i = 0; i < gridSize; i++)
+            {
+                const double currMode = modes[i];
+                const double cosTerm = group.modalCosTerms[i];
+                const double mode = 2 * currMode*cosTerm - modesPrevious[i] +
+                    forcingTerms[i] * group.modalForcingCoefficients[i];
+                modes[i] = mode;
+                modesPrevious[i] = currMode;
+                energy += (mode*mode + currMode*currMode - 2 * cosTerm*mode*currMode) / (2 * (1 - cosTerm));
+                // written so a NaN mode still shows up //
+                if (!(fabs(mode) <= peakMode))
+                {
+                    peakMode = fabs(mode);
+                }
+            }
+            regionState.partitionEnergies[group.partitionIndices[p]] = energy;
+            regionState.partitionPeakModes[group.partitionIndices[p]] = peakMode;
+            continue;
+        }
+        for (size_t i = 0; i < gridSize; i++)
+        {
+            const double currMode = modes[i];
+            assert(!_isnan(currMode));
+            // Equation (8):
+            modes[i] =
+                2 * currMode*group.modalCosTerms[i] -
+                modesPrevious[i] +
+                forcingTerms[i] * group.modalForcingCoefficients[i];
+            assert(!_isnan(modes[i]));
+            modesPrevious[i] = currMode;
+        }
+    }
+    // only the planes the forcing reads, and the rest whenever they're wanted //
+    if (prune && group.prunePressures)
+    {
+        std::vector<double>& scratch = regionState.prunedIdctScratch;
+        if (scratch.size() < group.prunedIdct.scratchSize())
+        {
+            scratch.resize(group.prunedIdct.scratchSize());
+        }
+        for (const size_t p : group.partitionIndices)
+        {
+            const Partition& partition = region.partitions[p];
+            for (unsigned axis = 0; axis < 3; axis++)
+            {
+                for (const unsigned position : partition.pressurePlanes[axis])
+                {
+                    group.prunedIdct.executePlane(axis, position, regionState.voxelModes + partition.stateOffset,
+                        regionState.voxelPressures + partition.stateOffset, group.normalization, scratch.data());
+                }
+            }
+        }
+        regionState.pressuresPruned = true;
+        return;
+    }
+    // Transform modes to pressure values via IDCT, one batched plan per group //
+    double* pressures = regionState.voxelPressures + group.stateOffset;
+    executeGroupTransform(group, group.planModeToPressure, FFTW_REDFT01,
+        regionState.voxelModes + group.stateOffset, pressures);
+    // normalize the iDCT result by dividing each cell by 2*size //
+    ///TODO: figure out if I even need this???
+    //const double normalization = 2*group.voxelLengthY * 2*group.voxelLengthX;
+    // the padding between members is never written by the plans, so it stays 0 //
+    const size_t groupSize = group.partitionIndices.size()*group.stateStride;
+    for (size_t i = 0; i < groupSize; i++)
+    {
+        pressures[i] /= group.normalization;
+    }
+}
+void Map::updateGroupForcing(Scenario& scenario, size_t regionIndex, size_t groupIndex,
+    const std::vector<int>& sourceGroups) const
+{
+    const Region& region = regions[regionIndex];
+    const PartitionGroup& group = region.partitionGroups[groupIndex];
+    RegionState& regionState = scenario.regions[regionIndex];
+    const double* stencilWeights = interfaceStencilWeights(options.stencilOrder);
+    const int stencilReach = int(options.stencilOrder / 2);
+    // Compute & accumulate forcing terms at each cell.
+    //  for cells at interfaces, use equation (9),
+    //  and for cells with point sources, use the sample value //
+    for (const size_t p : group.partitionIndices)
+    {
+        const Partition& partition = region.partitions[p];
+        // copy everything the stencils read from across the interfaces into the ghost strips //
+        fillGhostStrips(scenario, regionIndex, partition);
+        double* forcingTerms = regionState.voxelForcingTerms + partition.stateOffset;
+        const double* pressures = regionState.voxelPressures + partition.stateOffset;
+        // zero out the forcing terms first //
+        const size_t gridSize = partition.voxelLengthX*partition.voxelLengthY*partition.voxelLengthZ;
+        for (size_t i = 0; i < gridSize; i++)
+        {
+            forcingTerms[i] = 0;
+        }
+        for (auto& iFace : partition.interfaces)
+        {
+            const unsigned iFaceRight = iFace.voxelX + iFace.voxelLengthX;
+            const unsigned iFaceTop = iFace.voxelY + iFace.voxelLengthY;
+            const unsigned iFaceCeiling = iFace.voxelZ + iFace.voxelLengthZ;
+            const sf::Vector3i& iFaceDirection = DIRECTION_VECS[size_t(iFace.dir)];
+            // Interfaces on the region's edge look into a neighbor which
+            //  might not be streamed in yet.  Until it is, the face stays
+            //  rigid, and the neighbor gets told what's pushing on it //
+            const bool rigidFace = iFace.acrossRegionIndex != regionIndex &&
+                !isRegionActive(scenario, iFace.acrossRegionIndex);
+            const double* ghostPressures = regionState.ghostPressures.data() + iFace.ghostOffset;
+            for (unsigned z = iFace.voxelZ; z < iFaceCeiling; z++)
+            {
+                for (unsigned x = iFace.voxelX; x < iFaceRight; x++)
+                {
+                    for (unsigned y = iFace.voxelY; y < iFaceTop; y++, ghostPressures += HALO_DEPTH)
+                    {
+                        const sf::Vector3i i{ int(x),int(y),int(z) };
+                        unsigned partitionVoxelX = x - partition.voxelX;
+                        unsigned partitionVoxelY = y - partition.voxelY;
+                        unsigned partitionVoxelZ = z - partition.voxelZ;
+                        const size_t partitionI =
+                            (partitionVoxelZ*partition.voxelLengthY + partitionVoxelY)*partition.voxelLengthX +
+                            partitionVoxelX;
+                        if (rigidFace)
+                        {
+                            // other ranks' regions get knocked on their own side of the exchange //
+                            if (isRegionOwned(iFace.acrossRegionIndex))
+                            {
+                                double& knockPressure = scenario.regions[iFace.acrossRegionIndex].knockPressure;
+                                knockPressure = std::max(knockPressure, fabs(pressures[partitionI]));
+                            }
+                            continue;
+                        }
+                        double pressureStencil = 0;
+                        // the near half of the stencil is this partition's own pressures,
+                        //  unless the partition is too thin to hold all of it //
+                        for (int di = 1 - stencilReach; di <= 0; di++)
+                        {
+                            const sf::Vector3i stencil_i = i + iFaceDirection*di;
+                            const sf::Vector3i partition_i = stencil_i -
+                                sf::Vector3i(int(partition.voxelX), int(partition.voxelY), int(partition.voxelZ));
+                            const double* pressure = nullptr;
+                            if (partition_i.x >= 0 && partition_i.x < int(partition.voxelLengthX) &&
+                                partition_i.y >= 0 && partition_i.y < int(partition.voxelLengthY) &&
+                                partition_i.z >= 0 && partition_i.z < int(partition.voxelLengthZ))
+                            {
+                                pressure = pressures +
+                                    (size_t(partition_i.z)*partition.voxelLengthY + partition_i.y)*
+                                    partition.voxelLengthX + partition_i.x;
+                            }
+                            else if (stencil_i.x >= 0 && stencil_i.x < int(voxelGridLengthX) &&
+                                stencil_i.y >= 0 && stencil_i.y < int(voxelGridLengthY) &&
+                                stencil_i.z >= 0 && stencil_i.z < int(voxelGridLengthZ))
+                            {
+                                pressure = findPressure(scenario,
+                                    unsigned(stencil_i.x), unsigned(stencil_i.y), unsigned(stencil_i.z));
+                            }
+                            if (!pressure)
+                            {
+                                // Just discard parts of the stencil that are outside partitions??...
+                                continue;
+                            }
+                            assert(!_isnan(*pressure));
+                            pressureStencil += stencilWeights[di + 2] * *pressure;
+                        }
+                        // ..and the far half is waiting in the ghost strip //
+                        for (int d = 0; d < stencilReach; d++)
+                        {
+                            assert(!_isnan(ghostPressures[d]));
+                            pressureStencil += stencilWeights[d + 3] * ghostPressures[d];
+                        }
+                        // Equation (9): (hopefully?..)
+                        forcingTerms[partitionI] += pow(SOUND_SPEED_METERS_PER_SECOND, 2)*
+                            (1.0 / (180 * pow(simVoxelSpacing,2)))*pressureStencil;
+                        assert(!_isnan(forcingTerms[partitionI]));
+                    }
+                }
+            }
+        }
+    }
+    // lossy materials & absorbing walls bleed energy out of the voxels they fill or line //
+    const auto& dampedVoxels = region.dampedVoxels;
+    for (size_t d = group.dampedBegin; d < group.dampedEnd; d++)
+    {
+        const double pressure = regionState.voxelPressures[dampedVoxels[d].stateIndex];
+        double& pressurePrevious = regionState.dampedPressuresPrevious[d];
+        regionState.voxelForcingTerms[dampedVoxels[d].stateIndex] -=
+            dampedVoxels[d].coefficient*(pressure - pressurePrevious);
+        pressurePrevious = pressure;
+    }
+    // apply the pressure value of every active point-source //
+    for (size_t s = 0; s < sourceGroups.size(); s++)
+    {
+        PointSource& ps = scenario.pointSources[s];
+        if (sourceGroups[s] == int(groupIndex) && ps.stateIndex.region == regionIndex)
+        {
+            regionState.voxelForcingTerms[ps.stateIndex.local] = ps.step();
+            assert(!_isnan(regionState.voxelForcingTerms[ps.stateIndex.local]));
+        }
+    }
+    // Transform forcing terms back to modal space via DCT //
+    double* forcingTerms = regionState.voxelForcingTerms + group.stateOffset;
+    const size_t groupSize = group.partitionIndices.size()*group.stateStride;
+    // Until something forces a group, all of its state stays exactly zero,
+    //  so none of its transforms need running //
+    if (regionState.restingGroups[groupIndex])
+    {
+        if (scenario.skipRestingGroups &&
+            std::all_of(forcingTerms, forcingTerms + groupSize, [](double f) { return f == 0; }))
+        {
+            return;
+        }
+        regionState.restingGroups[groupIndex] = false;
+    }
+    executeGroupTransform(group, group.planForcingToModes, FFTW_REDFT10,
+        forcingTerms, forcingTerms);
+    for (size_t i = 0; i < groupSize; i++)
+    {
+        forcingTerms[i] /= group.normalization;
+    }
+}
+void Map::sampleStability(Scenario& scenario) const
+{
+    StabilityMonitor& stability = scenario.stability;
+    StabilitySample sample;
+    sample.step = scenario.stepCount;
+    sample.driven = stability.drivenSinceSample;
+    stability.drivenSinceSample = false;
+    size_t stepsSinceSample = stability.sampleInterval;
+    if (!stability.history.empty())
+    {
+        stepsSinceSample = sample.step - stability.history.back().step;
+    }
+    const double perStep = 1.0 / double(stepsSinceSample);
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        RegionState& regionState = scenario.regions[r];
+        if (!regionState.isActive())
+        {
+            continue;
+        }
+        for (size_t p = 0; p < regionState.partitionEnergies.size(); p++)
+        {
+            const double energy = regionState.partitionEnergies[p];
+            sample.energy += energy;
+            if (!(regionState.partitionPeakModes[p] <= sample.peakMode))
+            {
+                sample.peakMode = regionState.partitionPeakModes[p];
+            }
+            // partitions which were silent, or only just got state, have nothing to grow from //
+            const double energyPrevious = regionState.partitionEnergiesPrevious[p];
+            if (energyPrevious > 0)
+            {
+                const double growthRate = pow(energy / energyPrevious, perStep);
+                if (!(growthRate <= sample.fastestGrowthRate))
+                {
+                    sample.fastestRegion = unsigned(r);
+                    sample.fastestPartition = p;
+                    sample.fastestGrowthRate = growthRate;
+                }
+            }
+        }
+        regionState.partitionEnergiesPrevious = regionState.partitionEnergies;
+    }
+    if (!stability.history.empty() && stability.history.back().energy > 0)
+    {
+        sample.growthRate = pow(sample.energy / stability.history.back().energy, perStep);
+    }
+    // waves moving between partitions shift energy around, so only the total says whether it's running away //
+    const bool finite = std::isfinite(sample.energy) && std::isfinite(sample.peakMode);
+    if (sample.driven)
+    {
+        stability.drivenEnergy = sample.energy;
+    }
+    const bool diverging = !finite || (!sample.driven && stability.drivenEnergy > 0 &&
+        sample.energy > stability.divergentEnergyRatio*stability.drivenEnergy);
+    stability.divergingSamples = diverging ? stability.divergingSamples + 1 : 0;
+    stability.history.push_back(sample);
+    while (stability.history.size() > stability.historyLength)
+    {
+        stability.history.pop_front();
+    }
+    if (stability.diverged || (finite && stability.divergingSamples < stability.divergentSamples))
+    {
+        return;
+    }
+    stability.diverged = true;
+    if (stability.actions & StabilityMonitor::LOG)
+    {
+        std::cerr << "WARNING: energy diverging at step " << sample.step << ": energy=" << sample.energy <<
+            " (" << sample.energy / stability.drivenEnergy << " times what the sources left) growing " <<
+            sample.growthRate << " per step, peakMode=" << sample.peakMode <<
+            ", fastest in partition " << sample.fastestPartition << " of region " << sample.fastestRegion <<
+            " growing " << sample.fastestGrowthRate << " per step\n";
+    }
+    if (stability.actions & StabilityMonitor::DUMP_CHECKPOINT)
+    {
+        writeCheckpoint(scenario, stability.checkpointFilename);
+    }
+    if (stability.actions & StabilityMonitor::PAUSE)
+    {
+        stability.paused = true;
+    }
+}
+void Map::toggleVoxelGrid()
+{
+    m_showVoxelGrid = !m_showVoxelGrid;
+}
+void Map::togglePartitionMeta()
+{
+    m_showPartitionMeta = !m_showPartitionMeta;
+}
+void Map::togglePause()
+{
+    if (scenario.stability.paused)
+    {
+        scenario.stability.resume();
+    }
+    else
+    {
+        scenario.stability.paused = true;
+    }
+}
+const Map::StabilityMonitor& Map::getStability() const
+{
+    return scenario.stability;
+}
+void Map::moveVisibleSlice(int deltaVoxels)
+{
+    const int newVoxelZ = std::min(std::max(int(visibleVoxelZ) + deltaVoxels, 0), int(voxelGridLengthZ) - 1);
+    if (unsigned(newVoxelZ) == visibleVoxelZ)
+    {
+        return;
+    }
+    visibleVoxelZ = unsigned(newVoxelZ);
+    std::cout << "visibleSlice=" << visibleVoxelZ << " (" << (visibleVoxelZ + 0.5f)*simVoxelSpacing << "m)\n";
+    // everything drawn is a cross section of the visible slice, so rebuild it all //
+    buildMapTileVBO();
+    for (auto& region : regions)
+    {
+        if (region.resident)
+        {
+            buildPartitionVBO(region);
+            buildInterfaceVBO(region);
+        }
+    }
+    pressureRevision++;
+}
+void Map::touch(const sf::Vector2f & worldSpaceLocation)
+{
+    std::cout << "worldSpaceLocation=" << worldSpaceLocation<<std::endl;
+    // first, we need to find out which voxel we're in, if any //
+    StateIndex stateIndex;
+    const sf::Vector3f worldSpaceLocation3d(worldSpaceLocation.x, worldSpaceLocation.y,
+        (visibleVoxelZ + 0.5f)*simVoxelSpacing);
+    if (!findStateIndex(worldSpaceLocation3d, stateIndex))
+    {
+        return;
+    }
+    std::cout << "\tstateIndex={" << stateIndex.region << "," << stateIndex.local << "}\n";
+    // next, we need to update the simulation to assign
+    //  a forcing term at this cell during the simulation's step //
+    PointSource ps(*this, stateIndex, simDeltaTime, PointSource::Type::CLICK);
+    scenario.pointSources.push_back(ps);
+    const double* pressure = findPressure(scenario, stateIndex);
+    std::cout << "\t added a click! pressure=" << (pressure ? *pressure : 0) << "\n";
+}
+void Map::pinViewRegions(const sf::FloatRect & view, std::vector<bool>& pinnedRegions) const
+{
+    const float viewRight = std::min(view.left + view.width, (voxelGridLengthX - 1)*simVoxelSpacing);
+    const float viewTop = std::min(view.top + view.height, (voxelGridLengthY - 1)*simVoxelSpacing);
+    if (view.width <= 0 || view.height <= 0 || viewRight < 0 || viewTop < 0)
+    {
+        return;
+    }
+    const unsigned firstColumn = unsigned(std::max(view.left, 0.f) / simVoxelSpacing) / regionVoxelLength;
+    const unsigned lastColumn = unsigned(viewRight / simVoxelSpacing) / regionVoxelLength;
+    const unsigned firstRow = unsigned(std::max(view.top, 0.f) / simVoxelSpacing) / regionVoxelLength;
+    const unsigned lastRow = unsigned(viewTop / simVoxelSpacing) / regionVoxelLength;
+    for (unsigned row = firstRow; row <= lastRow; row++)
+    {
+        for (unsigned column = firstColumn; column <= lastColumn; column++)
+        {
+            pinnedRegions[row*regionColumns + column] = true;
+        }
+    }
+}
+void Map::setViewBounds(const sf::FloatRect & worldSpaceBounds)
+{
+    scenario.viewBounds = worldSpaceBounds;
+}
+std::vector<Map::PartitionView> Map::partitionViews(const Scenario & scenario) const
+{
+    std::vector<PartitionView> views;
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        const RegionState& regionState = scenario.regions[r];
+        if (!regionState.isActive())
+        {
+            continue;
+        }
+        for (const auto& partition : regions[r].partitions)
+        {
+            views.push_back({ regionState.voxelPressures + partition.stateOffset, unsigned(r),
+                partition.voxelX, partition.voxelY, partition.voxelZ,
+                partition.voxelLengthX, partition.voxelLengthY, partition.voxelLengthZ });
+        }
+    }
+    return views;
+}
+sf::Vector3<unsigned> Map::getVoxelGridLengths() const
+{
+    return { voxelGridLengthX, voxelGridLengthY, voxelGridLengthZ };
+}
+bool Map::setTile(unsigned column, unsigned row, unsigned layer, uint16_t gid,
+    const std::vector<Scenario*>& scenarios)
+{
+    if (column >= mapCols || row >= mapRows || layer >= mapLayers)
+    {
+        std::cerr << "ERROR: tile " << column << "," << row << " of layer " << layer << " is off the map\n";
+        return false;
+    }
+    // the halo links, and how much every rank exchanges, are fixed when the map loads //
+    if (options.rankCount > 1)
+    {
+        std::cerr << "ERROR: tiles can't change while the map is split between ranks\n";
+        return false;
+    }
+    const size_t tileIndex = (size_t(layer)*mapRows + row)*mapCols + column;
+    const uint16_t previousGid = tileIds[tileIndex];
+    if (gid == previousGid)
+    {
+        return true;
+    }
+    std::vector<Scenario*> allScenarios(1, &scenario);
+    allScenarios.insert(allScenarios.end(), scenarios.begin(), scenarios.end());
+    // the new layout's state is projected from every pressure //
+    for (Scenario* s : allScenarios)
+    {
+        completePressures(*s);
+    }
+    // every voxel the cell decides the material of, and one more on each side
+    //  for the interfaces & absorbing linings looking into it //
+    auto voxelSpan = [this](float from, float to, unsigned gridLength, unsigned& first, unsigned& last)->void
+    {
+        first = unsigned(std::max(floorf(from / simVoxelSpacing - 0.5f) - 1, 0.f));
+        last = unsigned(std::min(ceilf(to / simVoxelSpacing - 0.5f) + 1, float(gridLength)));
+    };
+    unsigned boxMin[3];
+    unsigned boxMax[3];
+    voxelSpan(float(column), float(column + 1), voxelGridLengthX, boxMin[0], boxMax[0]);
+    // rows count down from the top of the map //
+    voxelSpan(float(mapRows - row - 1), float(mapRows - row), voxelGridLengthY, boxMin[1], boxMax[1]);
+    boxMin[2] = 0;
+    boxMax[2] = voxelGridLengthZ;
+    if (options.volumetric)
+    {
+        voxelSpan(float(layer), float(layer + 1), voxelGridLengthZ, boxMin[2], boxMax[2]);
+    }
+    auto overlapsBox = [&](const Region& region)->bool
+    {
+        return region.voxelX < boxMax[0] && boxMin[0] < region.voxelX + region.voxelLengthX &&
+            region.voxelY < boxMax[1] && boxMin[1] < region.voxelY + region.voxelLengthY;
+    };
+    std::lock_guard<std::mutex> lock(regionMutex);
+    // Sources & probes hold indices into their region's layout, so an evicted region
+    //  they're in has to come back with the layout they were found in before it changes //
+    for (const Scenario* s : allScenarios)
+    {
+        std::vector<StateIndex> stateIndices;
+        for (const auto& ps : s->pointSources)
+        {
+            stateIndices.push_back(ps.stateIndex);
+        }
+        for (const auto& probe : s->probes)
+        {
+            stateIndices.push_back(probe.stateIndex);
+        }
+        for (const auto& stateIndex : stateIndices)
+        {
+            if (!regions[stateIndex.region].resident && overlapsBox(regions[stateIndex.region]))
+            {
+                makeRegionResident(stateIndex.region);
+            }
+        }
+    }
+    const unsigned materialLayer = options.volumetric ? layer : 0;
+    const size_t cellIndex = (size_t(materialLayer)*mapRows + row)*mapCols + column;
+    const uint8_t previousMaterial = cellMaterials[cellIndex];
+    tileIds[tileIndex] = gid;
+    resolveCellMaterial(column, row, materialLayer);
+    const uint8_t material = cellMaterials[cellIndex];
+    const bool solidityChanged = materials[material].isSolid() != materials[previousMaterial].isSolid();
+    // a probe walled in would have nothing left to listen to //
+    if (solidityChanged && materials[material].isSolid())
+    {
+        for (const Scenario* s : allScenarios)
+        {
+            for (const auto& probe : s->probes)
+            {
+                const Region& region = regions[probe.stateIndex.region];
+                if (!overlapsBox(region))
+                {
+                    continue;
+                }
+                unsigned x, y, z;
+                if (voxelOfStateIndex(probe.stateIndex, x, y, z) && isVoxelSolid(x, y, z))
+                {
+                    std::cerr << "ERROR: tile " << column << "," << row << " of layer " << layer <<
+                        " would wall in a probe\n";
+                    tileIds[tileIndex] = previousGid;
+                    cellMaterials[cellIndex] = previousMaterial;
+                    return false;
+                }
+            }
+        }
+    }
+    buildMapTileVBO();
+    std::cout << "tile " << column << "," << row << " of layer " << layer << " gid=" << gid <<
+        " solidityChanged=" << solidityChanged << std::endl;
+    if (material == previousMaterial)
+    {
+        return true;
+    }
+    // regions which aren't resident get decomposed with the new tile whenever they stream in //
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        Region& region = regions[r];
+        if (!region.resident || !overlapsBox(region))
+        {
+            continue;
+        }
+        if (solidityChanged)
+        {
+            redecomposeRegion(r, boxMin, boxMax, allScenarios);
+            continue;
+        }
+        // still open or still solid, so all that changes is how the open voxels around it are damped //
+        buildDampedVoxels(region);
+        buildStencilReads(region);
+        for (Scenario* s : allScenarios)
+        {
+            RegionState& regionState = s->regions[r];
+            if (!regionState.isActive())
+            {
+                continue;
+            }
+            regionState.dampedPressuresPrevious.resize(region.dampedVoxels.size());
+            for (size_t d = 0; d < region.dampedVoxels.size(); d++)
+            {
+                regionState.dampedPressuresPrevious[d] = regionState.voxelPressures[region.dampedVoxels[d].stateIndex];
+            }
+        }
+    }
+    pressureRevision++;
+    return true;
+}
+void Map::toggleTile(const sf::Vector2f & worldSpaceLocation)
+{
+    if (worldSpaceLocation.x < 0 || worldSpaceLocation.y <= 0 ||
+        worldSpaceLocation.x >= mapCols || worldSpaceLocation.y > mapPixelHeight)
+    {
+        return;
+    }
+    const unsigned column = unsigned(worldSpaceLocation.x);
+    const unsigned row = std::min(unsigned(mapPixelHeight - worldSpaceLocation.y), mapRows - 1);
+    // flat maps toggle the whole stack of tiles in the cell, volumetric ones the visible slice's layer //
+    const unsigned sliceLayer = std::min(unsigned((visibleVoxelZ + 0.5f)*simVoxelSpacing), mapLayers - 1);
+    const unsigned firstLayer = options.volumetric ? sliceLayer : 0;
+    const unsigned lastLayer = options.volumetric ? sliceLayer : mapLayers - 1;
+    const unsigned materialLayer = options.volumetric ? sliceLayer : 0;
+    auto tileIndex = [&](unsigned layer)->size_t
+    {
+        return (size_t(layer)*mapRows + row)*mapCols + column;
+    };
+    if (materials[cellMaterials[(size_t(materialLayer)*mapRows + row)*mapCols + column]].isSolid())
+    {
+        for (unsigned layer = firstLayer; layer <= lastLayer; layer++)
+        {
+            const uint16_t gid = tileIds[tileIndex(layer)];
+            if (gid != 0 && setTile(column, row, layer, 0))
+            {
+                toggledTiles[tileIndex(layer)] = gid;
+            }
+        }
+        return;
+    }
+    // close it back up with whatever was taken out, or failing that the first rigid tile //
+    bool restored = false;
+    for (unsigned layer = firstLayer; layer <= lastLayer; layer++)
+    {
+        const auto it = toggledTiles.find(tileIndex(layer));
+        if (it != toggledTiles.end() && setTile(column, row, layer, it->second))
+        {
+            toggledTiles.erase(it);
+            restored = true;
+        }
+    }
+    if (!restored)
+    {
+        uint16_t gid = 1;
+        while (gid < gidMaterials.size() && gidMaterials[gid] != MATERIAL_RIGID)
+        {
+            gid++;
+        }
+        setTile(column, row, lastLayer, gid);
+    }
+}
+Map::Scenario Map::createScenario() const
+{
+    Scenario newScenario;
+    newScenario.regions.resize(regions.size());
+    newScenario.haloPressures.resize(haloLinks.size());
+    for (size_t l = 0; l < haloLinks.size(); l++)
+    {
+        const HaloLink& link = haloLinks[l];
+        if (isRegionOwned(link.neighborRegionIndex))
+        {
+            newScenario.haloPressures[l].resize(link.openVoxels.size(), 0);
+        }
+    }
+    return newScenario;
+}
+void Map::streamScenario(Scenario & scenario)
+{
+    assert(scenario.regions.size() == regions.size());
+    // regions holding sources, probes or the view stay streamed in regardless //
+    std::vector<bool> pinnedRegions(regions.size(), false);
+    for (const auto& ps : scenario.pointSources)
+    {
+        pinnedRegions[ps.stateIndex.region] = true;
+    }
+    for (const auto& probe : scenario.probes)
+    {
+        pinnedRegions[probe.stateIndex.region] = true;
+    }
+    pinViewRegions(scenario.viewBounds, pinnedRegions);
+    // quietness is only checked every so often, since it means scanning every pressure //
+    const unsigned QUIET_CHECKS_TO_DROP = unsigned(
+        ceil(REGION_QUIET_SECONDS / (REGION_QUIET_CHECK_STEPS*simDeltaTime)));
+    const bool checkQuiet = ++scenario.stepsSinceQuietCheck >= REGION_QUIET_CHECK_STEPS;
+    if (checkQuiet)
+    {
+        scenario.stepsSinceQuietCheck = 0;
+    }
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        RegionState& regionState = scenario.regions[r];
+        if (!isRegionOwned(r))
+        {
+            continue;
+        }
+        if (!regionState.isActive())
+        {
+            if (pinnedRegions[r] || regionState.knockPressure > REGION_ACTIVITY_PRESSURE)
+            {
+                activateRegion(scenario, r);
+            }
+            regionState.knockPressure = 0;
+            continue;
+        }
+        if (!checkQuiet || pinnedRegions[r])
+        {
+            continue;
+        }
+        if (regionState.pressuresPruned)
+        {
+            completeRegionPressures(regions[r], regionState);
+        }
+        double peakPressure = 0;
+        for (size_t i = 0; i < regionState.stateSize; i++)
+        {
+            peakPressure = std::max(peakPressure, fabs(regionState.voxelPressures[i]));
+        }
+        if (peakPressure > REGION_ACTIVITY_PRESSURE)
+        {
+            regionState.quietChecks = 0;
+        }
+        else if (++regionState.quietChecks >= QUIET_CHECKS_TO_DROP)
+        {
+            deactivateRegion(scenario, r);
+        }
+    }
+}
+void Map::releaseScenario(Scenario & scenario)
+{
+    for (size_t r = 0; r < scenario.regions.size(); r++)
+    {
+        if (scenario.regions[r].isActive())
+        {
+            deactivateRegion(scenario, r);
+        }
+    }
+}
+bool Map::findStateIndex(const sf::Vector3f & worldSpaceLocation, StateIndex & outStateIndex)
+{
+    if (worldSpaceLocation.x < 0 || worldSpaceLocation.y < 0 || worldSpaceLocation.z < 0)
+    {
+        return false;
+    }
+    const unsigned gridX = unsigned(worldSpaceLocation.x / simVoxelSpacing);
+    const unsigned gridY = unsigned(worldSpaceLocation.y / simVoxelSpacing);
+    // flat maps only have the one slice, however high up the location is //
+    const unsigned gridZ = options.volumetric ? unsigned(worldSpaceLocation.z / simVoxelSpacing) : 0;
+    if (gridX >= voxelGridLengthX || gridY >= voxelGridLengthY || gridZ >= voxelGridLengthZ)
+    {
+        return false;
+    }
+    const size_t regionIndex = regionIndexOf(gridX, gridY);
+    std::lock_guard<std::mutex> lock(regionMutex);
+    const Region& region = regions[regionIndex];
+    if (!region.resident)
+    {
+        makeRegionResident(regionIndex);
+    }
+    const int stateIndex = region.stateLookupTable[
+        (gridZ*region.voxelLengthY + gridY - region.voxelY)*region.voxelLengthX + gridX - region.voxelX];
+    if (stateIndex < 0)
+    {
+        return false;
+    }
+    // decomposition is deterministic, so this stays valid even if the region gets evicted,
+    //  as long as setTile doesn't re-decompose it in the meantime //
+    outStateIndex = StateIndex(unsigned(regionIndex), size_t(stateIndex));
+    return true;
+}
+size_t Map::maxHaloPayload() const
+{
+    size_t maxPayload = 0;
+    for (unsigned fromRank = 0; fromRank < options.rankCount; fromRank++)
+    {
+        for (unsigned toRank = 0; toRank < options.rankCount; toRank++)
+        {
+            if (fromRank != toRank)
+            {
+                maxPayload = std::max(maxPayload, haloPayloadSize(fromRank, toRank));
+            }
+        }
+    }
+    return maxPayload;
+}
+bool Map::loadJsonMap(const std::string& jsonMapFilename)
+{
+    TiledMapReader reader;
+    if (!reader.read(jsonMapFilename))
+    {
+        return false;
+    }
+    tileSheets.clear();
+    for (const auto& tileset : reader.tilesets)
+    {
+        tileSheets.push_back({ tileset.image, tileset.firstGid,
+            tileset.tileWidth, tileset.tileHeight, std::max(1u, tileset.columns) });
+    }
+    // Tiled writes them in firstgid order already, but the gid lookups rely on it //
+    std::stable_sort(tileSheets.begin(), tileSheets.end(),
+        [](const TileSheet& a, const TileSheet& b)->bool { return a.firstGid < b.firstGid; });
+    mapCols = reader.tileLayers[0].width;
+    mapRows = reader.tileLayers[0].height;
+    mapLayers = unsigned(reader.tileLayers.size());
+    mapPixelHeight = float(mapRows);// *tilePixH);
+    tileIds.clear();
+    tileIds.reserve(size_t(mapLayers)*mapRows*mapCols);
+    for (auto& tileLayer : reader.tileLayers)
+    {
+        tileIds.insert(tileIds.end(), tileLayer.tiles.begin(), tileLayer.tiles.end());
+        std::vector<uint16_t>().swap(tileLayer.tiles);
+    }
+    // every distinct set of tile properties becomes one material //
+    materials.assign({ Material(0, 1), Material(0, 0) });
+    gidMaterials.clear();
+    for (const auto& tileset : reader.tilesets)
+    {
+        for (const auto& tile : tileset.tileProperties)
+        {
+            Material material;
+            const auto absorption = tile.second.find("absorption");
+            const auto transmission = tile.second.find("transmission");
+            if (absorption == tile.second.end() && transmission == tile.second.end())
+            {
+                continue;
+            }
+            if (absorption != tile.second.end())
+            {
+                material.absorption = float(std::min(std::max(absorption->second, 0.0), 1.0));
+            }
+            if (transmission != tile.second.end())
+            {
+                material.transmission = float(std::min(std::max(transmission->second, 0.0), 1.0));
+            }
+            size_t m = std::find(materials.begin(), materials.end(), material) - materials.begin();
+            if (m == materials.size())
+            {
+                if (materials.size() > UINT8_MAX)
+                {
+                    std::cerr << "ERROR: \"" << jsonMapFilename << "\" has more than " << UINT8_MAX <<
+                        " different tile materials\n";
+                    return false;
+                }
+                materials.push_back(material);
+            }
+            const size_t gid = size_t(tileset.firstGid) + tile.first;
+            if (gid > UINT16_MAX)
+            {
+                continue;
+            }
+            if (gidMaterials.size() <= gid)
+            {
+                gidMaterials.resize(gid + 1, MATERIAL_RIGID);
+            }
+            gidMaterials[gid] = uint8_t(m);
+        }
+    }
+    materialLayers = options.volumetric ? mapLayers : 1;
+    cellMaterials.assign(size_t(materialLayers)*mapRows*mapCols, MATERIAL_AIR);
+    for (unsigned layer = 0; layer < materialLayers; layer++)
+    {
+        for (unsigned row = 0; row < mapRows; row++)
+        {
+            for (unsigned column = 0; column < mapCols; column++)
+            {
+                resolveCellMaterial(column, row, layer);
+            }
+        }
+    }
+    std::cout << "materials=" << materials.size() << "\n";
+    return true;
+}
+void Map::resolveCellMaterial(unsigned column, unsigned row, unsigned materialLayer)
+{
+    // Flat maps keep whichever of a cell's stacked tiles lets the least sound through,
+    //  or absorbs the most of it if they let through the same //
+    const size_t cellCount = size_t(mapRows)*mapCols;
+    const size_t cell = size_t(row)*mapCols + column;
+    const unsigned firstLayer = options.volumetric ? materialLayer : 0;
+    const unsigned lastLayer = options.volumetric ? materialLayer : mapLayers - 1;
+    uint8_t& cellMaterial = cellMaterials[materialLayer*cellCount + cell];
+    cellMaterial = MATERIAL_AIR;
+    for (unsigned layer = firstLayer; layer <= lastLayer; layer++)
+    {
+        const uint16_t gid = tileIds[layer*cellCount + cell];
+        if (gid == 0)
+        {
+            continue;
+        }
+        const uint8_t m = gid < gidMaterials.size() ? gidMaterials[gid] : MATERIAL_RIGID;
+        const Material& material = materials[m];
+        const Material& current = materials[cellMaterial];
+        if (material.transmission < current.transmission ||
+            (material.transmission == current.transmission && material.absorption > current.absorption))
+        {
+            cellMaterial = m;
+        }
+    }
+}
+bool Map::loadTilesets(const std::string& jsonMapFilename)
+{
+    // extract the map's folder string //
+    std::string strMapAssetFolder;
+    size_t folderSlashIndex = jsonMapFilename.find_last_of("/");
+    if (folderSlashIndex != std::string::npos)
+    {
+        strMapAssetFolder = jsonMapFilename.substr(0, folderSlashIndex + 1);
+    }
+    for (auto& sheet : tileSheets)
+    {
+        // tileset images are relative to the map //
+        const std::string strTilesetFilename = strMapAssetFolder + sheet.image;
+        if (!sheet.texture.loadFromFile(strTilesetFilename))
+        {
+            std::cerr << "ERROR: could not load tileset image! \"" << strTilesetFilename << "\"";
+            return false;
+        }
+    }
+    return true;
+}
+void Map::buildMapTileVBO()
+{
+    // flat maps draw every tile layer, volumetric ones only the layer holding the visible slice //
+    unsigned firstLayer = 0;
+    unsigned lastLayer = mapLayers - 1;
+    if (options.volumetric)
+    {
+        firstLayer = lastLayer = std::min(unsigned((visibleVoxelZ + 0.5f)*simVoxelSpacing), mapLayers - 1);
+    }
+    tileBatches.clear();
+    for (unsigned layer = firstLayer; layer <= lastLayer; layer++)
+    {
+        const uint16_t* layerTileIds = tileIds.data() + size_t(layer)*mapRows*mapCols;
+        const size_t firstBatch = tileBatches.size();
+        for (size_t s = 0; s < tileSheets.size(); s++)
+        {
+            tileBatches.push_back(TileBatch(s));
+        }
+        for (unsigned r = 0; r < mapRows; r++)
+        {
+            for (unsigned c = 0; c < mapCols; c++)
+            {
+                const unsigned gid = layerTileIds[r*mapCols + c];
+                if (gid == 0 || gid < tileSheets.front().firstGid)
+                {
+                    continue;
+                }
+                // each gid belongs to the last sheet starting at or before it //
+                size_t s = tileSheets.size() - 1;
+                while (tileSheets[s].firstGid > gid)
+                {
+                    s--;
+                }
+                const TileSheet& sheet = tileSheets[s];
+                const unsigned tileId = gid - sheet.firstGid;
+                const unsigned TILESET_ROW = tileId / sheet.columns;
+                const unsigned TILESET_COL = tileId % sheet.columns;
+                const sf::Vector2f TILE_UPPER_LEFT(float(TILESET_COL*sheet.tileWidth), float(TILESET_ROW*sheet.tileHeight));
+                const float tilePixW = float(sheet.tileWidth);
+                const float tilePixH = float(sheet.tileHeight);
+                sf::VertexArray& va = tileBatches[firstBatch + s].vertices;
+                va.append(sf::Vertex({ float(c * 1),    float(mapPixelHeight - (r) * 1) },
+                    TILE_UPPER_LEFT + sf::Vector2f{ 0.f,0.f }));
+                va.append(sf::Vertex({ float((c + 1) * 1),float(mapPixelHeight - (r) * 1) },
+                    TILE_UPPER_LEFT + sf::Vector2f{ tilePixW,0.f }));
+                va.append(sf::Vertex({ float((c + 1) * 1),float(mapPixelHeight - (r + 1) * 1) },
+                    TILE_UPPER_LEFT + sf::Vector2f{ tilePixW,tilePixH }));
+                va.append(sf::Vertex({ float(c * 1),    float(mapPixelHeight - (r + 1) * 1) },
+                    TILE_UPPER_LEFT + sf::Vector2f{ 0.f,tilePixH }));
+            }
+        }
+    }
+    tileBatches.erase(std::remove_if(tileBatches.begin(), tileBatches.end(),
+        [](const TileBatch& batch)->bool { return batch.vertices.getVertexCount() == 0; }),
+        tileBatches.end());
+}
+Map::ResolutionPlan Map::planResolution(float maximumSoundHz) const
+{
+    ResolutionPlan plan(maximumSoundHz);
+    const float voxelSpacing = SOUND_SPEED_METERS_PER_SECOND/(2*maximumSoundHz);
+    plan.voxelGridLengthX = unsigned(mapCols / voxelSpacing);
+    plan.voxelGridLengthY = unsigned(mapRows / voxelSpacing);
+    plan.voxelGridLengthZ = options.volumetric ? unsigned(mapLayers / voxelSpacing) : 1;
+    // every voxel takes after the cell it's in, so the cells give the share of open & lossy ones //
+    size_t openCells = 0;
+    size_t lossyCells = 0;
+    for (const uint8_t material : cellMaterials)
+    {
+        if (!materials[material].isSolid())
+        {
+            openCells++;
+            if (material != MATERIAL_AIR)
+            {
+                lossyCells++;
+            }
+        }
+    }
+    const double cellCount = double(std::max(size_t(1), cellMaterials.size()));
+    const double gridVoxels = double(plan.voxelGridLengthX)*plan.voxelGridLengthY*plan.voxelGridLengthZ;
+    plan.openVoxels = gridVoxels*openCells / cellCount;
+    const double dampedVoxels = gridVoxels*lossyCells / cellCount;
+    // partitions never cross region edges, so at the least every open voxel along them is on an interface //
+    const unsigned regionLength = std::max(1u, unsigned(options.regionTiles / voxelSpacing));
+    const unsigned regionColumns = (plan.voxelGridLengthX + regionLength - 1) / regionLength;
+    const unsigned regionRows = (plan.voxelGridLengthY + regionLength - 1) / regionLength;
+    const double edgeVoxels = (double(std::max(1u, regionColumns) - 1)*plan.voxelGridLengthY +
+        double(std::max(1u, regionRows) - 1)*plan.voxelGridLengthX)*plan.voxelGridLengthZ;
+    plan.interfaceVoxels = 2 * edgeVoxels*openCells / cellCount;
+    // ranks split the regions about evenly between them //
+    const double share = 1.0 / options.rankCount;
+    const double scenarios = std::max(1u, options.concurrentScenarios);
+    plan.stateBytes = size_t(4 * sizeof(double)*plan.openVoxels*scenarios*share);
+    plan.ghostBytes = size_t(HALO_DEPTH*(sizeof(int) + sizeof(double)*scenarios)*plan.interfaceVoxels*share);
+    plan.dampingBytes = size_t((sizeof(DampedVoxel) + sizeof(double)*scenarios)*dampedVoxels*share);
+    // at worst, no two partitions of a region are the same size //
+    plan.modalTermBytes = size_t(2 * sizeof(double)*plan.openVoxels*share);
+    plan.lookupBytes = size_t((sizeof(int) + sizeof(VoxelMeta))*gridVoxels*share);
+    plan.visualBytes = size_t(4 * double(plan.voxelGridLengthX)*plan.voxelGridLengthY*share);
+    // Equation (8) is 5 flops a mode, & each of the two DCTs about 2.5 N log2 N for
+    //  a partition of N voxels, which is at most a whole region.  The interface stencils
+    //  multiply & add 2*HALO_DEPTH voxels for each interface voxel //
+    const double largestPartition = double(regionLength)*regionLength*plan.voxelGridLengthZ;
+    plan.flopsPerStep = (plan.openVoxels*(5 + 2 * 2.5*log2(std::max(2.0, largestPartition))) +
+        plan.interfaceVoxels * 4 * HALO_DEPTH)*share;
+    return plan;
+}
+bool Map::chooseResolution()
+{
+    const size_t budget = options.memoryBudget;
+    if (!(options.maximumSoundHz >= MIN_SOUND_HZ))
+    {
+        std::cerr << "ERROR: can't simulate below " << MIN_SOUND_HZ <<
+            "Hz, where each tile is still at least one voxel across\n";
+        return false;
+    }
+    auto megabytes = [](double bytes)->double { return bytes / (1024 * 1024); };
+    ResolutionPlan plan = planResolution(options.maximumSoundHz);
+    if (budget > 0 && plan.totalBytes() > budget)
+    {
+        const ResolutionPlan coarsest = planResolution(MIN_SOUND_HZ);
+        if (coarsest.totalBytes() > budget)
+        {
+            std::cerr << "ERROR: even at " << MIN_SOUND_HZ << "Hz the map needs about " <<
+                megabytes(double(coarsest.totalBytes())) << "MiB, more than the budget of " <<
+                megabytes(double(budget)) << "MiB\n";
+            return false;
+        }
+        // memory only grows with the frequency, so bisect for the highest whole Hz that fits //
+        float fits = MIN_SOUND_HZ;
+        float tooHigh = options.maximumSoundHz;
+        while (tooHigh - fits > 1)
+        {
+            const float middle = floorf((fits + tooHigh) / 2);
+            if (middle <= fits)
+            {
+                break;
+            }
+            if (planResolution(middle).totalBytes() > budget)
+            {
+                tooHigh = middle;
+            }
+            else
+            {
+                fits = middle;
+            }
+        }
+        plan = planResolution(fits);
+        std::cout << "lowered maximumSoundHz from " << options.maximumSoundHz << " to " <<
+            plan.maximumSoundHz << " to fit the memory budget\n";
+        options.maximumSoundHz = plan.maximumSoundHz;
+    }
+    std::cout << "resolution plan at " << plan.maximumSoundHz << "Hz: voxel grid={" <<
+        plan.voxelGridLengthX << "x" << plan.voxelGridLengthY << "x" << plan.voxelGridLengthZ << "} openVoxels~" <<
+        size_t(plan.openVoxels) << " MFLOP/step~" << plan.flopsPerStep / 1e6 <<
+        " per scenario, with every region streamed in" << (options.rankCount > 1 ? " on this rank" : "") << "\n" <<
+        "\twave state " << megabytes(double(plan.stateBytes)) << "MiB (" <<
+        std::max(1u, options.concurrentScenarios) << " scenarios)\n" <<
+        "\tghost strips " << megabytes(double(plan.ghostBytes)) << "MiB\n" <<
+        "\tdamping " << megabytes(double(plan.dampingBytes)) << "MiB\n" <<
+        "\tmodal terms " << megabytes(double(plan.modalTermBytes)) << "MiB\n" <<
+        "\tlookup tables " << megabytes(double(plan.lookupBytes)) << "MiB\n" <<
+        "\tpressure texture " << megabytes(double(plan.visualBytes)) << "MiB\n" <<
+        "\ttotal " << megabytes(double(plan.totalBytes())) << "MiB";
+    if (budget > 0)
+    {
+        std::cout << " of a " << megabytes(double(budget)) << "MiB budget";
+    }
+    std::cout << "\n";
+    setMaximumSoundHz(plan.maximumSoundHz);
+    return true;
+}
+void Map::setMaximumSoundHz(float maximumSoundHz)
+{
+    this->maximumSoundHz = maximumSoundHz;
+    simVoxelSpacing = SOUND_SPEED_METERS_PER_SECOND/(2*maximumSoundHz);
+    simDeltaTime = simVoxelSpacing/(SOUND_SPEED_METERS_PER_SECOND*sqrtf(3));
+    // exp(-(2 pi f sigma)^2 / 2) is the pulse spectrum's fall-off, so this sigma puts it at -60dB by the top frequency //
+    const double sigma = sqrt(2 * log(1000.0)) / (2 * PI*maximumSoundHz);
+    const size_t halfLength = size_t(ceil(4 * sigma / simDeltaTime));
+    gaussianPulseTable.resize(2 * halfLength + 1);
+    for (size_t s = 0; s < gaussianPulseTable.size(); s++)
+    {
+        const double t = (double(s) - double(halfLength))*simDeltaTime;
+        gaussianPulseTable[s] = exp(-t*t / (2 * sigma*sigma));
+    }
+}
+void Map::sizeVoxelGrid()
+{
+    voxelGridLengthY = unsigned(mapRows / simVoxelSpacing);
+    voxelGridLengthX = unsigned(mapCols / simVoxelSpacing);
+    voxelGridLengthZ = options.volumetric ? unsigned(mapLayers / simVoxelSpacing) : 1;
+    std::cout << "voxel grid={" << voxelGridLengthX << "x" << voxelGridLengthY;
+    if (options.volumetric)
+    {
+        std::cout << "x" << voxelGridLengthZ;
+    }
+    std::cout << "}\n";
+}
+void Map::buildVoxelGridLines(const sf::IntRect& visibleVoxels, unsigned lod)
+{
+    const unsigned lineSpacing = 1u << lod;
+    const float left = float(visibleVoxels.left*simVoxelSpacing);
+    const float right = float((visibleVoxels.left + visibleVoxels.width)*simVoxelSpacing);
+    const float bottom = float(visibleVoxels.top*simVoxelSpacing);
+    const float top = float((visibleVoxels.top + visibleVoxels.height)*simVoxelSpacing);
+    vaSimGridLines = sf::VertexArray(sf::PrimitiveType::Lines);
+    // lines stay on multiples of the spacing so they don't crawl as the view pans //
+    const unsigned firstRow = (unsigned(visibleVoxels.top) + lineSpacing - 1) / lineSpacing*lineSpacing;
+    for (unsigned r = firstRow; r <= unsigned(visibleVoxels.top + visibleVoxels.height); r += lineSpacing)
+    {
+        vaSimGridLines.append(sf::Vertex({ left, float(r*simVoxelSpacing) }));
+        vaSimGridLines.append(sf::Vertex({ right, float(r*simVoxelSpacing) }));
+    }
+    const unsigned firstColumn = (unsigned(visibleVoxels.left) + lineSpacing - 1) / lineSpacing*lineSpacing;
+    for (unsigned c = firstColumn; c <= unsigned(visibleVoxels.left + visibleVoxels.width); c += lineSpacing)
+    {
+        vaSimGridLines.append(sf::Vertex({ float(c*simVoxelSpacing), top }));
+        vaSimGridLines.append(sf::Vertex({ float(c*simVoxelSpacing), bottom }));
+    }
+}
+void Map::buildRegions()
+{
+    regionVoxelLength = std::max(1u, unsigned(options.regionTiles / simVoxelSpacing));
+    regionColumns = (voxelGridLengthX + regionVoxelLength - 1) / regionVoxelLength;
+    const unsigned regionRows = (voxelGridLengthY + regionVoxelLength - 1) / regionVoxelLength;
+    regions.clear();
+    regions.reserve(regionRows*regionColumns);
+    for (unsigned row = 0; row < regionRows; row++)
+    {
+        for (unsigned column = 0; column < regionColumns; column++)
+        {
+            const unsigned x = column*regionVoxelLength;
+            const unsigned y = row*regionVoxelLength;
+            regions.push_back({ x, y,
+                std::min(regionVoxelLength, voxelGridLengthX - x),
+                std::min(regionVoxelLength, voxelGridLengthY - y) });
+        }
+    }
+    std::cout << "regions={" << regionColumns << "x" << regionRows << "}\n";
+}
+void Map::assignRegionRanks()
+{
+    regionRanks.assign(regions.size(), 0);
+    if (options.rankCount < 2)
+    {
+        return;
+    }
+    const unsigned regionRows = unsigned(regions.size()) / regionColumns;
+    // a region costs about as much as the open space it has to simulate, so weigh
+    //  each one by the open cells whose centers land inside it //
+    std::vector<double> regionWeights(regions.size(), 0);
+    for (unsigned layer = 0; layer < materialLayers; layer++)
+    {
+        for (unsigned row = 0; row < mapRows; row++)
+        {
+            for (unsigned col = 0; col < mapCols; col++)
+            {
+                if (materials[cellMaterials[(size_t(layer)*mapRows + row)*mapCols + col]].isSolid())
+                {
+                    continue;
+                }
+                const unsigned voxelX = std::min(unsigned((col + 0.5f) / simVoxelSpacing), voxelGridLengthX - 1);
+                const unsigned voxelY = std::min(unsigned((mapPixelHeight - (row + 0.5f)) / simVoxelSpacing),
+                    voxelGridLengthY - 1);
+                regionWeights[regionIndexOf(voxelX, voxelY)]++;
+            }
+        }
+    }
+    auto blockWeight = [&](unsigned column0, unsigned column1, unsigned row0, unsigned row1)->double
+    {
+        double weight = 0;
+        for (unsigned row = row0; row < row1; row++)
+        {
+            for (unsigned column = column0; column < column1; column++)
+            {
+                weight += regionWeights[row*regionColumns + column];
+            }
+        }
+        return weight;
+    };
+    // how many pairs of open voxels a cut would separate, each of which becomes halo traffic //
+    auto cutFaces = [&](bool splitColumns, unsigned at, unsigned first, unsigned last)->size_t
+    {
+        const unsigned boundary = at*regionVoxelLength;
+        const unsigned alongFirst = first*regionVoxelLength;
+        const unsigned alongLast = std::min(last*regionVoxelLength,
+            splitColumns ? voxelGridLengthY : voxelGridLengthX);
+        size_t faces = 0;
+        for (unsigned z = 0; z < voxelGridLengthZ; z++)
+        {
+            for (unsigned along = alongFirst; along < alongLast; along++)
+            {
+                const bool open = splitColumns ?
+                    !isVoxelSolid(boundary - 1, along, z) && !isVoxelSolid(boundary, along, z) :
+                    !isVoxelSolid(along, boundary - 1, z) && !isVoxelSolid(along, boundary, z);
+                if (open)
+                {
+                    faces++;
+                }
+            }
+        }
+        return faces;
+    };
+    // recursive coordinate bisection: split the block of regions where the two halves'
+    //  weights best match their share of the ranks, then do the same to each half //
+    std::function<void(unsigned, unsigned, unsigned, unsigned, unsigned, unsigned)> bisect =
+        [&](unsigned column0, unsigned column1, unsigned row0, unsigned row1, unsigned rank0, unsigned rank1)->void
+    {
+        const unsigned rankCount = rank1 - rank0;
+        if (rankCount == 1 || (column1 - column0 == 1 && row1 - row0 == 1))
+        {
+            for (unsigned row = row0; row < row1; row++)
+            {
+                for (unsigned column = column0; column < column1; column++)
+                {
+                    regionRanks[row*regionColumns + column] = rank0;
+                }
+            }
+            return;
+        }
+        const unsigned lowerRankCount = rankCount / 2;
+        const double totalWeight = blockWeight(column0, column1, row0, row1);
+        const double targetWeight = totalWeight*lowerRankCount / rankCount;
+        struct Cut
+        {
+            bool splitColumns;
+            unsigned at;
+            double imbalance;
+        };
+        std::vector<Cut> cuts;
+        for (unsigned column = column0 + 1; column < column1; column++)
+        {
+            cuts.push_back({ true, column, fabs(blockWeight(column0, column, row0, row1) - targetWeight) });
+        }
+        for (unsigned row = row0 + 1; row < row1; row++)
+        {
+            cuts.push_back({ false, row, fabs(blockWeight(column0, column1, row0, row) - targetWeight) });
+        }
+        double bestImbalance = cuts.front().imbalance;
+        for (const auto& cut : cuts)
+        {
+            bestImbalance = std::min(bestImbalance, cut.imbalance);
+        }
+        // among the cuts within 2% of the best balance, the one with the least interface wins //
+        const Cut* chosenCut = nullptr;
+        size_t chosenFaces = 0;
+        for (const auto& cut : cuts)
+        {
+            if (cut.imbalance > bestImbalance + 0.02*totalWeight)
+            {
+                continue;
+            }
+            const size_t faces = cut.splitColumns ?
+                cutFaces(true, cut.at, row0, row1) : cutFaces(false, cut.at, column0, column1);
+            if (!chosenCut || faces < chosenFaces)
+            {
+                chosenCut = &cut;
+                chosenFaces = faces;
+            }
+        }
+        if (chosenCut->splitColumns)
+        {
+            bisect(column0, chosenCut->at, row0, row1, rank0, rank0 + lowerRankCount);
+            bisect(chosenCut->at, column1, row0, row1, rank0 + lowerRankCount, rank1);
+        }
+        else
+        {
+            bisect(column0, column1, row0, chosenCut->at, rank0, rank0 + lowerRankCount);
+            bisect(column0, column1, chosenCut->at, row1, rank0 + lowerRankCount, rank1);
+        }
+    };
+    bisect(0, regionColumns, 0, regionRows, 0, options.rankCount);
+    std::vector<double> rankWeights(options.rankCount, 0);
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        rankWeights[regionRanks[r]] += regionWeights[r];
+    }
+    std::cout << "rank " << options.rank << "/" << options.rankCount << " region weights={";
+    for (unsigned k = 0; k < options.rankCount; k++)
+    {
+        std::cout << (k > 0 ? "," : "") << rankWeights[k];
+    }
+    std::cout << "}\n";
+}
+void Map::buildHaloLinks()
+{
+    haloLinks.clear();
+    haloLinkBySide.assign(regions.size() * 4, -1);
+    const unsigned regionRows = unsigned(regions.size()) / regionColumns;
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        const Region& region = regions[r];
+        const unsigned column = unsigned(r % regionColumns);
+        const unsigned row = unsigned(r / regionColumns);
+        const unsigned depthX = std::min(HALO_DEPTH, region.voxelLengthX);
+        const unsigned depthY = std::min(HALO_DEPTH, region.voxelLengthY);
+        const unsigned regionRight = region.voxelX + region.voxelLengthX;
+        const unsigned regionTop = region.voxelY + region.voxelLengthY;
+        // sides: left, right, bottom, top //
+        for (unsigned side = 0; side < 4; side++)
+        {
+            size_t neighborIndex;
+            if (side == 0 && column > 0)
+            {
+                neighborIndex = r - 1;
+            }
+            else if (side == 1 && column + 1 < regionColumns)
+            {
+                neighborIndex = r + 1;
+            }
+            else if (side == 2 && row > 0)
+            {
+                neighborIndex = r - regionColumns;
+            }
+            else if (side == 3 && row + 1 < regionRows)
+            {
+                neighborIndex = r + regionColumns;
+            }
+            else
+            {
+                continue;
+            }
+            if (regionRanks[neighborIndex] == regionRanks[r])
+            {
+                continue;
+            }
+            const unsigned stripX = side == 1 ? regionRight - depthX : region.voxelX;
+            const unsigned stripY = side == 3 ? regionTop - depthY : region.voxelY;
+            HaloLink link(r, neighborIndex, stripX, stripY,
+                side < 2 ? depthX : region.voxelLengthX,
+                side < 2 ? region.voxelLengthY : depthY,
+                voxelGridLengthZ);
+            const sf::Vector2i acrossOffset = side == 0 ? sf::Vector2i(-1, 0) : side == 1 ? sf::Vector2i(1, 0) :
+                side == 2 ? sf::Vector2i(0, -1) : sf::Vector2i(0, 1);
+            for (unsigned z = 0; z < link.voxelLengthZ; z++)
+            {
+                for (unsigned y = 0; y < link.voxelLengthY; y++)
+                {
+                    for (unsigned x = 0; x < link.voxelLengthX; x++)
+                    {
+                        const unsigned gridX = link.voxelX + x;
+                        const unsigned gridY = link.voxelY + y;
+                        const size_t h = (size_t(z)*link.voxelLengthY + y)*link.voxelLengthX + x;
+                        link.openVoxels[h] = !isVoxelSolid(gridX, gridY, z);
+                        // open voxels touching open voxels across the edge are interface voxels,
+                        //  the ones which knock on the neighbor while it's inactive //
+                        const bool onEdge = (side == 0 && gridX == region.voxelX) ||
+                            (side == 1 && gridX + 1 == regionRight) ||
+                            (side == 2 && gridY == region.voxelY) ||
+                            (side == 3 && gridY + 1 == regionTop);
+                        if (onEdge && link.openVoxels[h] &&
+                            !isVoxelSolid(gridX + acrossOffset.x, gridY + acrossOffset.y, z))
+                        {
+                            link.faceVoxels.push_back(h);
+                        }
+                    }
+                }
+            }
+            if (regionRanks[neighborIndex] == options.rank)
+            {
+                haloLinkBySide[r * 4 + side] = int(haloLinks.size());
+            }
+            haloLinks.push_back(link);
+        }
+    }
+}
+void Map::makeRegionResident(size_t regionIndex)
+{
+    Region& region = regions[regionIndex];
+    decomposeVoxelsIntoPartitions(region);
+    buildPartitionVBO(region);
+    calculatePartitionInterfaces(region);
+    buildGhostStrips(region);
+    buildDampedVoxels(region);
+    buildStencilReads(region);
+    buildInterfaceVBO(region);
+    planPartitionTransforms(region);
+    region.resident = true;
+    size_t simulationVoxelTotal = 0;///DEBUG
+    for (const auto& partition : region.partitions)
+    {
+        simulationVoxelTotal += partition.voxelLengthX*partition.voxelLengthY*partition.voxelLengthZ;
+    }
+    const auto prunedGroups = std::count_if(region.partitionGroups.begin(), region.partitionGroups.end(),
+        [](const PartitionGroup& group) { return group.prunePressures; });
+    std::cout << "region " << regionIndex << " streamed in: simulationVoxelTotal=" << simulationVoxelTotal <<
+        " partitions=" << region.partitions.size() << " partitionGroups=" << region.partitionGroups.size() <<
+        " prunedGroups=" << prunedGroups <<
+        " numInterfaces=" << region.numInterfaces << " dampedVoxels=" << region.dampedVoxels.size() << std::endl;
+}
+void Map::evictRegion(size_t regionIndex)
+{
+    Region& region = regions[regionIndex];
+    std::unique_lock<std::mutex> plannerLock(fftwPlannerMutex);
+    for (auto& group : region.partitionGroups)
+    {
+        if (group.planModeToPressure) fftw_destroy_plan(group.planModeToPressure);
+        if (group.planForcingToModes) fftw_destroy_plan(group.planForcingToModes);
+    }
+    plannerLock.unlock();
+    // swap with empties so the memory actually goes away //
+    std::vector<PartitionGroup>().swap(region.partitionGroups);
+    std::vector<Partition>().swap(region.partitions);
+    std::vector<int>().swap(region.stateLookupTable);
+    std::vector<VoxelMeta>().swap(region.voxelMeta);
+    std::vector<int>().swap(region.ghostSources);
+    std::vector<DampedVoxel>().swap(region.dampedVoxels);
+    region.vaPartitions = sf::VertexArray();
+    region.vaInterfaces = sf::VertexArray();
+    region.texPressures = sf::Texture();
+    std::vector<sf::Uint8>().swap(region.pressurePixels);
+    region.pressureTexels = sf::IntRect();
+    region.pressureRevision = 0;
+    region.vaPressures = sf::VertexArray();
+    region.stateSize = 0;
+    region.numInterfaces = 0;
+    region.resident = false;
+    std::cout << "region " << regionIndex << " streamed out" << std::endl;
+}
+void Map::decomposeVoxelsIntoPartitions(Region& region)
+{
+    const unsigned regionRight = region.voxelX + region.voxelLengthX;
+    const unsigned regionTop = region.voxelY + region.voxelLengthY;
+    const size_t regionVoxelCount = size_t(voxelGridLengthZ)*region.voxelLengthY*region.voxelLengthX;
+    region.stateLookupTable.assign(regionVoxelCount, -1);
+    region.voxelMeta.assign(regionVoxelCount, VoxelMeta());
+    region.partitionGroups.clear();
+    auto localIndex = [&](unsigned vc, unsigned vr, unsigned vz)->size_t
+    {
+        return (size_t(vz)*region.voxelLengthY + vr - region.voxelY)*region.voxelLengthX + vc - region.voxelX;
+    };
+    // Partitions the region already has are kept as they are, and only the voxels
+    //  they leave uncovered get decomposed.  That way a changed tile only
+    //  re-decomposes the partitions it touched //
+    for (size_t p = 0; p < region.partitions.size(); p++)
+    {
+        const auto& partition = region.partitions[p];
+        for (unsigned vz = partition.voxelZ; vz < partition.voxelZ + partition.voxelLengthZ; vz++)
+        {
+            for (unsigned vr = partition.voxelY; vr < partition.voxelY + partition.voxelLengthY; vr++)
+            {
+                for (unsigned vc = partition.voxelX; vc < partition.voxelX + partition.voxelLengthX; vc++)
+                {
+                    region.voxelMeta[localIndex(vc, vr, vz)].partitionIndex = int(p);
+                }
+            }
+        }
+    }
+    auto isVoxelFree = [&](unsigned vc, unsigned vr, unsigned vz)->bool
+    {
+        // every non-zero tile is considered solid
+        //  as well as every previously decomposed voxel
+        return !(isVoxelSolid(vc, vr, vz) || region.voxelMeta[localIndex(vc, vr, vz)].partitionIndex >= 0);
+    };
+    // partitions never grow past the region's edges, so regions decompose independently //
+    auto checkNextPartitionRow = [&](unsigned partitionBottomRow, unsigned partitionLeftCol,
+        unsigned partitionFloor, unsigned currPartitionW, unsigned currPartitionH,
+        unsigned currPartitionD)->bool
+    {
+        if (partitionBottomRow + currPartitionH >= regionTop)
+        {
+            return false;
+        }
+        // we iterate along the -Y face of the partition
+        //      (because of the way the json map stores the map tiles)
+        //  and return true if all the voxels below are empty space
+        for (unsigned z = 0; z < currPartitionD; z++)
+        {
+            for (unsigned c = 0; c < currPartitionW; c++)
+            {
+                if (!isVoxelFree(partitionLeftCol + c, partitionBottomRow + currPartitionH, partitionFloor + z))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+    auto checkNextPartitionCol = [&](unsigned partitionBottomRow, unsigned partitionLeftCol,
+        unsigned partitionFloor, unsigned currPartitionW, unsigned currPartitionH,
+        unsigned currPartitionD)->bool
+    {
+        if (partitionLeftCol + currPartitionW >= regionRight)
+        {
+            return false;
+        }
+        // we iterate along the +X face of the partition
+        //  and return true if all the voxels beside it are empty space
+        for (unsigned z = 0; z < currPartitionD; z++)
+        {
+            for (unsigned r = 0; r < currPartitionH; r++)
+            {
+                if (!isVoxelFree(partitionLeftCol + currPartitionW, partitionBottomRow + r, partitionFloor + z))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+    auto checkNextPartitionLayer = [&](unsigned partitionBottomRow, unsigned partitionLeftCol,
+        unsigned partitionFloor, unsigned currPartitionW, unsigned currPartitionH,
+        unsigned currPartitionD)->bool
+    {
+        if (partitionFloor + currPartitionD >= voxelGridLengthZ)
+        {
+            return false;
+        }
+        // we iterate along the +Z face of the partition
+        //  and return true if all the voxels above are empty space
+        for (unsigned r = 0; r < currPartitionH; r++)
+        {
+            for (unsigned c = 0; c < currPartitionW; c++)
+            {
+                if (!isVoxelFree(partitionLeftCol + c, partitionBottomRow + r, partitionFloor + currPartitionD))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+    for (unsigned z = 0; z < voxelGridLengthZ; z++)
+    {
+        for (unsigned r = region.voxelY; r < regionTop; r++)
+        {
+            for (unsigned c = region.voxelX; c < regionRight; c++)
+            {
+                if (!isVoxelFree(c, r, z))
+                {
+                    continue;
+                }
+                unsigned partitionW = 1;
+                unsigned partitionH = 1;
+                unsigned partitionD = 1;
+                while (checkNextPartitionRow(r, c, z, partitionW, partitionH, partitionD))
+                {
+                    partitionH++;
+                }
+                while (checkNextPartitionCol(r, c, z, partitionW, partitionH, partitionD))
+                {
+                    partitionW++;
+                }
+                while (checkNextPartitionLayer(r, c, z, partitionW, partitionH, partitionD))
+                {
+                    partitionD++;
+                }
+                // we need to mark the voxels in this partition as decomposed
+                //  so they don't go into new partitions
+                for (unsigned vz = z; vz < z + partitionD; vz++)
+                {
+                    for (unsigned vr = r; vr < r + partitionH; vr++)
+                    {
+                        for (unsigned vc = c; vc < c + partitionW; vc++)
+                        {
+                            region.voxelMeta[localIndex(vc, vr, vz)].partitionIndex = int(region.partitions.size());
+                        }
+                    }
+                }
+                region.partitions.push_back({ r,c,z,partitionW,partitionH,partitionD });
+            }
+        }
+    }
+    // group partitions of identical dimensions, so each group can be
+    //  transformed by a single batched fftw plan //
+    std::map<std::tuple<unsigned, unsigned, unsigned>, size_t> groupIndexByDimensions;
+    const unsigned transformRank = options.volumetric ? 3 : 2;
+    for (size_t p = 0; p < region.partitions.size(); p++)
+    {
+        auto& partition = region.partitions[p];
+        const auto dimensions = std::make_tuple(
+            partition.voxelLengthX, partition.voxelLengthY, partition.voxelLengthZ);
+        auto it = groupIndexByDimensions.find(dimensions);
+        if (it == groupIndexByDimensions.end())
+        {
+            it = groupIndexByDimensions.insert({ dimensions, region.partitionGroups.size() }).first;
+            region.partitionGroups.push_back({ partition.voxelLengthX, partition.voxelLengthY,
+                partition.voxelLengthZ, transformRank, simDeltaTime });
+        }
+        partition.groupIndex = it->second;
+        region.partitionGroups[it->second].partitionIndices.push_back(p);
+    }
+    // lay every group out contiguously inside the region's state arrays.
+    //  Members are padded so each one starts with the same alignment
+    //  as the fftw_malloc'd array base, which fftw_execute_r2r requires //
+    static const size_t STATE_ALIGNMENT = 4;
+    region.stateSize = 0;
+    for (auto& group : region.partitionGroups)
+    {
+        const size_t gridSize = group.voxelLengthX*group.voxelLengthY*group.voxelLengthZ;
+        group.stateOffset = region.stateSize;
+        group.stateStride = (gridSize + STATE_ALIGNMENT - 1) / STATE_ALIGNMENT * STATE_ALIGNMENT;
+        for (size_t p = 0; p < group.partitionIndices.size(); p++)
+        {
+            auto& partition = region.partitions[group.partitionIndices[p]];
+            partition.stateOffset = group.stateOffset + p*group.stateStride;
+            for (size_t z = 0; z < partition.voxelLengthZ; z++)
+            {
+                for (size_t y = 0; y < partition.voxelLengthY; y++)
+                {
+                    for (size_t x = 0; x < partition.voxelLengthX; x++)
+                    {
+                        const size_t i = (z*partition.voxelLengthY + y)*partition.voxelLengthX + x;
+                        region.stateLookupTable[localIndex(unsigned(partition.voxelX + x),
+                            unsigned(partition.voxelY + y), unsigned(partition.voxelZ + z))] =
+                            int(partition.stateOffset + i);
+                    }
+                }
+            }
+        }
+        region.stateSize += group.partitionIndices.size()*group.stateStride;
+    }
+}
+void Map::buildPartitionVBO(Region& region)
+{
+    region.vaPartitions = sf::VertexArray(sf::PrimitiveType::Quads, 4 * 4 * region.partitions.size());
+    for (size_t p = 0; p < region.partitions.size(); p++)
+    {
+        static const sf::Color color(0, 255, 255, 64);
+        const float OUTLINE_SIZE = simVoxelSpacing*0.5f;
+        const auto& partition = region.partitions[p];
+        if (visibleVoxelZ < partition.voxelZ ||
+            visibleVoxelZ >= partition.voxelZ + partition.voxelLengthZ)
+        {
+            continue;
+        }
+        const float pLeft = float(partition.voxelX*simVoxelSpacing);
+        const float pRight = float((partition.voxelX + partition.voxelLengthX)*simVoxelSpacing);
+        const float pTop = float((partition.voxelY + partition.voxelLengthY)*simVoxelSpacing);
+        const float pBottom = float(partition.voxelY*simVoxelSpacing);
+        sf::VertexArray& va = region.vaPartitions;
+        // left side //
+        va[4 * 4 * p + 0].position = { pLeft, pBottom };
+        va[4 * 4 * p + 1].position = { pLeft + OUTLINE_SIZE, pBottom };
+        va[4 * 4 * p + 2].position = { pLeft + OUTLINE_SIZE, pTop };
+        va[4 * 4 * p + 3].position = { pLeft, pTop };
+        // right side //
+        va[4 * 4 * p + 4].position = { pRight - OUTLINE_SIZE, pBottom };
+        va[4 * 4 * p + 5].position = { pRight, pBottom };
+        va[4 * 4 * p + 6].position = { pRight, pTop };
+        va[4 * 4 * p + 7].position = { pRight - OUTLINE_SIZE, pTop };
+        // top side //
+        va[4 * 4 * p + 8].position = { pLeft + OUTLINE_SIZE, pTop - OUTLINE_SIZE };
+        va[4 * 4 * p + 9].position = { pRight - OUTLINE_SIZE, pTop - OUTLINE_SIZE };
+        va[4 * 4 * p + 10].position = { pRight - OUTLINE_SIZE, pTop };
+        va[4 * 4 * p + 11].position = { pLeft + OUTLINE_SIZE, pTop };
+        // bottom side //
+        va[4 * 4 * p + 12].position = { pLeft + OUTLINE_SIZE, pBottom };
+        va[4 * 4 * p + 13].position = { pRight - OUTLINE_SIZE, pBottom };
+        va[4 * 4 * p + 14].position = { pRight - OUTLINE_SIZE, pBottom + OUTLINE_SIZE };
+        va[4 * 4 * p + 15].position = { pLeft + OUTLINE_SIZE, pBottom + OUTLINE_SIZE };
+        for (size_t i = 0; i < 4 * 4; i++)
+        {
+            va[4 * 4 * p + i].color = color;
+        }
+    }
+}
+void Map::calculatePartitionInterfaces(Region& region)
+{
+    auto addPartitionInterfaceMeta = [&](const PartitionInterface& i)->void
+    {
+        for (unsigned z = i.voxelZ; z < i.voxelZ + i.voxelLengthZ; z++)
+        {
+            for (unsigned r = i.voxelY; r < i.voxelY + i.voxelLengthY; r++)
+            {
+                for (unsigned c = i.voxelX; c < i.voxelX + i.voxelLengthX; c++)
+                {
+                    const size_t local = (size_t(z)*region.voxelLengthY + r - region.voxelY)*
+                        region.voxelLengthX + c - region.voxelX;
+                    region.voxelMeta[local].interfacedDirectionFlags |= (1 << int(i.dir));
+                }
+            }
+        }
+    };
+    region.numInterfaces = 0;
+    for (auto& partition : region.partitions)
+    {
+        partition.interfaces.clear();
+    }
+    for (auto& meta : region.voxelMeta)
+    {
+        meta.interfacedDirectionFlags = 0;
+    }
+    // Partitions are boxes, so wherever two of them touch, the shared part
+    //  of their faces is a single rectangle: the overlap of the two boxes
+    //  on the other two axes.  That means we only need to find each pair of
+    //  neighbors once, by looking past every partition's positive faces //
+    struct AxisFace
+    {
+        PartitionInterface::Direction dir;
+        PartitionInterface::Direction opposingDir;
+    };
+    static const AxisFace AXIS_FACES[] = {
+        { PartitionInterface::Direction::X_POSITIVE, PartitionInterface::Direction::X_NEGATIVE },
+        { PartitionInterface::Direction::Y_POSITIVE, PartitionInterface::Direction::Y_NEGATIVE },
+        { PartitionInterface::Direction::Z_POSITIVE, PartitionInterface::Direction::Z_NEGATIVE }
+    };
+    const unsigned gridLengths[] = { voxelGridLengthX, voxelGridLengthY, voxelGridLengthZ };
+    const unsigned regionMin[] = { region.voxelX, region.voxelY, 0 };
+    const unsigned regionMax[] = {
+        region.voxelX + region.voxelLengthX, region.voxelY + region.voxelLengthY, voxelGridLengthZ };
+    // The neighboring region may not be decomposed, so faces on the region's
+    //  edge get an interface for every run of open voxels across from them instead.
+    //  Every open voxel ends up in some partition, so this is the same set of voxels //
+    auto addRegionEdgeInterfaces = [&](size_t p, unsigned axis, bool positiveFace)->void
+    {
+        auto& partition = region.partitions[p];
+        const unsigned partitionMin[] = { partition.voxelX, partition.voxelY, partition.voxelZ };
+        const unsigned partitionLength[] = {
+            partition.voxelLengthX, partition.voxelLengthY, partition.voxelLengthZ };
+        const unsigned faceLayer = positiveFace ?
+            partitionMin[axis] + partitionLength[axis] - 1 : partitionMin[axis];
+        const unsigned acrossLayer = positiveFace ? faceLayer + 1 : faceLayer - 1;
+        // runs go along the face's longer side, so flat maps get one interface per run //
+        unsigned runAxis = (axis + 1) % 3;
+        unsigned stepAxis = (axis + 2) % 3;
+        if (partitionLength[stepAxis] > partitionLength[runAxis])
+        {
+            std::swap(runAxis, stepAxis);
+        }
+        const unsigned runEnd = partitionMin[runAxis] + partitionLength[runAxis];
+        for (unsigned s = partitionMin[stepAxis]; s < partitionMin[stepAxis] + partitionLength[stepAxis]; s++)
+        {
+            unsigned runLength = 0;
+            for (unsigned t = partitionMin[runAxis]; t <= runEnd; t++)
+            {
+                if (t < runEnd)
+                {
+                    unsigned acrossVoxel[3];
+                    acrossVoxel[axis] = acrossLayer;
+                    acrossVoxel[runAxis] = t;
+                    acrossVoxel[stepAxis] = s;
+                    if (!isVoxelSolid(acrossVoxel[0], acrossVoxel[1], acrossVoxel[2]))
+                    {
+                        runLength++;
+                        continue;
+                    }
+                }
+                if (runLength == 0)
+                {
+                    continue;
+                }
+                unsigned interfaceMin[3];
+                unsigned interfaceLength[3];
+                interfaceMin[axis] = faceLayer;
+                interfaceLength[axis] = 1;
+                interfaceMin[runAxis] = t - runLength;
+                interfaceLength[runAxis] = runLength;
+                interfaceMin[stepAxis] = s;
+                interfaceLength[stepAxis] = 1;
+                const PartitionInterface iFace = {
+                    positiveFace ? AXIS_FACES[axis].dir : AXIS_FACES[axis].opposingDir,
+                    interfaceMin[0], interfaceMin[1], interfaceMin[2],
+                    interfaceLength[0], interfaceLength[1], interfaceLength[2],
+                    0, 0 };
+                partition.interfaces.push_back(iFace);
+                addPartitionInterfaceMeta(iFace);
+                region.numInterfaces++;
+                runLength = 0;
+            }
+        }
+    };
+    for (size_t p = 0; p < region.partitions.size(); p++)
+    {
+        const unsigned partitionMin[] = {
+            region.partitions[p].voxelX, region.partitions[p].voxelY, region.partitions[p].voxelZ };
+        const unsigned partitionLength[] = {
+            region.partitions[p].voxelLengthX, region.partitions[p].voxelLengthY,
+            region.partitions[p].voxelLengthZ };
+        for (unsigned axis = 0; axis < 3; axis++)
+        {
+            if (partitionMin[axis] > 0 && partitionMin[axis] == regionMin[axis])
+            {
+                addRegionEdgeInterfaces(p, axis, false);
+            }
+            const unsigned neighborLayer = partitionMin[axis] + partitionLength[axis];
+            if (neighborLayer >= gridLengths[axis])
+            {
+                continue;
+            }
+            if (neighborLayer >= regionMax[axis])
+            {
+                addRegionEdgeInterfaces(p, axis, true);
+                continue;
+            }
+            // collect every partition on the other side of this face, in the order we meet them //
+            const unsigned axisU = (axis + 1) % 3;
+            const unsigned axisV = (axis + 2) % 3;
+            std::vector<int> neighborPartitionIndices;
+            for (unsigned u = partitionMin[axisU]; u < partitionMin[axisU] + partitionLength[axisU]; u++)
+            {
+                for (unsigned v = partitionMin[axisV]; v < partitionMin[axisV] + partitionLength[axisV]; v++)
+                {
+                    unsigned neighborVoxel[3];
+                    neighborVoxel[axis] = neighborLayer;
+                    neighborVoxel[axisU] = u;
+                    neighborVoxel[axisV] = v;
+                    const size_t neighborLocal = (size_t(neighborVoxel[2])*region.voxelLengthY +
+                        neighborVoxel[1] - region.voxelY)*region.voxelLengthX + neighborVoxel[0] - region.voxelX;
+                    const int neighborPartitionIndex = region.voxelMeta[neighborLocal].partitionIndex;
+                    if (neighborPartitionIndex >= 0 &&
+                        std::find(neighborPartitionIndices.begin(), neighborPartitionIndices.end(),
+                            neighborPartitionIndex) == neighborPartitionIndices.end())
+                    {
+                        neighborPartitionIndices.push_back(neighborPartitionIndex);
+                    }
+                }
+            }
+            for (const int neighborPartitionIndex : neighborPartitionIndices)
+            {
+                auto& neighbor = region.partitions[neighborPartitionIndex];
+                const unsigned neighborMin[] = { neighbor.voxelX, neighbor.voxelY, neighbor.voxelZ };
+                const unsigned neighborLength[] = {
+                    neighbor.voxelLengthX, neighbor.voxelLengthY, neighbor.voxelLengthZ };
+                unsigned interfaceMin[3];
+                unsigned interfaceLength[3];
+                interfaceMin[axis] = neighborLayer - 1;
+                interfaceLength[axis] = 1;
+                for (const unsigned otherAxis : { axisU, axisV })
+                {
+                    interfaceMin[otherAxis] = std::max(partitionMin[otherAxis], neighborMin[otherAxis]);
+                    interfaceLength[otherAxis] = std::min(
+                        partitionMin[otherAxis] + partitionLength[otherAxis],
+                        neighborMin[otherAxis] + neighborLength[otherAxis]) - interfaceMin[otherAxis];
+                }
+                PartitionInterface iFace = { AXIS_FACES[axis].dir,
+                    interfaceMin[0], interfaceMin[1], interfaceMin[2],
+                    interfaceLength[0], interfaceLength[1], interfaceLength[2],
+                    0, 0 };
+                region.partitions[p].interfaces.push_back(iFace);
+                addPartitionInterfaceMeta(iFace);
+                // Add the corresponding interface for the the adjacent partition,
+                //  which sits one voxel further along the axis //
+                iFace.dir = AXIS_FACES[axis].opposingDir;
+                iFace.voxelX += axis == 0 ? 1 : 0;
+                iFace.voxelY += axis == 1 ? 1 : 0;
+                iFace.voxelZ += axis == 2 ? 1 : 0;
+                neighbor.interfaces.push_back(iFace);
+                addPartitionInterfaceMeta(iFace);
+                region.numInterfaces += 2;
+            }
+        }
+    }
+}
+void Map::buildGhostStrips(Region& region)
+{
+    const size_t regionIndex = regionIndexOf(region.voxelX, region.voxelY);
+    region.ghostSources.clear();
+    for (auto& partition : region.partitions)
+    {
+        for (auto& iFace : partition.interfaces)
+        {
+            const sf::Vector3i& iFaceDirection = DIRECTION_VECS[size_t(iFace.dir)];
+            iFace.acrossRegionIndex =
+                regionIndexOf(iFace.voxelX + iFaceDirection.x, iFace.voxelY + iFaceDirection.y);
+            iFace.ghostOffset = region.ghostSources.size();
+            // same voxel order the forcing pass walks the interface in //
+            for (unsigned z = iFace.voxelZ; z < iFace.voxelZ + iFace.voxelLengthZ; z++)
+            {
+                for (unsigned x = iFace.voxelX; x < iFace.voxelX + iFace.voxelLengthX; x++)
+                {
+                    for (unsigned y = iFace.voxelY; y < iFace.voxelY + iFace.voxelLengthY; y++)
+                    {
+                        for (unsigned d = 1; d <= HALO_DEPTH; d++)
+                        {
+                            const sf::Vector3i ghost_i = sf::Vector3i(int(x), int(y), int(z)) + iFaceDirection*int(d);
+                            if (ghost_i.x < 0 || ghost_i.x >= int(voxelGridLengthX) ||
+                                ghost_i.y < 0 || ghost_i.y >= int(voxelGridLengthY) ||
+                                ghost_i.z < 0 || ghost_i.z >= int(voxelGridLengthZ))
+                            {
+                                region.ghostSources.push_back(GHOST_SOURCE_ABSENT);
+                            }
+                            else if (regionIndexOf(unsigned(ghost_i.x), unsigned(ghost_i.y)) != regionIndex)
+                            {
+                                region.ghostSources.push_back(GHOST_SOURCE_ACROSS_REGION);
+                            }
+                            else
+                            {
+                                // solid voxels are already -1 == GHOST_SOURCE_ABSENT in here //
+                                region.ghostSources.push_back(region.stateLookupTable[
+                                    (size_t(ghost_i.z)*region.voxelLengthY + ghost_i.y - region.voxelY)*
+                                    region.voxelLengthX + ghost_i.x - region.voxelX]);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+void Map::buildDampedVoxels(Region& region)
+{
+    region.dampedVoxels.clear();
+    // An explicit step of the damping term can't take out more than the
+    //  pressure's whole change, or it overshoots & rings //
+    const double MAX_DAMPING = 1.0 / simDeltaTime;
+    for (unsigned z = 0; z < voxelGridLengthZ; z++)
+    {
+        for (unsigned y = region.voxelY; y < region.voxelY + region.voxelLengthY; y++)
+        {
+            for (unsigned x = region.voxelX; x < region.voxelX + region.voxelLengthX; x++)
+            {
+                const int stateIndex = region.stateLookupTable[
+                    (size_t(z)*region.voxelLengthY + y - region.voxelY)*region.voxelLengthX + x - region.voxelX];
+                if (stateIndex < 0)
+                {
+                    continue;
+                }
+                // lossy materials leave "transmission" of the amplitude after 1 meter of travel //
+                double damping = 0;
+                const Material& material = materials[voxelMaterial(x, y, z)];
+                if (material.transmission < 1)
+                {
+                    damping = -2 * SOUND_SPEED_METERS_PER_SECOND*log(material.transmission);
+                }
+                // A wall's absorption comes out of the open voxel lining it, which the
+                //  reflection passes through twice, leaving sqrt(1 - absorption) of the amplitude //
+                const sf::Vector3i voxel{ int(x), int(y), int(z) };
+                for (const auto& direction : DIRECTION_VECS)
+                {
+                    const sf::Vector3i neighbor = voxel + direction;
+                    if (neighbor.x < 0 || neighbor.x >= int(voxelGridLengthX) ||
+                        neighbor.y < 0 || neighbor.y >= int(voxelGridLengthY) ||
+                        neighbor.z < 0 || neighbor.z >= int(voxelGridLengthZ))
+                    {
+                        continue;
+                    }
+                    const Material& wall = materials[voxelMaterial(
+                        unsigned(neighbor.x), unsigned(neighbor.y), unsigned(neighbor.z))];
+                    if (wall.isSolid() && wall.absorption > 0)
+                    {
+                        damping = std::max(damping, wall.absorption < 1 ?
+                            -SOUND_SPEED_METERS_PER_SECOND*log(1.0 - wall.absorption) / (2 * simVoxelSpacing) :
+                            MAX_DAMPING);
+                    }
+                }
+                if (damping > 0)
+                {
+                    // the forcing term is damping * dp/dt, and dp is what the pass multiplies by //
+                    region.dampedVoxels.push_back(DampedVoxel(size_t(stateIndex),
+                        std::min(damping, MAX_DAMPING) / simDeltaTime));
+                }
+            }
+        }
+    }
+    // groups are laid out contiguously, so sorting leaves each one's damped voxels side by side //
+    std::sort(region.dampedVoxels.begin(), region.dampedVoxels.end(),
+        [](const DampedVoxel& a, const DampedVoxel& b) { return a.stateIndex < b.stateIndex; });
+    auto stateIndexBelow = [](const DampedVoxel& dampedVoxel, size_t stateIndex)
+    {
+        return dampedVoxel.stateIndex < stateIndex;
+    };
+    for (auto& group : region.partitionGroups)
+    {
+        const size_t groupEnd = group.stateOffset + group.partitionIndices.size()*group.stateStride;
+        group.dampedBegin = size_t(std::lower_bound(region.dampedVoxels.begin(), region.dampedVoxels.end(),
+            group.stateOffset, stateIndexBelow) - region.dampedVoxels.begin());
+        group.dampedEnd = size_t(std::lower_bound(region.dampedVoxels.begin(), region.dampedVoxels.end(),
+            groupEnd, stateIndexBelow) - region.dampedVoxels.begin());
+    }
+}
+void Map::buildStencilReads(Region& region)
+{
+    const size_t regionIndex = regionIndexOf(region.voxelX, region.voxelY);
+    const size_t groupCount = region.partitionGroups.size();
+    const int stencilReach = int(options.stencilOrder / 2);
+    // [group][other group] whether the first one's stencils read the second one's pressures //
+    std::vector<bool> groupReads(groupCount*groupCount, false);
+    // [partition][axis][position] whether the plane across the axis has pressures which get read //
+    std::vector<std::vector<bool>> planesRead(region.partitions.size() * 3);
+    for (size_t p = 0; p < region.partitions.size(); p++)
+    {
+        const Partition& partition = region.partitions[p];
+        planesRead[p * 3 + 0].assign(partition.voxelLengthX, false);
+        planesRead[p * 3 + 1].assign(partition.voxelLengthY, false);
+        planesRead[p * 3 + 2].assign(partition.voxelLengthZ, false);
+    }
+    for (auto& group : region.partitionGroups)
+    {
+        group.dependentGroups.clear();
+        group.dependencyCount = 0;
+        group.acrossRegions.clear();
+    }
+    for (const auto& partition : region.partitions)
+    {
+        PartitionGroup& group = region.partitionGroups[partition.groupIndex];
+        for (const auto& iFace : partition.interfaces)
+        {
+            const sf::Vector3i& iFaceDirection = DIRECTION_VECS[size_t(iFace.dir)];
+            const unsigned axis = iFaceDirection.x != 0 ? 0 : iFaceDirection.y != 0 ? 1 : 2;
+            for (unsigned z = iFace.voxelZ; z < iFace.voxelZ + iFace.voxelLengthZ; z++)
+            {
+                for (unsigned x = iFace.voxelX; x < iFace.voxelX + iFace.voxelLengthX; x++)
+                {
+                    for (unsigned y = iFace.voxelY; y < iFace.voxelY + iFace.voxelLengthY; y++)
+                    {
+                        // the ghost strip across the face, and the near half of the stencil,
+                        //  which leaves the partition when it's too thin to hold it //
+                        for (int d = 1 - int(HALO_DEPTH); d <= int(HALO_DEPTH); d++)
+                        {
+                            const sf::Vector3i stencil_i = sf::Vector3i(int(x), int(y), int(z)) + iFaceDirection*d;
+                            if (stencil_i.x < 0 || stencil_i.x >= int(voxelGridLengthX) ||
+                                stencil_i.y < 0 || stencil_i.y >= int(voxelGridLengthY) ||
+                                stencil_i.z < 0 || stencil_i.z >= int(voxelGridLengthZ))
+                            {
+                                continue;
+                            }
+                            const size_t stencilRegionIndex =
+                                regionIndexOf(unsigned(stencil_i.x), unsigned(stencil_i.y));
+                            if (stencilRegionIndex != regionIndex)
+                            {
+                                group.acrossRegions.push_back(stencilRegionIndex);
+                                continue;
+                            }
+                            const size_t local = (size_t(stencil_i.z)*region.voxelLengthY +
+                                stencil_i.y - region.voxelY)*region.voxelLengthX + stencil_i.x - region.voxelX;
+                            const int p = region.voxelMeta[local].partitionIndex;
+                            if (p < 0)
+                            {
+                                continue;
+                            }
+                            const Partition& stencilPartition = region.partitions[p];
+                            groupReads[partition.groupIndex*groupCount + stencilPartition.groupIndex] = true;
+                            if (d > -stencilReach && d <= stencilReach)
+                            {
+                                const int corner[] = { int(stencilPartition.voxelX),
+                                    int(stencilPartition.voxelY), int(stencilPartition.voxelZ) };
+                                const int position[] = { stencil_i.x, stencil_i.y, stencil_i.z };
+                                planesRead[size_t(p) * 3 + axis][position[axis] - corner[axis]] = true;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        std::sort(group.acrossRegions.begin(), group.acrossRegions.end());
+        group.acrossRegions.erase(std::unique(group.acrossRegions.begin(), group.acrossRegions.end()),
+            group.acrossRegions.end());
+    }
+    for (size_t g = 0; g < groupCount; g++)
+    {
+        for (size_t read = 0; read < groupCount; read++)
+        {
+            if (read != g && groupReads[g*groupCount + read])
+            {
+                region.partitionGroups[g].dependencyCount++;
+                region.partitionGroups[read].dependentGroups.push_back(g);
+            }
+        }
+    }
+    // Damped voxels not on a plane already get the one across the axis they're closest to
+    //  an edge along, since the walls lining them are outside the partition //
+    for (const auto& group : region.partitionGroups)
+    {
+        const unsigned lengths[] = { group.voxelLengthX, group.voxelLengthY, group.voxelLengthZ };
+        for (size_t d = group.dampedBegin; d < group.dampedEnd; d++)
+        {
+            const size_t offset = region.dampedVoxels[d].stateIndex - group.stateOffset;
+            const size_t p = group.partitionIndices[offset / group.stateStride];
+            const size_t i = offset % group.stateStride;
+            const unsigned position[] = { unsigned(i % lengths[0]), unsigned(i / lengths[0] % lengths[1]),
+                unsigned(i / (size_t(lengths[0])*lengths[1])) };
+            unsigned nearestAxis = 0;
+            unsigned nearestDistance = std::numeric_limits<unsigned>::max();
+            bool onPlane = false;
+            for (unsigned axis = 0; axis < 3; axis++)
+            {
+                onPlane = onPlane || planesRead[p * 3 + axis][position[axis]];
+                const unsigned distance = std::min(position[axis], lengths[axis] - 1 - position[axis]);
+                if (lengths[axis] > 1 && distance < nearestDistance)
+                {
+                    nearestAxis = axis;
+                    nearestDistance = distance;
+                }
+            }
+            if (!onPlane)
+            {
+                planesRead[p * 3 + nearestAxis][position[nearestAxis]] = true;
+            }
+        }
+    }
+    for (size_t p = 0; p < region.partitions.size(); p++)
+    {
+        for (unsigned axis = 0; axis < 3; axis++)
+        {
+            std::vector<unsigned>& planes = region.partitions[p].pressurePlanes[axis];
+            planes.clear();
+            for (unsigned position = 0; position < planesRead[p * 3 + axis].size(); position++)
+            {
+                if (planesRead[p * 3 + axis][position])
+                {
+                    planes.push_back(position);
+                }
+            }
+        }
+    }
+    // Each plane costs about a pass over its partition's modes, against fftw's 2.5*log2 flops
+    //  per voxel (half as many multiply-adds), so pruning pays off for big partitions
+    //  with few interfaces & little damping //
+    for (auto& group : region.partitionGroups)
+    {
+        const double gridSize = double(group.voxelLengthX)*group.voxelLengthY*group.voxelLengthZ;
+        const bool useSmallDct = group.transformRank == 2 &&
+            SmallDct::supports(group.voxelLengthX, group.voxelLengthY);
+        const double fullCost = group.partitionIndices.size()*gridSize*(useSmallDct ?
+            group.voxelLengthX + group.voxelLengthY : 1.25*log2(std::max(gridSize, 2.0)));
+        double prunedCost = 0;
+        for (const size_t p : group.partitionIndices)
+        {
+            for (unsigned axis = 0; axis < 3; axis++)
+            {
+                prunedCost += double(region.partitions[p].pressurePlanes[axis].size())*
+                    group.prunedIdct.planeCost(axis);
+            }
+        }
+        group.prunePressures = prunedCost < fullCost / 2;
+        if (group.prunePressures)
+        {
+            group.prunedIdct.prepare();
+        }
+    }
+}
+void Map::buildInterfaceVBO(Region& region)
+{
+    region.vaInterfaces = sf::VertexArray(sf::PrimitiveType::Quads, 4 * region.numInterfaces);
+    unsigned currInterface = 0;
+    for (const auto& partition : region.partitions)
+    {
+        for (const auto& interface : partition.interfaces)
+        {
+            if (visibleVoxelZ < interface.voxelZ ||
+                visibleVoxelZ >= interface.voxelZ + interface.voxelLengthZ)
+            {
+                currInterface++;
+                continue;
+            }
+            static const sf::Color color(255, 128, 0, 64);
+            const float iLeft = float(interface.voxelX*simVoxelSpacing);
+            const float iRight = float((interface.voxelX + interface.voxelLengthX)*simVoxelSpacing);
+            const float iTop = float((interface.voxelY + interface.voxelLengthY)*simVoxelSpacing);
+            const float iBottom = float(interface.voxelY*simVoxelSpacing);
+            region.vaInterfaces[4 * currInterface + 0].position = { iLeft, iBottom };
+            region.vaInterfaces[4 * currInterface + 1].position = { iRight, iBottom };
+            region.vaInterfaces[4 * currInterface + 2].position = { iRight, iTop };
+            region.vaInterfaces[4 * currInterface + 3].position = { iLeft, iTop };
+            for (unsigned i = 0; i < 4; i++)
+            {
+                region.vaInterfaces[4 * currInterface + i].color = color;
+            }
+            currInterface++;
+        }
+    }
+}
+void Map::planPartitionTransforms(Region& region)
+{
+    std::lock_guard<std::mutex> plannerLock(fftwPlannerMutex);
+    // the plans only need arrays with the same alignment every scenario's will have //
+    RegionState planningState(region.stateSize);
+    static const fftw_r2r_kind KINDS_MODE_TO_PRESSURE[] = { FFTW_REDFT01, FFTW_REDFT01, FFTW_REDFT01 };
+    static const fftw_r2r_kind KINDS_FORCING_TO_MODES[] = { FFTW_REDFT10, FFTW_REDFT10, FFTW_REDFT10 };
+    for (auto& group : region.partitionGroups)
+    {
+        if (group.transformRank == 2 &&
+            SmallDct::supports(group.voxelLengthX, group.voxelLengthY))
+        {
+            group.useSmallDct = true;
+            continue;
+        }
+        // groups which survived a re-decomposition unchanged keep their plans //
+        if (group.planModeToPressure)
+        {
+            continue;
+        }
+        // fftw wants the slowest varying dimension first //
+        const int dimensions3d[] = {
+            int(group.voxelLengthZ), int(group.voxelLengthY), int(group.voxelLengthX) };
+        const int* dimensions = dimensions3d + (3 - group.transformRank);
+        const int groupCount = int(group.partitionIndices.size());
+        const int stride = int(group.stateStride);
+        double* modes = planningState.voxelModes + group.stateOffset;
+        double* forcingTerms = planningState.voxelForcingTerms + group.stateOffset;
+        double* pressures = planningState.voxelPressures + group.stateOffset;
+        group.planModeToPressure = fftw_plan_many_r2r(group.transformRank, dimensions, groupCount,
+            modes, nullptr, 1, stride,
+            pressures, nullptr, 1, stride,
+            KINDS_MODE_TO_PRESSURE, FFTW_ESTIMATE);
+        group.planForcingToModes = fftw_plan_many_r2r(group.transformRank, dimensions, groupCount,
+            forcingTerms, nullptr, 1, stride,
+            forcingTerms, nullptr, 1, stride,
+            KINDS_FORCING_TO_MODES, FFTW_ESTIMATE);
+    }
+}
+void Map::redecomposeRegion(size_t regionIndex, const unsigned boxMin[3], const unsigned boxMax[3],
+    const std::vector<Scenario*>& scenarios)
+{
+    Region& region = regions[regionIndex];
+    // the old layout, which the scenarios' state gets projected from //
+    const std::vector<Partition> oldPartitions = region.partitions;
+    std::vector<PartitionGroup> oldGroups;
+    oldGroups.swap(region.partitionGroups);
+    const std::vector<int> oldStateLookupTable = region.stateLookupTable;
+    const size_t oldStateSize = region.stateSize;
+    // partitions clear of the box are kept in the same order, ahead of the new ones //
+    std::vector<size_t> keptPartitionIndices;
+    std::vector<bool> oldGroupsReplaced(oldGroups.size(), false);
+    region.partitions.clear();
+    for (size_t p = 0; p < oldPartitions.size(); p++)
+    {
+        const Partition& partition = oldPartitions[p];
+        const unsigned partitionMin[] = { partition.voxelX, partition.voxelY, partition.voxelZ };
+        const unsigned partitionLength[] = {
+            partition.voxelLengthX, partition.voxelLengthY, partition.voxelLengthZ };
+        bool touchesBox = true;
+        for (unsigned axis = 0; axis < 3; axis++)
+        {
+            touchesBox = touchesBox && partitionMin[axis] < boxMax[axis] &&
+                boxMin[axis] < partitionMin[axis] + partitionLength[axis];
+        }
+        if (touchesBox)
+        {
+            oldGroupsReplaced[partition.groupIndex] = true;
+            continue;
+        }
+        keptPartitionIndices.push_back(p);
+        region.partitions.push_back(partition);
+    }
+    const size_t keptCount = region.partitions.size();
+    decomposeVoxelsIntoPartitions(region);
+    // groups with the same shape & member count as before can run the same plans //
+    std::vector<bool> oldPlansReused(oldGroups.size(), false);
+    for (auto& group : region.partitionGroups)
+    {
+        for (size_t g = 0; g < oldGroups.size(); g++)
+        {
+            const PartitionGroup& oldGroup = oldGroups[g];
+            if (!oldPlansReused[g] && oldGroup.planModeToPressure &&
+                oldGroup.voxelLengthX == group.voxelLengthX && oldGroup.voxelLengthY == group.voxelLengthY &&
+                oldGroup.voxelLengthZ == group.voxelLengthZ &&
+                oldGroup.partitionIndices.size() == group.partitionIndices.size())
+            {
+                group.planModeToPressure = oldGroup.planModeToPressure;
+                group.planForcingToModes = oldGroup.planForcingToModes;
+                oldPlansReused[g] = true;
+                break;
+            }
+        }
+    }
+    buildPartitionVBO(region);
+    calculatePartitionInterfaces(region);
+    buildGhostStrips(region);
+    buildDampedVoxels(region);
+    buildStencilReads(region);
+    buildInterfaceVBO(region);
+    planPartitionTransforms(region);
+    region.pressureRevision = 0;
+    // region-local voxel index of every old state index //
+    const size_t regionVoxelCount = oldStateLookupTable.size();
+    std::vector<size_t> oldStateVoxels(oldStateSize, regionVoxelCount);
+    for (size_t v = 0; v < regionVoxelCount; v++)
+    {
+        if (oldStateLookupTable[v] >= 0)
+        {
+            oldStateVoxels[size_t(oldStateLookupTable[v])] = v;
+        }
+    }
+    for (Scenario* s : scenarios)
+    {
+        // sources & probes follow their voxel into its new partition, and walled in sources go quiet //
+        auto moveStateIndex = [&](StateIndex& stateIndex)->bool
+        {
+            if (stateIndex.region != regionIndex)
+            {
+                return true;
+            }
+            const int newIndex = region.stateLookupTable[oldStateVoxels[stateIndex.local]];
+            if (newIndex < 0)
+            {
+                return false;
+            }
+            stateIndex.local = size_t(newIndex);
+            return true;
+        };
+        s->pointSources.erase(std::remove_if(s->pointSources.begin(), s->pointSources.end(),
+            [&](PointSource& ps)->bool { return !moveStateIndex(ps.stateIndex); }), s->pointSources.end());
+        for (auto& probe : s->probes)
+        {
+            const bool moved = moveStateIndex(probe.stateIndex);
+            assert(moved);
+        }
+        RegionState& regionState = s->regions[regionIndex];
+        if (!regionState.isActive())
+        {
+            continue;
+        }
+        if (region.stateSize == 0)
+        {
+            // walled up completely, so there's nothing left to simulate //
+            regionState = RegionState();
+            region.scenarioCount--;
+            continue;
+        }
+        // The replaced partitions' pressures in voxel space: the current ones are already
+        //  there, last step's & the modal forcing the next step applies are transformed back //
+        RegionState replaced(oldStateSize);
+        for (size_t g = 0; g < oldGroups.size(); g++)
+        {
+            const PartitionGroup& group = oldGroups[g];
+            if (!oldGroupsReplaced[g] || regionState.restingGroups[g])
+            {
+                continue;
+            }
+            const size_t groupSize = group.partitionIndices.size()*group.stateStride;
+            std::copy(regionState.voxelModesPrevious + group.stateOffset,
+                regionState.voxelModesPrevious + group.stateOffset + groupSize,
+                replaced.voxelModes + group.stateOffset);
+            executeGroupTransform(group, group.planModeToPressure, FFTW_REDFT01,
+                replaced.voxelModes + group.stateOffset, replaced.voxelPressures + group.stateOffset);
+            std::copy(regionState.voxelForcingTerms + group.stateOffset,
+                regionState.voxelForcingTerms + group.stateOffset + groupSize,
+                replaced.voxelModes + group.stateOffset);
+            executeGroupTransform(group, group.planModeToPressure, FFTW_REDFT01,
+                replaced.voxelModes + group.stateOffset, replaced.voxelForcingTerms + group.stateOffset);
+            for (size_t i = group.stateOffset; i < group.stateOffset + groupSize; i++)
+            {
+                replaced.voxelPressures[i] /= group.normalization;
+                replaced.voxelForcingTerms[i] /= group.normalization;
+            }
+        }
+        RegionState next(region.stateSize, region.ghostSources.size(),
+            region.dampedVoxels.size(), region.partitionGroups.size());
+        // kept partitions have the same shape, so their modes carry straight over //
+        for (size_t p = 0; p < keptCount; p++)
+        {
+            const size_t from = oldPartitions[keptPartitionIndices[p]].stateOffset;
+            const size_t to = region.partitions[p].stateOffset;
+            const size_t gridSize = region.partitions[p].voxelLengthX*region.partitions[p].voxelLengthY*
+                region.partitions[p].voxelLengthZ;
+            std::copy(regionState.voxelModes + from, regionState.voxelModes + from + gridSize, next.voxelModes + to);
+            std::copy(regionState.voxelModesPrevious + from, regionState.voxelModesPrevious + from + gridSize,
+                next.voxelModesPrevious + to);
+            std::copy(regionState.voxelForcingTerms + from, regionState.voxelForcingTerms + from + gridSize,
+                next.voxelForcingTerms + to);
+            std::copy(regionState.voxelPressures + from, regionState.voxelPressures + from + gridSize,
+                next.voxelPressures + to);
+        }
+        // New partitions gather their voxels' pressures, which start from rest where they
+        //  were solid, then project them onto their own modes.  The forcing was worked out
+        //  against the old interfaces, but it's only applied for the one step //
+        RegionState projected(region.stateSize);
+        std::vector<bool> groupsProjected(region.partitionGroups.size(), false);
+        for (size_t p = keptCount; p < region.partitions.size(); p++)
+        {
+            const Partition& partition = region.partitions[p];
+            groupsProjected[partition.groupIndex] = true;
+            for (unsigned z = 0; z < partition.voxelLengthZ; z++)
+            {
+                for (unsigned y = 0; y < partition.voxelLengthY; y++)
+                {
+                    for (unsigned x = 0; x < partition.voxelLengthX; x++)
+                    {
+                        const size_t local = (size_t(partition.voxelZ + z)*region.voxelLengthY +
+                            partition.voxelY + y - region.voxelY)*region.voxelLengthX +
+                            partition.voxelX + x - region.voxelX;
+                        const int oldIndex = oldStateLookupTable[local];
+                        if (oldIndex < 0)
+                        {
+                            continue;
+                        }
+                        const size_t i = partition.stateOffset +
+                            (size_t(z)*partition.voxelLengthY + y)*partition.voxelLengthX + x;
+                        next.voxelPressures[i] = regionState.voxelPressures[oldIndex];
+                        projected.voxelModes[i] = regionState.voxelPressures[oldIndex];
+                        projected.voxelModesPrevious[i] = replaced.voxelPressures[oldIndex];
+                        projected.voxelForcingTerms[i] = replaced.voxelForcingTerms[oldIndex];
+                    }
+                }
+            }
+        }
+        for (size_t g = 0; g < region.partitionGroups.size(); g++)
+        {
+            const PartitionGroup& group = region.partitionGroups[g];
+            if (!groupsProjected[g])
+            {
+                continue;
+            }
+            const size_t groupSize = group.partitionIndices.size()*group.stateStride;
+            for (double* values : { projected.voxelModes, projected.voxelModesPrevious, projected.voxelForcingTerms })
+            {
+                executeGroupTransform(group, group.planForcingToModes, FFTW_REDFT10,
+                    values + group.stateOffset, values + group.stateOffset);
+                for (size_t i = group.stateOffset; i < group.stateOffset + groupSize; i++)
+                {
+                    values[i] /= group.normalization;
+                }
+            }
+            const size_t gridSize = group.voxelLengthX*group.voxelLengthY*group.voxelLengthZ;
+            for (const size_t p : group.partitionIndices)
+            {
+                if (p < keptCount)
+                {
+                    continue;
+                }
+                const size_t offset = region.partitions[p].stateOffset;
+                std::copy(projected.voxelModes + offset, projected.voxelModes + offset + gridSize,
+                    next.voxelModes + offset);
+                std::copy(projected.voxelModesPrevious + offset, projected.voxelModesPrevious + offset + gridSize,
+                    next.voxelModesPrevious + offset);
+                std::copy(projected.voxelForcingTerms + offset, projected.voxelForcingTerms + offset + gridSize,
+                    next.voxelForcingTerms + offset);
+            }
+        }
+        for (size_t g = 0; g < region.partitionGroups.size(); g++)
+        {
+            const PartitionGroup& group = region.partitionGroups[g];
+            const size_t groupEnd = group.stateOffset + group.partitionIndices.size()*group.stateStride;
+            auto isZero = [](double value) { return value == 0; };
+            next.restingGroups[g] =
+                std::all_of(next.voxelModes + group.stateOffset, next.voxelModes + groupEnd, isZero) &&
+                std::all_of(next.voxelModesPrevious + group.stateOffset, next.voxelModesPrevious + groupEnd, isZero) &&
+                std::all_of(next.voxelForcingTerms + group.stateOffset, next.voxelForcingTerms + groupEnd, isZero);
+        }
+        // the damping pass keeps last step's pressure, which is the one the modes give now //
+        for (size_t d = 0; d < region.dampedVoxels.size(); d++)
+        {
+            next.dampedPressuresPrevious[d] = next.voxelPressures[region.dampedVoxels[d].stateIndex];
+        }
+        next.knockPressure = regionState.knockPressure;
+        next.quietChecks = regionState.quietChecks;
+        next.remoteActive = regionState.remoteActive;
+        regionState = std::move(next);
+    }
+    std::unique_lock<std::mutex> plannerLock(fftwPlannerMutex);
+    for (size_t g = 0; g < oldGroups.size(); g++)
+    {
+        if (oldPlansReused[g])
+        {
+            continue;
+        }
+        if (oldGroups[g].planModeToPressure) fftw_destroy_plan(oldGroups[g].planModeToPressure);
+        if (oldGroups[g].planForcingToModes) fftw_destroy_plan(oldGroups[g].planForcingToModes);
+    }
+    plannerLock.unlock();
+    std::cout << "region " << regionIndex << " re-decomposed: keptPartitions=" << keptCount <<
+        " newPartitions=" << region.partitions.size() - keptCount <<
+        " partitionGroups=" << region.partitionGroups.size() << std::endl;
+}
+void Map::activateRegion(Scenario & scenario, size_t regionIndex)
+{
+    std::lock_guard<std::mutex> lock(regionMutex);
+    Region& region = regions[regionIndex];
+    if (!region.resident)
+    {
+        makeRegionResident(regionIndex);
+    }
+    if (region.stateSize == 0)
+    {
+        // solid all the way through, so there's nothing to simulate //
+        return;
+    }
+    scenario.regions[regionIndex] = RegionState(region.stateSize, region.ghostSources.size(),
+        region.dampedVoxels.size(), region.partitionGroups.size());
+    region.scenarioCount++;
+}
+void Map::deactivateRegion(Scenario & scenario, size_t regionIndex)
+{
+    std::lock_guard<std::mutex> lock(regionMutex);
+    scenario.regions[regionIndex] = RegionState();
+    Region& region = regions[regionIndex];
+    assert(region.scenarioCount > 0);
+    if (--region.scenarioCount == 0)
+    {
+        evictRegion(regionIndex);
+    }
+}
+bool Map::exchangeHalos(Scenario & scenario, HaloTransport & transport) const
+{
+    const unsigned rank = options.rank;
+    std::vector<std::vector<double>> outgoing(options.rankCount);
+    std::vector<std::vector<double>> incoming(options.rankCount);
+    for (unsigned peer = 0; peer < options.rankCount; peer++)
+    {
+        if (peer == rank)
+        {
+            continue;
+        }
+        outgoing[peer].reserve(haloPayloadSize(rank, peer) + (peer == 0 ? scenario.probes.size() : 0));
+        size_t incomingSize = haloPayloadSize(peer, rank);
+        if (rank == 0)
+        {
+            for (const auto& probe : scenario.probes)
+            {
+                if (regionRanks[probe.stateIndex.region] == peer)
+                {
+                    incomingSize++;
+                }
+            }
+        }
+        incoming[peer].resize(incomingSize);
+    }
+    // each link goes out as its region's activity, then the strip's pressures //
+    for (const auto& link : haloLinks)
+    {
+        if (!isRegionOwned(link.regionIndex))
+        {
+            continue;
+        }
+        std::vector<double>& payload = outgoing[regionRanks[link.neighborRegionIndex]];
+        const Region& region = regions[link.regionIndex];
+        const RegionState& regionState = scenario.regions[link.regionIndex];
+        payload.push_back(regionState.isActive() ? 1 : 0);
+        for (unsigned z = 0; z < link.voxelLengthZ; z++)
+        {
+            for (unsigned y = 0; y < link.voxelLengthY; y++)
+            {
+                for (unsigned x = 0; x < link.voxelLengthX; x++)
+                {
+                    const int stateIndex = !regionState.isActive() ? -1 : region.stateLookupTable[
+                        (size_t(z)*region.voxelLengthY + link.voxelY - region.voxelY + y)*region.voxelLengthX +
+                        link.voxelX - region.voxelX + x];
+                    payload.push_back(stateIndex < 0 ? 0 : regionState.voxelPressures[stateIndex]);
+                }
+            }
+        }
+    }
+    // rank 0 writes every probe, so the others report what theirs just read //
+    if (rank != 0)
+    {
+        for (const auto& probe : scenario.probes)
+        {
+            if (isRegionOwned(probe.stateIndex.region))
+            {
+                outgoing[0].push_back(probe.pressures.back());
+            }
+        }
+    }
+    if (!transport.exchange(outgoing, incoming))
+    {
+        return false;
+    }
+    std::vector<size_t> readOffsets(options.rankCount, 0);
+    for (size_t l = 0; l < haloLinks.size(); l++)
+    {
+        const HaloLink& link = haloLinks[l];
+        if (!isRegionOwned(link.neighborRegionIndex))
+        {
+            continue;
+        }
+        const unsigned fromRank = regionRanks[link.regionIndex];
+        const double* payload = incoming[fromRank].data() + readOffsets[fromRank];
+        readOffsets[fromRank] += 1 + link.openVoxels.size();
+        const bool remoteActive = payload[0] != 0;
+        scenario.regions[link.regionIndex].remoteActive = remoteActive;
+        std::copy(payload + 1, payload + 1 + link.openVoxels.size(), scenario.haloPressures[l].begin());
+        // the same face pressures which would knock on the neighbor within one rank //
+        RegionState& neighborState = scenario.regions[link.neighborRegionIndex];
+        if (remoteActive && !neighborState.isActive())
+        {
+            for (const size_t h : link.faceVoxels)
+            {
+                neighborState.knockPressure = std::max(neighborState.knockPressure,
+                    fabs(scenario.haloPressures[l][h]));
+            }
+        }
+    }
+    if (rank == 0)
+    {
+        for (auto& probe : scenario.probes)
+        {
+            const unsigned probeRank = regionRanks[probe.stateIndex.region];
+            if (probeRank != 0)
+            {
+                probe.pressures.back() = incoming[probeRank][readOffsets[probeRank]++];
+            }
+        }
+    }
+    return true;
+}
+void Map::fillGhostStrips(Scenario & scenario, size_t regionIndex, const Partition & partition) const
+{
+    RegionState& regionState = scenario.regions[regionIndex];
+    const Region& region = regions[regionIndex];
+    for (const auto& iFace : partition.interfaces)
+    {
+        // rigid faces never read theirs //
+        if (iFace.acrossRegionIndex != regionIndex && !isRegionActive(scenario, iFace.acrossRegionIndex))
+        {
+            continue;
+        }
+        const sf::Vector3i& iFaceDirection = DIRECTION_VECS[size_t(iFace.dir)];
+        const unsigned stencilReach = options.stencilOrder / 2;
+        size_t g = iFace.ghostOffset;
+        for (unsigned z = iFace.voxelZ; z < iFace.voxelZ + iFace.voxelLengthZ; z++)
+        {
+            for (unsigned x = iFace.voxelX; x < iFace.voxelX + iFace.voxelLengthX; x++)
+            {
+                for (unsigned y = iFace.voxelY; y < iFace.voxelY + iFace.voxelLengthY; y++)
+                {
+                    for (unsigned d = 1; d <= HALO_DEPTH; d++, g++)
+                    {
+                        // lower order stencils don't reach the far end of the strip //
+                        if (d > stencilReach)
+                        {
+                            continue;
+                        }
+                        const int source = region.ghostSources[g];
+                        if (source >= 0)
+                        {
+                            regionState.ghostPressures[g] = regionState.voxelPressures[source];
+                        }
+                        else if (source == GHOST_SOURCE_ABSENT)
+                        {
+                            regionState.ghostPressures[g] = 0;
+                        }
+                        else
+                        {
+                            // the neighbor may have streamed in or out since last step, so look it up //
+                            const sf::Vector3i ghost_i =
+                                sf::Vector3i(int(x), int(y), int(z)) + iFaceDirection*int(d);
+                            const double* pressure = findPressure(scenario,
+                                unsigned(ghost_i.x), unsigned(ghost_i.y), unsigned(ghost_i.z));
+                            regionState.ghostPressures[g] = pressure ? *pressure : 0;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+size_t Map::haloPayloadSize(unsigned fromRank, unsigned toRank) const
+{
+    size_t payloadSize = 0;
+    for (const auto& link : haloLinks)
+    {
+        if (regionRanks[link.regionIndex] == fromRank && regionRanks[link.neighborRegionIndex] == toRank)
+        {
+            payloadSize += 1 + link.openVoxels.size();
+        }
+    }
+    return payloadSize;
+}
+bool Map::isRegionOwned(size_t regionIndex) const
+{
+    return regionRanks[regionIndex] == options.rank;
+}
+bool Map::isRegionActive(const Scenario & scenario, size_t regionIndex) const
+{
+    return isRegionOwned(regionIndex) ?
+        scenario.regions[regionIndex].isActive() : scenario.regions[regionIndex].remoteActive;
+}
+void Map::executeGroupTransform(const PartitionGroup & group, fftw_plan plan,
+    fftw_r2r_kind kind, double * in, double * out)
+{
+    if (group.useSmallDct)
+    {
+        SmallDct::execute(kind, group.voxelLengthX, group.voxelLengthY,
+            group.partitionIndices.size(), group.stateStride, in, out);
+    }
+    else
+    {
+        fftw_execute_r2r(plan, in, out);
+    }
+}
+uint8_t Map::voxelMaterial(unsigned x, unsigned y, unsigned z) const
+{
+    const sf::Vector3f worldPos((x + 0.5f)*simVoxelSpacing,
+        mapPixelHeight - (y + 0.5f)*simVoxelSpacing,
+        (z + 0.5f)*simVoxelSpacing);
+    // because our units are meters, and each map tile is 1m^s,
+    //  we can just cast to ints to obtain map tile indexes
+    //  (and likewise for the 1m thick layers of volumetric maps):
+    const unsigned mapRow = unsigned(worldPos.y);
+    const unsigned mapCol = unsigned(worldPos.x);
+    const unsigned mapLayer = std::min(unsigned(worldPos.z), materialLayers - 1);
+    return cellMaterials[(size_t(mapLayer)*mapRows + mapRow)*mapCols + mapCol];
+}
+bool Map::isVoxelSolid(unsigned x, unsigned y, unsigned z) const
+{
+    return materials[voxelMaterial(x, y, z)].isSolid();
+}
+size_t Map::regionIndexOf(unsigned voxelX, unsigned voxelY) const
+{
+    return (voxelY / regionVoxelLength)*regionColumns + voxelX / regionVoxelLength;
+}
+bool Map::voxelOfStateIndex(const StateIndex & stateIndex, unsigned & x, unsigned & y, unsigned & z) const
+{
+    const Region& region = regions[stateIndex.region];
+    for (const auto& group : region.partitionGroups)
+    {
+        if (stateIndex.local < group.stateOffset ||
+            stateIndex.local >= group.stateOffset + group.partitionIndices.size()*group.stateStride)
+        {
+            continue;
+        }
+        const size_t member = (stateIndex.local - group.stateOffset) / group.stateStride;
+        const size_t i = stateIndex.local - group.stateOffset - member*group.stateStride;
+        if (i >= size_t(group.voxelLengthX)*group.voxelLengthY*group.voxelLengthZ)
+        {
+            return false;
+        }
+        const Partition& partition = region.partitions[group.partitionIndices[member]];
+        x = partition.voxelX + unsigned(i % group.voxelLengthX);
+        y = partition.voxelY + unsigned(i / group.voxelLengthX % group.voxelLengthY);
+        z = partition.voxelZ + unsigned(i / (size_t(group.voxelLengthX)*group.voxelLengthY));
+        return true;
+    }
+    return false;
+}
+const double * Map::findPressure(const Scenario & scenario, const StateIndex & stateIndex) const
+{
+    const RegionState& regionState = scenario.regions[stateIndex.region];
+    return regionState.isActive() ? regionState.voxelPressures + stateIndex.local : nullptr;
+}
+double Map::probePressure(const Scenario & scenario, const StateIndex & stateIndex) const
+{
+    const RegionState& regionState = scenario.regions[stateIndex.region];
+    if (!regionState.isActive())
+    {
+        return 0;
+    }
+    if (regionState.pressuresPruned)
+    {
+        const Region& region = regions[stateIndex.region];
+        for (size_t g = 0; g < region.partitionGroups.size(); g++)
+        {
+            const PartitionGroup& group = region.partitionGroups[g];
+            if (stateIndex.local < group.stateOffset ||
+                stateIndex.local >= group.stateOffset + group.partitionIndices.size()*group.stateStride)
+            {
+                continue;
+            }
+            if (!group.prunePressures || regionState.restingGroups[g])
+            {
+                break;
+            }
+            // a lone voxel is cheaper to sum straight from the modes than a plane through it //
+            const size_t member = (stateIndex.local - group.stateOffset) / group.stateStride;
+            const size_t memberOffset = group.stateOffset + member*group.stateStride;
+            const size_t i = stateIndex.local - memberOffset;
+            const unsigned x = unsigned(i % group.voxelLengthX);
+            const unsigned y = unsigned(i / group.voxelLengthX % group.voxelLengthY);
+            const unsigned z = unsigned(i / (size_t(group.voxelLengthX)*group.voxelLengthY));
+            return group.prunedIdct.executeVoxel(x, y, z, regionState.voxelModes + memberOffset) /
+                group.normalization;
+        }
+    }
+    return regionState.voxelPressures[stateIndex.local];
+}
+const double * Map::findPressure(const Scenario & scenario, unsigned x, unsigned y, unsigned z) const
+{
+    const size_t regionIndex = regionIndexOf(x, y);
+    const RegionState& regionState = scenario.regions[regionIndex];
+    if (!isRegionOwned(regionIndex))
+    {
+        // all we have of another rank's region are the strips it sent along our edges //
+        if (!regionState.remoteActive)
+        {
+            return nullptr;
+        }
+        for (unsigned side = 0; side < 4; side++)
+        {
+            const int l = haloLinkBySide[regionIndex * 4 + side];
+            if (l < 0)
+            {
+                continue;
+            }
+            const HaloLink& link = haloLinks[l];
+            if (x < link.voxelX || x >= link.voxelX + link.voxelLengthX ||
+                y < link.voxelY || y >= link.voxelY + link.voxelLengthY)
+            {
+                continue;
+            }
+            const size_t h = (size_t(z)*link.voxelLengthY + y - link.voxelY)*link.voxelLengthX + x - link.voxelX;
+            return link.openVoxels[h] ? scenario.haloPressures[l].data() + h : nullptr;
+        }
+        return nullptr;
+    }
+    if (!regionState.isActive())
+    {
+        return nullptr;
+    }
+    const Region& region = regions[regionIndex];
+    const int stateIndex = region.stateLookupTable[
+        (size_t(z)*region.voxelLengthY + y - region.voxelY)*region.voxelLengthX + x - region.voxelX];
+    return stateIndex < 0 ? nullptr : regionState.voxelPressures + stateIndex;
+}
+void Map::completePressures(Scenario & scenario) const
+{
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        if (scenario.regions[r].pressuresPruned)
+        {
+            completeRegionPressures(regions[r], scenario.regions[r]);
+        }
+    }
+}
+void Map::completeRegionPressures(const Region & region, RegionState & regionState) const
+{
+    for (size_t g = 0; g < region.partitionGroups.size(); g++)
+    {
+        const PartitionGroup& group = region.partitionGroups[g];
+        if (!group.prunePressures || regionState.restingGroups[g])
+        {
+            continue;
+        }
+        double* pressures = regionState.voxelPressures + group.stateOffset;
+        executeGroupTransform(group, group.planModeToPressure, FFTW_REDFT01,
+            regionState.voxelModes + group.stateOffset, pressures);
+        const size_t groupSize = group.partitionIndices.size()*group.stateStride;
+        for (size_t i = 0; i < groupSize; i++)
+        {
+            pressures[i] /= group.normalization;
+        }
+    }
+    regionState.pressuresPruned = false;
+}
+double Map::acousticEnergy(const Scenario & scenario) const
+{
+    double energy = 0;
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        const RegionState& regionState = scenario.regions[r];
+        if (!regionState.isActive())
+        {
+            continue;
+        }
+        for (size_t g = 0; g < regions[r].partitionGroups.size(); g++)
+        {
+            const PartitionGroup& group = regions[r].partitionGroups[g];
+            if (regionState.restingGroups[g])
+            {
+                continue;
+            }
+            const size_t gridSize = group.voxelLengthX*group.voxelLengthY*group.voxelLengthZ;
+            for (size_t p = 0; p < group.partitionIndices.size(); p++)
+            {
+                const size_t memberOffset = group.stateOffset + p*group.stateStride;
+                const double* modes = regionState.voxelModes + memberOffset;
+                const double* modesPrevious = regionState.voxelModesPrevious + memberOffset;
+                for (size_t i = 0; i < gridSize; i++)
+                {
+                    const double cosTerm = group.modalCosTerms[i];
+                    energy += (modes[i] * modes[i] + modesPrevious[i] * modesPrevious[i] -
+                        2 * cosTerm*modes[i] * modesPrevious[i]) / (2 * (1 - cosTerm));
+                }
+            }
+        }
+    }
+    return energy;
+}
+bool Map::writeCheckpoint(const Scenario & scenario, const std::string & filename) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "ERROR: could not open \"" << filename << "\"\n";
+        return false;
+    }
+    auto writeUint64 = [&file](uint64_t value)->void
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    file.write("WSCK", 4);
+    writeUint64(scenario.stepCount);
+    writeUint64(std::count_if(scenario.regions.begin(), scenario.regions.end(),
+        [](const RegionState& regionState)->bool { return regionState.isActive(); }));
+    for (size_t r = 0; r < scenario.regions.size(); r++)
+    {
+        const RegionState& regionState = scenario.regions[r];
+        if (!regionState.isActive())
+        {
+            continue;
+        }
+        writeUint64(r);
+        writeUint64(regionState.stateSize);
+        file.write(reinterpret_cast<const char*>(regionState.voxelModes), sizeof(double)*regionState.stateSize);
+        file.write(reinterpret_cast<const char*>(regionState.voxelModesPrevious), sizeof(double)*regionState.stateSize);
+    }
+    if (!file)
+    {
+        std::cerr << "ERROR: could not write \"" << filename << "\"\n";
+        return false;
+    }
+    std::cout << "wrote checkpoint \"" << filename << "\" at step " << scenario.stepCount << "\n";
+    return true;
+}
+std::vector<double> Map::pressureField(const Scenario & scenario) const
+{
+    std::vector<double> field(size_t(voxelGridLengthZ)*voxelGridLengthY*voxelGridLengthX, 0.0);
+    for (unsigned z = 0; z < voxelGridLengthZ; z++)
+    {
+        for (unsigned y = 0; y < voxelGridLengthY; y++)
+        {
+            for (unsigned x = 0; x < voxelGridLengthX; x++)
+            {
+                const double* pressure = findPressure(scenario, x, y, z);
+                if (pressure)
+                {
+                    field[(size_t(z)*voxelGridLengthY + y)*voxelGridLengthX + x] = *pressure;
+                }
+            }
+        }
+    }
+    return field;
+}
+void Map::updatePressureVisuals(Region& region, const RegionState& regionState,
+    unsigned lod, const sf::IntRect& texels)
+{
+    /// TODO: figure out wtf this even should be?? and wtf does it mean??
+    static const double MAX_PRESSURE_MAGNITUDE = 1.0;
+    const unsigned texelSize = 1u << lod;
+    const unsigned texelsX = (region.voxelLengthX + texelSize - 1) >> lod;
+    const unsigned texelsY = (region.voxelLengthY + texelSize - 1) >> lod;
+    if (region.pressureLod != lod || region.texPressures.getSize() != sf::Vector2u(texelsX, texelsY))
+    {
+        region.texPressures.create(texelsX, texelsY);
+        region.pressureLod = lod;
+    }
+    region.pressurePixels.resize(4 * size_t(texels.width)*texels.height);
+    // only the cross section at the visible slice gets drawn //
+    const size_t sliceOffset = size_t(visibleVoxelZ)*region.voxelLengthY*region.voxelLengthX;
+    for (int ty = 0; ty < texels.height; ty++)
+    {
+        const unsigned y0 = unsigned(texels.top + ty)*texelSize;
+        const unsigned y1 = std::min(y0 + texelSize, region.voxelLengthY);
+        for (int tx = 0; tx < texels.width; tx++)
+        {
+            const unsigned x0 = unsigned(texels.left + tx)*texelSize;
+            const unsigned x1 = std::min(x0 + texelSize, region.voxelLengthX);
+            // keep the sign of the loudest voxel, so a texel's colour matches what it'd be at full detail //
+            double peak = 0;
+            bool isNan = false;
+            for (unsigned y = y0; y < y1; y++)
+            {
+                for (unsigned x = x0; x < x1; x++)
+                {
+                    const int stateIndex = region.stateLookupTable[sliceOffset + size_t(y)*region.voxelLengthX + x];
+                    if (stateIndex < 0)
+                    {
+                        continue;
+                    }
+                    const double pressure = regionState.voxelPressures[stateIndex];
+                    isNan = isNan || _isnan(pressure);
+                    if (fabs(pressure) > fabs(peak))
+                    {
+                        peak = pressure;
+                    }
+                }
+            }
+            const double alphaPercent = std::min(fabs(peak) / MAX_PRESSURE_MAGNITUDE, 1.0);
+            const sf::Uint8 alpha = sf::Uint8(alphaPercent * 255);
+            sf::Color color = peak > 0 ?
+                sf::Color(0, 0, 255, alpha) : sf::Color(255, 0, 0, alpha);
+            if (isNan)
+            {
+                color = sf::Color::Green;
+            }
+            sf::Uint8* pixel = &region.pressurePixels[4 * (size_t(ty)*texels.width + tx)];
+            pixel[0] = color.r;
+            pixel[1] = color.g;
+            pixel[2] = color.b;
+            pixel[3] = color.a;
+        }
+    }
+    if (!region.pressurePixels.empty())
+    {
+        region.texPressures.update(&region.pressurePixels[0],
+            unsigned(texels.width), unsigned(texels.height), unsigned(texels.left), unsigned(texels.top));
+    }
+    region.pressureTexels = texels;
+    region.pressureRevision = pressureRevision;
+    // the quad covers the texels' voxels, trimmed back to the region's edge //
+    const float voxelLeft = float(texels.left*texelSize);
+    const float voxelRight = float(std::min(unsigned(texels.left + texels.width)*texelSize, region.voxelLengthX));
+    const float voxelBottom = float(texels.top*texelSize);
+    const float voxelTop = float(std::min(unsigned(texels.top + texels.height)*texelSize, region.voxelLengthY));
+    const float left = (region.voxelX + voxelLeft)*simVoxelSpacing;
+    const float right = (region.voxelX + voxelRight)*simVoxelSpacing;
+    const float bottom = (region.voxelY + voxelBottom)*simVoxelSpacing;
+    const float top = (region.voxelY + voxelTop)*simVoxelSpacing;
+    region.vaPressures = sf::VertexArray(sf::PrimitiveType::Quads, 4);
+    region.vaPressures[0] = sf::Vertex({ left, bottom }, { voxelLeft / texelSize, voxelBottom / texelSize });
+    region.vaPressures[1] = sf::Vertex({ right, bottom }, { voxelRight / texelSize, voxelBottom / texelSize });
+    region.vaPressures[2] = sf::Vertex({ right, top }, { voxelRight / texelSize, voxelTop / texelSize });
+    region.vaPressures[3] = sf::Vertex({ left, top }, { voxelLeft / texelSize, voxelTop / texelSize });
+}
+void Map::nullify()
+{
+    // a load still running on its threads is called off & waited out first //
+    if (loadThread.joinable())
+    {
+        cancelLoad = true;
+        loadThread.join();
+    }
+    cancelLoad = false;
+    loadStage = LoadStage::NONE;
+    tilesReady = false;
+    regionsToPrepare = 0;
+    regionsPrepared = 0;
+    releaseScenario(scenario);
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        if (regions[r].resident)
+        {
+            evictRegion(r);
+        }
+    }
+    regions.clear();
+    regionRanks.clear();
+    haloLinks.clear();
+    haloLinkBySide.clear();
+    toggledTiles.clear();
+    scenario = Scenario();
+}
+Map::Material::Material(float absorption, float transmission)
+    :absorption(absorption)
+    ,transmission(transmission)
+{
+}
+bool Map::Material::isSolid() const
+{
+    return transmission < MIN_TRANSMISSION;
+}
+bool Map::Material::operator==(const Material& other) const
+{
+    return absorption == other.absorption && transmission == other.transmission;
+}
+Map::ResolutionPlan::ResolutionPlan(float maximumSoundHz)
+    :maximumSoundHz(maximumSoundHz)
+    ,voxelGridLengthX(0)
+    ,voxelGridLengthY(0)
+    ,voxelGridLengthZ(0)
+    ,openVoxels(0)
+    ,interfaceVoxels(0)
+    ,stateBytes(0)
+    ,ghostBytes(0)
+    ,dampingBytes(0)
+    ,modalTermBytes(0)
+    ,lookupBytes(0)
+    ,visualBytes(0)
+    ,flopsPerStep(0)
+{
+}
+size_t Map::ResolutionPlan::totalBytes() const
+{
+    return stateBytes + ghostBytes + dampingBytes + modalTermBytes + lookupBytes + visualBytes;
+}
+Map::DampedVoxel::DampedVoxel(size_t stateIndex, double coefficient)
+    :stateIndex(stateIndex)
+    ,coefficient(coefficient)
+{
+}
+Map::TileSheet::TileSheet(const std::string& image, unsigned firstGid,
+    unsigned tileWidth, unsigned tileHeight, unsigned columns)
+    :image(image)
+    ,firstGid(firstGid)
+    ,tileWidth(tileWidth)
+    ,tileHeight(tileHeight)
+    ,columns(columns)
+{
+}
+Map::TileBatch::TileBatch(size_t sheetIndex)
+    :sheetIndex(sheetIndex)
+    ,vertices(sf::PrimitiveType::Quads)
+{
+}
+Map::VoxelMeta::VoxelMeta(int partitionIndex, uint8_t interfacedDirs)
+    :partitionIndex(partitionIndex)
+    ,interfacedDirectionFlags(interfacedDirs)
+{
+}
+Map::Region::Region(unsigned x, unsigned y, unsigned lx, unsigned ly)
+    :voxelX(x)
+    ,voxelY(y)
+    ,voxelLengthX(lx)
+    ,voxelLengthY(ly)
+    ,resident(false)
+    ,scenarioCount(0)
+    ,stateSize(0)
+    ,numInterfaces(0)
+    ,pressureLod(0)
+    ,pressureRevision(0)
+{
+}
+Map::HaloLink::HaloLink(size_t regionIndex, size_t neighborRegionIndex,
+    unsigned x, unsigned y, unsigned lx, unsigned ly, unsigned lz)
+    :regionIndex(regionIndex)
+    ,neighborRegionIndex(neighborRegionIndex)
+    ,voxelX(x)
+    ,voxelY(y)
+    ,voxelLengthX(lx)
+    ,voxelLengthY(ly)
+    ,voxelLengthZ(lz)
+    ,openVoxels(size_t(lx)*ly*lz, false)
+{
+}
+Map::LoadOptions::LoadOptions()
+    :volumetric(false)
+    ,regionTiles(32)
+    ,rank(0)
+    ,rankCount(1)
+    ,stencilOrder(6)
+    ,maximumSoundHz(2000)
+    ,memoryBudget(0)
+    ,concurrentScenarios(1)
+{
+}
+bool Map::LoadOptions::setQuality(const std::string& preset)
+{
+    if (preset == "preview") stencilOrder = 2;
+    else if (preset == "balanced") stencilOrder = 4;
+    else if (preset == "final") stencilOrder = 6;
+    else return false;
+    return true;
+}
+bool Map::LoadOptions::setMemoryBudget(const std::string& size)
+{
+    size_t parsed = 0;
+    double bytes = 0;
+    try
+    {
+        bytes = std::stod(size, &parsed);
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+    const std::string suffix = size.substr(parsed);
+    static const char UNITS[] = "KMGT";
+    if (suffix.size() == 1)
+    {
+        const char* unit = strchr(UNITS, toupper(suffix[0]));
+        if (!unit || !*unit)
+        {
+            return false;
+        }
+        bytes *= pow(1024.0, double(unit - UNITS + 1));
+    }
+    else if (!suffix.empty())
+    {
+        return false;
+    }
+    if (!(bytes >= 1))
+    {
+        return false;
+    }
+    memoryBudget = size_t(bytes);
+    return true;
+}
+Map::StateIndex::StateIndex(unsigned region, size_t local)
+    :region(region)
+    ,local(local)
+{
+}
+Map::Partition::Partition(unsigned y, unsigned x, unsigned z, unsigned lx, unsigned ly, unsigned lz)
+    :voxelY(y)
+    ,voxelX(x)
+    ,voxelZ(z)
+    ,voxelLengthX(lx)
+    ,voxelLengthY(ly)
+    ,voxelLengthZ(lz)
+    ,stateOffset(0)
+    ,groupIndex(0)
+{
+}
+Map::PartitionGroup::PartitionGroup(unsigned lx, unsigned ly, unsigned lz, unsigned rank, float deltaTime)
+    :voxelLengthX(lx)
+    ,voxelLengthY(ly)
+    ,voxelLengthZ(lz)
+    ,transformRank(rank)
+    ,normalization(sqrt(pow(2, rank)*lx*ly*lz))
+    ,stateOffset(0)
+    ,stateStride(0)
+    ,useSmallDct(false)
+    ,dependencyCount(0)
+    ,dampedBegin(0)
+    ,dampedEnd(0)
+    ,prunePressures(false)
+    ,prunedIdct(lx, ly, lz)
+    ,planModeToPressure(nullptr)
+    ,planForcingToModes(nullptr)
+{
+    const size_t gridSize = voxelLengthX*voxelLengthY*voxelLengthZ;
+    modalCosTerms.resize(gridSize);
+    modalForcingCoefficients.resize(gridSize);
+    for (size_t z = 0; z < voxelLengthZ; z++)
+    {
+        for (size_t y = 0; y < voxelLengthY; y++)
+        {
+            for (size_t x = 0; x < voxelLengthX; x++)
+            {
+                const size_t i = (z*voxelLengthY + y)*voxelLengthX + x;
+                // first, we need to calculate omega[i] //
+                ///TODO: use world-space to compute "k" instead of local index space?..
+                /// (does it even actually matter?..)
+                double k_i_2 = pow(PI, 2)*
+                    (pow(x + 1,2)/pow(voxelLengthX,2) +
+                     pow(y + 1,2)/pow(voxelLengthY,2));
+                if (transformRank == 3)
+                {
+                    k_i_2 += pow(PI, 2)*pow(z + 1, 2)/pow(voxelLengthZ, 2);
+                }
+                const double k_i = sqrt(k_i_2);
+                const double omega_i = SOUND_SPEED_METERS_PER_SECOND*k_i;
+                // then, the terms that equation (8) multiplies the modes & forcing by //
+                const double cosTerm = cos(omega_i*deltaTime);
+                modalCosTerms[i] = cosTerm;
+                ///TODO: figure out why this is fucked probably?
+                modalForcingCoefficients[i] = omega_i > 0 ?
+                    (2 / pow(omega_i, 2))*(1 - cosTerm) : 0;//some bullshit right here
+            }
+        }
+    }
+}
+Map::Probe::Probe(StateIndex stateIndex)
+    :stateIndex(stateIndex)
+{
+}
+Map::RegionState::RegionState(size_t stateSize, size_t ghostSize, size_t dampedSize, size_t groupCount)
+    :stateSize(stateSize)
+    ,voxelModes(nullptr)
+    ,voxelModesPrevious(nullptr)
+    ,voxelForcingTerms(nullptr)
+    ,voxelPressures(nullptr)
+    ,ghostPressures(ghostSize, 0)
+    ,dampedPressuresPrevious(dampedSize, 0)
+    ,restingGroups(groupCount, true)
+    ,knockPressure(0)
+    ,quietChecks(0)
+    ,remoteActive(false)
+    ,pressuresPruned(false)
+{
+    if (stateSize == 0)
+    {
+        return;
+    }
+    // fftw_malloc so every scenario shares the alignment the plans were made with.
+    //  The zeroing below is the first touch, so the pages land on the NUMA node
+    //  of the thread streaming the scenario, which is the one that steps it //
+    voxelModes = static_cast<double*>(fftw_malloc(sizeof(double)*stateSize));
+    voxelModesPrevious = static_cast<double*>(fftw_malloc(sizeof(double)*stateSize));
+    voxelForcingTerms = static_cast<double*>(fftw_malloc(sizeof(double)*stateSize));
+    voxelPressures = static_cast<double*>(fftw_malloc(sizeof(double)*stateSize));
+    for (size_t c = 0; c < stateSize; c++)
+    {
+        voxelModes[c] = 0;
+        voxelModesPrevious[c] = 0;
+        voxelForcingTerms[c] = 0;
+        voxelPressures[c] = 0;
+    }
+}
+Map::RegionState::RegionState(RegionState && other)
+    :stateSize(other.stateSize)
+    ,voxelModes(other.voxelModes)
+    ,voxelModesPrevious(other.voxelModesPrevious)
+    ,voxelForcingTerms(other.voxelForcingTerms)
+    ,voxelPressures(other.voxelPressures)
+    ,ghostPressures(std::move(other.ghostPressures))
+    ,dampedPressuresPrevious(std::move(other.dampedPressuresPrevious))
+    ,restingGroups(std::move(other.restingGroups))
+    ,knockPressure(other.knockPressure)
+    ,quietChecks(other.quietChecks)
+    ,remoteActive(other.remoteActive)
+    ,pressuresPruned(other.pressuresPruned)
+    ,partitionEnergies(std::move(other.partitionEnergies))
+    ,partitionPeakModes(std::move(other.partitionPeakModes))
+    ,partitionEnergiesPrevious(std::move(other.partitionEnergiesPrevious))
+    ,prunedIdctScratch(std::move(other.prunedIdctScratch))
+{
+    other.stateSize = 0;
+    other.voxelModes = other.voxelModesPrevious = nullptr;
+    other.voxelForcingTerms = other.voxelPressures = nullptr;
+}
+Map::RegionState & Map::RegionState::operator=(RegionState && other)
+{
+    if (this != &other)
+    {
+        std::swap(stateSize, other.stateSize);
+        std::swap(voxelModes, other.voxelModes);
+        std::swap(voxelModesPrevious, other.voxelModesPrevious);
+        std::swap(voxelForcingTerms, other.voxelForcingTerms);
+        std::swap(voxelPressures, other.voxelPressures);
+        std::swap(ghostPressures, other.ghostPressures);
+        std::swap(dampedPressuresPrevious, other.dampedPressuresPrevious);
+        std::swap(restingGroups, other.restingGroups);
+        std::swap(knockPressure, other.knockPressure);
+        std::swap(quietChecks, other.quietChecks);
+        std::swap(remoteActive, other.remoteActive);
+        std::swap(pressuresPruned, other.pressuresPruned);
+        std::swap(partitionEnergies, other.partitionEnergies);
+        std::swap(partitionPeakModes, other.partitionPeakModes);
+        std::swap(partitionEnergiesPrevious, other.partitionEnergiesPrevious);
+        std::swap(prunedIdctScratch, other.prunedIdctScratch);
+    }
+    return *this;
+}
+Map::RegionState::~RegionState()
+{
+    if (voxelModes) fftw_free(voxelModes);
+    if (voxelModesPrevious) fftw_free(voxelModesPrevious);
+    if (voxelForcingTerms) fftw_free(voxelForcingTerms);
+    if (voxelPressures) fftw_free(voxelPressures);
+}
+bool Map::RegionState::isActive() const
+{
+    return voxelPressures != nullptr;
+}
+Map::Scenario::Scenario()
+    :stepsSinceQuietCheck(0)
+    ,prunePressures(false)
+    ,skipRestingGroups(true)
+    ,stepCount(0)
+{
+}
+Map::StabilitySample::StabilitySample()
+    :step(0)
+    ,energy(0)
+    ,peakMode(0)
+    ,growthRate(1)
+    ,fastestRegion(0)
+    ,fastestPartition(0)
+    ,fastestGrowthRate(0)
+    ,driven(false)
+{
+}
+Map::StabilityMonitor::StabilityMonitor()
+    :sampleInterval(0)
+    ,historyLength(256)
+    ,divergentEnergyRatio(4)
+    ,divergentSamples(2)
+    ,actions(LOG)
+    ,checkpointFilename("checkpoint.wsck")
+    ,divergingSamples(0)
+    ,drivenEnergy(0)
+    ,diverged(false)
+    ,paused(false)
+    ,drivenSinceSample(false)
+{
+}
+void Map::StabilityMonitor::resume()
+{
+    paused = false;
+    diverged = false;
+    divergingSamples = 0;
+}
+Map::PointSource::PointSource(const Map& map, StateIndex stateIndex, float time, Type t)
+    :map(&map)
+    ,stateIndex(stateIndex)
+    ,type(t)
+    ,timeLeft(time)
+    ,totalTime(time)
+    ,stepIndex(0)
+{
+    if (type == Type::GAUSIAN_PULSE)
+    {
+        timeLeft = totalTime = std::max(time, gaussianPulse().size()*map.simDeltaTime);
+    }
+}
+Map::PointSource::PointSource(const Map& map, StateIndex stateIndex, std::shared_ptr<SignalStream> signal)
+    :PointSource(map, stateIndex, signal->getStepCount()*map.simDeltaTime, Type::WAV_FILE)
+{
+    this->signal = signal;
+}
+double Map::PointSource::step()
+{
+    timeLeft -= map->simDeltaTime;
+    const size_t s = stepIndex++;
+    const double click = 1.0*(1.0/map->simDeltaTime)*(1.0/pow(map->simVoxelSpacing,2));///WTF does this even mean?..  what units are  these?..
+    switch (type)
+    {
+    case PointSource::Type::CLICK:
+        std::cout << "\tclick stepped!\n";
+        return click;
+    case PointSource::Type::GAUSIAN_PULSE:
+        return s < gaussianPulse().size() ? click*gaussianPulse()[s] : 0;
+    case PointSource::Type::WAV_FILE:
+        return click*signal->next();
+    default:
+        return 0;
+    }
+}
+bool Map::PointSource::isSounding() const
+{
+    // every step the loader fell behind on pushed the rest of the signal a step later //
+    if (type == Type::WAV_FILE)
+    {
+        return stepIndex < signal->getStepCount() + signal->getUnderruns();
+    }
+    return timeLeft > 0;
+}
+const std::vector<double>& Map::PointSource::gaussianPulse() const
+{
+    return map->gaussianPulseTable;
 }
\ No newline at end of file
@@ -1,121 +1,691 @@
-#pragma once
-#include <SFML/Graphics.hpp>
-#include <string>
-#include <nlohmann\json.hpp>
-using json = nlohmann::json;
-#include <fstream>
-#include <fftw3.h>
-/*
-    In world space, each tile shall take up 1 square meter
-*/
-class Map
-{
-private:
-    static const float SOUND_SPEED_METERS_PER_SECOND;
-    // This value is tweakable, as human hearing limits are around 22khz
-    //  but increasing accuracy == HUGE increase in time/space requirements
-    static const float MAXIMUM_SOUND_HZ;
-    // this refers to the "h" variable in the research paper
-    //  restricted by Nyquist theorem
-    static const float SIM_VOXEL_SPACING;
-    // not entirely sure what this unit is.. probably seconds??
-    //  restricted by "the CFL condition"
-    static const float SIM_DELTA_TIME;
-    struct PartitionInterface
-    {
-        enum class Direction : uint8_t
-            { Y_POSITIVE, Y_NEGATIVE, X_NEGATIVE, X_POSITIVE };
-        Direction dir;
-        unsigned voxelX;
-        unsigned voxelY;
-        unsigned voxelLengthX;
-        unsigned voxelLengthY;
-    };
-    struct PointSource
-    {
-        enum class Type : uint8_t
-            {CLICK, GAUSIAN_PULSE};
-        size_t voxelIndex;
-        Type type;
-        float timeLeft;
-        float totalTime;
-        float printMeTime;
-        PointSource(size_t voxelIndex = 0, float time = 0.f, Type t = Type::CLICK);
-        double step();
-    };
-    struct Partition
-    {
-        Partition(unsigned y, unsigned x, unsigned lx, unsigned ly);
-        Partition(const Partition& other);
-        ~Partition();
-        unsigned voxelY;//Bottom
-        unsigned voxelX;//Left
-        unsigned voxelLengthX;
-        unsigned voxelLengthY;
-        std::vector<PartitionInterface> interfaces;
-        double* voxelModes;
-        double* voxelModesPrevious;
-        double* voxelForcingTerms;
-        double* voxelPressures;
-        fftw_plan planModeToPressure;
-        fftw_plan planForcingToModes;
-        PointSource ps;
-    };
-    struct VoxelMeta
-    {
-        VoxelMeta(int partitionIndex = -1, uint8_t interfacedDirs = 0);
-        int partitionIndex;
-        uint8_t interfacedDirectionFlags;
-    };
-public:
-    Map();
-    ~Map();
-    // returns false if any loading steps fuck up, true if we gucci
-    bool load(const std::string& jsonMapFilename);
-    void draw(sf::RenderTarget& rt);
-    // since the simulation requires a fixed timestep bound by "the CFL condition",
-    //  we don't pass the true delta-time between frames since we don't need it
-    void stepSimulation();
-    void toggleVoxelGrid();
-    void togglePartitionMeta();
-    void touch(const sf::Vector2f& worldSpaceLocation);
-private:
-    // loading/precomputation functions //
-    bool loadJsonMap(const std::string& jsonMapFilename);
-    bool loadTileset(const std::string& jsonMapFilename);
-    void buildMapTileVBO();
-    void buildVoxelGridVBO();
-    void buildVoxelPressureVBO();
-    void decomposeVoxelsIntoPartitions();
-    void buildPartitionVBO();
-    void calculatePartitionInterfaces();
-    void buildInterfaceVBO();
-    // /////////////////////////////// //
-    void nullify();
-private:
-    // MISC //
-    bool m_showVoxelGrid;
-    bool m_showPartitionMeta;
-    // Simulation data //
-    sf::VertexArray vaSimGridLines;
-    sf::VertexArray vaSimPartitions;
-    sf::VertexArray vaSimPartitionInterfaces;
-    sf::VertexArray vaSimGridPressures;
-    std::vector<Partition> partitions;
-    unsigned voxelGridLengthY;
-    unsigned voxelGridLengthX;
-    std::vector<std::vector<double*>> globalPressureLookupTable;
-    // precomputation meta //
-    std::vector<std::vector<VoxelMeta>> voxelMeta;
-    float mapPixelHeight;
-    unsigned numInterfaces;
-    // JSON map data //
-    json jsonMap;
-    sf::Texture texTileset;
-    sf::VertexArray vaTiles;
-    unsigned mapCols;
-    unsigned mapRows;
-    unsigned tilePixW;
-    unsigned tilePixH;
-    unsigned tilesetColumns;
+#pragma once
+#include "PrunedIdct.h"
+#include "SignalStream.h"
+#include <SFML/Graphics.hpp>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <fftw3.h>
+#include <mutex>
+#include <map>
+#include <memory>
+#include <thread>
+class HaloTransport;
+/*
+    In world space, each tile shall take up 1 square meter.
+    Volumetric maps stack every tile layer as a 1 meter thick slice, bottom to top,
+    while flat maps lay all of them over each other.
+    Tiles are rigid walls unless their "absorption" & "transmission" properties say otherwise.
+    The map is cut into square regions which are only decomposed & simulated
+    while something is happening in (or looking at) them
+*/
+class Map
+{
+private:
+    static const float SOUND_SPEED_METERS_PER_SECOND;
+    // the lowest maximum sound Hz that still gives every tile a voxel of its own
+    static const float MIN_SOUND_HZ;
+    // a region wakes up once the pressure against its edge passes this,
+    //  and is dropped after staying below it for REGION_QUIET_SECONDS
+    static const double REGION_ACTIVITY_PRESSURE;
+    static const float REGION_QUIET_SECONDS;
+    static const unsigned REGION_QUIET_CHECK_STEPS;
+    // how often the window's own scenario samples its stability
+    static const unsigned STABILITY_SAMPLE_STEPS;
+    // how many voxels past an interface its stencil reaches, which is how deep
+    //  ghost strips & the halos exchanged with other ranks have to be
+    static const unsigned HALO_DEPTH;
+    // ghost voxels which are solid or off the map, and those which have to be
+    //  looked up in another region every step, since it streams on its own
+    static const int GHOST_SOURCE_ABSENT;
+    static const int GHOST_SOURCE_ACROSS_REGION;
+    // materials letting through less than this much per meter are treated as rigid walls
+    static const float MIN_TRANSMISSION;
+    struct PartitionInterface
+    {
+        enum class Direction : uint8_t
+            { Y_POSITIVE, Y_NEGATIVE, X_NEGATIVE, X_POSITIVE, Z_POSITIVE, Z_NEGATIVE };
+        Direction dir;
+        unsigned voxelX;
+        unsigned voxelY;
+        unsigned voxelZ;
+        unsigned voxelLengthX;
+        unsigned voxelLengthY;
+        unsigned voxelLengthZ;
+        // the region holding the voxels across from this interface
+        size_t acrossRegionIndex;
+        // start of this interface's ghost strip in its region's ghost arrays:
+        //  HALO_DEPTH values per interface voxel, nearest first
+        size_t ghostOffset;
+    };
+    struct Partition
+    {
+        Partition(unsigned y, unsigned x, unsigned z, unsigned lx, unsigned ly, unsigned lz);
+        unsigned voxelY;//Bottom
+        unsigned voxelX;//Left
+        unsigned voxelZ;//Floor
+        unsigned voxelLengthX;
+        unsigned voxelLengthY;
+        unsigned voxelLengthZ;
+        // index of this partition's first voxel inside its region's state arrays
+        size_t stateOffset;
+        size_t groupIndex;
+        std::vector<PartitionInterface> interfaces;
+        // Positions along x, y & z, from the partition's corner, of the planes across each axis
+        //  holding every pressure a step reads: the interface stencils' & the damped voxels'
+        std::vector<unsigned> pressurePlanes[3];
+    };
+    // Every partition of a region with the same dimensions, laid out back to back
+    //  in the region's state arrays so one fftw plan transforms all of them
+    struct PartitionGroup
+    {
+        // equation (8)'s terms are worked out for steps of deltaTime
+        PartitionGroup(unsigned lx, unsigned ly, unsigned lz, unsigned rank, float deltaTime);
+        unsigned voxelLengthX;
+        unsigned voxelLengthY;
+        unsigned voxelLengthZ;
+        // 2 for flat maps, 3 for volumetric ones
+        unsigned transformRank;
+        // applied after each DCT & IDCT, so a round trip is the identity
+        double normalization;
+        size_t stateOffset;
+        // distance between consecutive members, padded to keep plan alignment
+        size_t stateStride;
+        std::vector<size_t> partitionIndices;
+        // equation (8) terms only depend on the partition's size, so they are
+        //  computed once here instead of every step
+        std::vector<double> modalCosTerms;
+        std::vector<double> modalForcingCoefficients;
+        // tiny groups skip fftw entirely in favour of precomputed matrix DCTs
+        bool useSmallDct;
+        // What the forcing pass has to wait for before it can run on this group: how many
+        //  other groups of the region its interface stencils read, and which other regions
+        std::vector<size_t> dependentGroups;
+        unsigned dependencyCount;
+        std::vector<size_t> acrossRegions;
+        // this group's run of the region's damped voxels, which are sorted by state index
+        size_t dampedBegin;
+        size_t dampedEnd;
+        // whether working out just its members' pressurePlanes costs much less than the whole IDCT,
+        //  for scenarios which prune their pressures
+        bool prunePressures;
+        PrunedIdct prunedIdct;
+        // planned against throwaway arrays, then run on any scenario's
+        //  arrays through fftw_execute_r2r
+        fftw_plan planModeToPressure;
+        fftw_plan planForcingToModes;
+    };
+    // what a tile is made of, as far as sound is concerned
+    struct Material
+    {
+        Material(float absorption = 0, float transmission = 0);
+        bool isSolid() const;
+        bool operator==(const Material& other) const;
+        // fraction of the energy striking a solid tile's face which it soaks up
+        float absorption;
+        // fraction of the pressure amplitude left after passing through 1m of the tile.
+        //  1 is open air, anything in between is simulated as lossy open space
+        float transmission;
+    };
+    // an open voxel losing energy every step, to the lossy material filling it
+    //  or the absorbing walls next to it
+    struct DampedVoxel
+    {
+        DampedVoxel(size_t stateIndex, double coefficient);
+        size_t stateIndex;
+        // multiplies the change in pressure over the last step
+        double coefficient;
+    };
+    // What simulating the whole map at one maximum sound Hz would cost this rank,
+    //  were every region streamed in at once.  Estimated from the tile grid alone,
+    //  before anything is decomposed
+    struct ResolutionPlan
+    {
+        ResolutionPlan(float maximumSoundHz = 0);
+        size_t totalBytes() const;
+        float maximumSoundHz;
+        unsigned voxelGridLengthX;
+        unsigned voxelGridLengthY;
+        unsigned voxelGridLengthZ;
+        double openVoxels;
+        // voxels along region edges, which all have interfaces //
+        double interfaceVoxels;
+        // modes, previous modes, forcing & pressures of every scenario //
+        size_t stateBytes;
+        size_t ghostBytes;
+        size_t dampingBytes;
+        // equation (8) terms of every partition group //
+        size_t modalTermBytes;
+        // state lookup tables & decomposition meta of every voxel //
+        size_t lookupBytes;
+        // pressure texture pixels of the visible slice //
+        size_t visualBytes;
+        // modal update, both transforms & the interface stencils of one scenario //
+        double flopsPerStep;
+    };
+    enum class LoadStage : uint8_t
+        { NONE, PARSING, BUILDING_REGIONS, PREPARING_REGIONS, READY, FAILED };
+    // a tileset image, and which global tile ids it draws
+    struct TileSheet
+    {
+        TileSheet(const std::string& image = std::string(), unsigned firstGid = 1,
+            unsigned tileWidth = 0, unsigned tileHeight = 0, unsigned columns = 1);
+        std::string image;
+        sf::Texture texture;
+        unsigned firstGid;
+        unsigned tileWidth;
+        unsigned tileHeight;
+        unsigned columns;
+    };
+    // the tiles of one layer which come from one sheet, drawn in layer order
+    struct TileBatch
+    {
+        TileBatch(size_t sheetIndex = 0);
+        size_t sheetIndex;
+        sf::VertexArray vertices;
+    };
+    struct VoxelMeta
+    {
+        VoxelMeta(int partitionIndex = -1, uint8_t interfacedDirs = 0);
+        int partitionIndex;
+        uint8_t interfacedDirectionFlags;
+    };
+    // A square column of the map, full height.  Partitions never cross a region's
+    //  edges, so each one is decomposed, planned & thrown away on its own
+    struct Region
+    {
+        Region(unsigned x, unsigned y, unsigned lx, unsigned ly);
+        unsigned voxelX;
+        unsigned voxelY;
+        unsigned voxelLengthX;
+        unsigned voxelLengthY;
+        bool resident;
+        // how many scenarios currently hold state for this region
+        unsigned scenarioCount;
+        // everything below only exists while the region is resident //
+        std::vector<Partition> partitions;
+        std::vector<PartitionGroup> partitionGroups;
+        // region-local [z][y][x] index into the region's state arrays, -1 if not in a partition
+        std::vector<int> stateLookupTable;
+        size_t stateSize;
+        std::vector<VoxelMeta> voxelMeta;
+        unsigned numInterfaces;
+        // where the exchange pass copies each ghost voxel from: an index into the
+        //  region's own state arrays, or one of the GHOST_SOURCE values
+        std::vector<int> ghostSources;
+        std::vector<DampedVoxel> dampedVoxels;
+        sf::VertexArray vaPartitions;
+        sf::VertexArray vaInterfaces;
+        // The visible slice's pressures, each texel the loudest of a 2^pressureLod voxel square.
+        //  Only pressureTexels, the part the view last overlapped, is kept coloured
+        sf::Texture texPressures;
+        std::vector<sf::Uint8> pressurePixels;
+        unsigned pressureLod;
+        sf::IntRect pressureTexels;
+        size_t pressureRevision;
+        // a single quad over pressureTexels
+        sf::VertexArray vaPressures;
+    };
+    // The strip of voxels along one region's edge which another rank's region reads
+    //  through its interfaces.  The rank owning regionIndex sends it every step
+    //  to the rank owning neighborRegionIndex
+    struct HaloLink
+    {
+        HaloLink(size_t regionIndex, size_t neighborRegionIndex,
+            unsigned x, unsigned y, unsigned lx, unsigned ly, unsigned lz);
+        size_t regionIndex;
+        size_t neighborRegionIndex;
+        // the strip, inside regionIndex //
+        unsigned voxelX;
+        unsigned voxelY;
+        unsigned voxelLengthX;
+        unsigned voxelLengthY;
+        unsigned voxelLengthZ;
+        // [z][y][x] across the strip, false where the voxel is solid
+        std::vector<bool> openVoxels;
+        // strip indices of the open voxels on the edge with open voxels across it
+        std::vector<size_t> faceVoxels;
+    };
+public:
+    struct LoadOptions
+    {
+        LoadOptions();
+        // treat each tile layer as a horizontal slice of a 3D world
+        bool volumetric;
+        // edge length of the regions the map streams in & out by, in tiles
+        unsigned regionTiles;
+        // which of how many processes this is when they split one simulation between them.
+        //  Every rank loads the same map & options, and simulates only its own regions
+        unsigned rank;
+        unsigned rankCount;
+        // accuracy order of the interface stencils: 2, 4 or 6.  Lower orders read
+        //  fewer voxels across every interface, so they step faster but leak more
+        //  spurious reflections off the partition boundaries
+        unsigned stencilOrder;
+        // "preview", "balanced" or "final".  Like maximumSoundHz, trades accuracy
+        //  for speed; returns false for unknown presets
+        bool setQuality(const std::string& preset);
+        // The highest frequency to simulate, which the voxel spacing & step follow
+        float maximumSoundHz;
+        // Bytes the map's wave state & region data may take up, 0 for no limit.
+        //  Loading lowers maximumSoundHz as far as it takes for the plan to fit
+        size_t memoryBudget;
+        // how many scenarios will hold state at once, for planning memory
+        unsigned concurrentScenarios;
+        // a byte count with an optional K, M, G or T suffix, eg. "512M" or "1.5G".
+        //  Returns false if it can't be parsed
+        bool setMemoryBudget(const std::string& size);
+    };
+    // where a voxel's state lives: its region, and the index inside that region's state arrays
+    struct StateIndex
+    {
+        StateIndex(unsigned region = 0, size_t local = 0);
+        unsigned region;
+        size_t local;
+    };
+    struct PointSource
+    {
+        enum class Type : uint8_t
+            {CLICK, GAUSIAN_PULSE, WAV_FILE};
+        // the map whose resolution it sounds at
+        const Map* map;
+        StateIndex stateIndex;
+        Type type;
+        float timeLeft;
+        float totalTime;
+        // steps driven so far
+        size_t stepIndex;
+        // WAV_FILE sources read one sample of this per step
+        std::shared_ptr<SignalStream> signal;
+        // a gaussian pulse always lasts at least as long as its whole table
+        PointSource(const Map& map, StateIndex stateIndex, float time, Type t = Type::CLICK);
+        // plays an opened signal through once
+        PointSource(const Map& map, StateIndex stateIndex, std::shared_ptr<SignalStream> signal);
+        // each sample drives the voxel like a click scaled by it, so whatever a probe
+        //  hears is the signal convolved with the click's response
+        double step();
+        // whether it still has samples to play.  WAV_FILE sources go by whole steps rather
+        //  than timeLeft, so a long file doesn't end early or late as float time drifts
+        bool isSounding() const;
+        // Unit-peak gaussian, sampled once per step & centered in the table, whose
+        //  spectrum has fallen 60dB by the map's maximum sound Hz so the grid carries all of it
+        const std::vector<double>& gaussianPulse() const;
+    };
+    struct Probe
+    {
+        Probe(StateIndex stateIndex = StateIndex());
+        StateIndex stateIndex;
+        std::vector<double> pressures;
+    };
+    // The wave state of one region inside one scenario.
+    //  Regions which haven't been disturbed yet, or have gone quiet, hold none
+    struct RegionState
+    {
+        explicit RegionState(size_t stateSize = 0, size_t ghostSize = 0, size_t dampedSize = 0,
+            size_t groupCount = 0);
+        RegionState(RegionState&& other);
+        RegionState& operator=(RegionState&& other);
+        RegionState(const RegionState&) = delete;
+        RegionState& operator=(const RegionState&) = delete;
+        ~RegionState();
+        bool isActive() const;
+        size_t stateSize;
+        double* voxelModes;
+        double* voxelModesPrevious;
+        double* voxelForcingTerms;
+        double* voxelPressures;
+        // the pressures across every interface, copied in once per step so the
+        //  forcing pass never leaves its own partition
+        std::vector<double> ghostPressures;
+        // last step's pressure of each of the region's damped voxels
+        std::vector<double> dampedPressuresPrevious;
+        // partition groups no wave has reached yet, which skip their transforms
+        //  since every one of their modes & pressures is still exactly zero
+        std::vector<bool> restingGroups;
+        // loudest pressure pushing against this region while it was inactive
+        double knockPressure;
+        unsigned quietChecks;
+        // for regions another rank owns: whether that rank had them active this step
+        bool remoteActive;
+        // whether the last step only worked out the pressures it reads, leaving the rest stale
+        bool pressuresPruned;
+        // each partition's energy & loudest mode as of the last stability sample, and the sample before
+        std::vector<double> partitionEnergies;
+        std::vector<double> partitionPeakModes;
+        std::vector<double> partitionEnergiesPrevious;
+        // shared by the pruned inverse transforms of every group, grown to the largest
+        //  one's needs the first step it prunes & reused from then on
+        std::vector<double> prunedIdctScratch;
+    };
+    // Where one partition's pressures sit inside a scenario's state, x varying fastest, then y, then z
+    struct PartitionView
+    {
+        const double* pressures;
+        unsigned region;
+        unsigned voxelX;
+        unsigned voxelY;
+        unsigned voxelZ;
+        unsigned voxelLengthX;
+        unsigned voxelLengthY;
+        unsigned voxelLengthZ;
+    };
+    // A scenario's health at one step, worked out from its modes while they're updated
+    struct StabilitySample
+    {
+        StabilitySample();
+        // steps the scenario had taken
+        size_t step;
+        // what acousticEnergy would say
+        double energy;
+        // the biggest magnitude of any mode
+        double peakMode;
+        // the energy's growth per step since the sample before, 1 when it's held steady
+        double growthRate;
+        // the partition whose energy grew fastest, which is where a runaway usually starts
+        unsigned fastestRegion;
+        size_t fastestPartition;
+        double fastestGrowthRate;
+        // whether a source drove the scenario since the sample before, which grows it legitimately
+        bool driven;
+    };
+    // Samples a scenario's energy every so often & watches for it running away
+    struct StabilityMonitor
+    {
+        enum Action : uint8_t
+        {
+            LOG = 1 << 0,
+            // sets paused, which whatever steps the scenario has to check
+            PAUSE = 1 << 1,
+            // writes the scenario's modes to checkpointFilename, see writeCheckpoint
+            DUMP_CHECKPOINT = 1 << 2
+        };
+        StabilityMonitor();
+        // lets a paused scenario step again, with the actions ready to fire should it diverge anew
+        void resume();
+        // steps between samples, 0 for none.  A sampling step costs about one more pass over the modes
+        unsigned sampleInterval;
+        // samples kept, the oldest making way
+        size_t historyLength;
+        // How many times what the sources last left in it an undriven scenario's energy
+        //  can reach before it counts as diverging.  Interfaces don't conserve energy exactly,
+        //  so it sways by up to half as wavefronts cross them, but never runs away like this
+        double divergentEnergyRatio;
+        // samples in a row which have to diverge before the actions fire.  Energy which
+        //  isn't finite fires them straight away
+        unsigned divergentSamples;
+        uint8_t actions;
+        std::string checkpointFilename;
+        // the last historyLength samples, oldest first
+        std::deque<StabilitySample> history;
+        unsigned divergingSamples;
+        // the energy at the last sample a source drove, which the undriven ones are held to
+        double drivenEnergy;
+        // set once the actions have fired, so they only fire the once
+        bool diverged;
+        bool paused;
+        // whether a source has driven the scenario since the last sample
+        bool drivenSinceSample;
+    };
+    // All the wave state of one simulation run.
+    //  The partition layout, interfaces & fftw plans are owned by the Map
+    //  and shared read-only, so any number of these can be stepped at once.
+    struct Scenario
+    {
+        Scenario();
+        std::vector<RegionState> regions;
+        std::vector<PointSource> pointSources;
+        std::vector<Probe> probes;
+        // world-space area which stays streamed in no matter how quiet, eg. what the camera sees
+        sf::FloatRect viewBounds;
+        unsigned stepsSinceQuietCheck;
+        // last received pressures of every HaloLink this rank receives, in link order
+        std::vector<std::vector<double>> haloPressures;
+        // Headless runs which only read their probes can set this, so each step only works out
+        //  the pressures its forcing & probes read.  completePressures brings back the rest
+        bool prunePressures;
+        // On by default: groups no wave has reached yet skip their transforms.  Turning
+        //  it off steps every group of a streamed in region, to check the skipping against
+        bool skipRestingGroups;
+        // steps taken so far
+        size_t stepCount;
+        StabilityMonitor stability;
+    };
+public:
+    // the resolution the last load planned; maps loaded side by side can each have their own
+    float getSimDeltaTime() const;
+    float getVoxelSpacing() const;
+    float getMaximumSoundHz() const;
+    Map();
+    ~Map();
+    // returns false if any loading steps fuck up, true if we gucci
+    bool load(const std::string& jsonMapFilename, const LoadOptions& options = LoadOptions());
+    // Loads on worker threads instead, returning straight away.  The tiles can be drawn as soon
+    //  as they're in, while the regions under the view are decomposed & planned side by side.
+    //  Until isReady, nothing but draw & the load status may be called
+    void loadAsync(const std::string& jsonMapFilename, const LoadOptions& options,
+        const sf::FloatRect& worldSpaceViewBounds);
+    bool isReady() const;
+    bool hasLoadFailed() const;
+    // what loading is busy with, and how far along it is from 0 to 1
+    std::string getLoadStatus(float& progress) const;
+    void draw(sf::RenderTarget& rt);
+    // since the simulation requires a fixed timestep bound by "the CFL condition",
+    //  we don't pass the true delta-time between frames since we don't need it
+    void stepSimulation();
+    void toggleVoxelGrid();
+    void togglePartitionMeta();
+    // Stops stepping the map's own scenario, or carries on after its stability watch stopped it,
+    //  watching for it to diverge again
+    void togglePause();
+    // the stability samples of the map's own scenario, which the map takes as it steps
+    const StabilityMonitor& getStability() const;
+    // steps the displayed slice of a volumetric map up or down
+    void moveVisibleSlice(int deltaVoxels);
+    void touch(const sf::Vector2f& worldSpaceLocation);
+    // keeps whatever the camera can see streamed in
+    void setViewBounds(const sf::FloatRect& worldSpaceBounds);
+    // an empty scenario; regions get state as soon as it is streamed
+    Scenario createScenario() const;
+    // Gives state to the regions around the scenario's sources, probes & view,
+    //  and to those its wavefronts are reaching, then drops the quiet ones.
+    //  Call before every stepScenario.  Safe to call from different threads
+    //  for different scenarios
+    void streamScenario(Scenario& scenario);
+    // advances a scenario by one getSimDeltaTime().  Only reads the Map,
+    //  so it is safe to step different scenarios from different threads.
+    //  Every partition takes the same step, however big: the interface stencils are
+    //  explicit & bound by that step, so a partition stepping less often across a live
+    //  interface diverges.  Only groups no wave has reached yet skip their transforms.
+    //  When the map is split between ranks, every rank must step the same scenario
+    //  in lockstep through the transport; returns false if that exchange fails
+    bool stepScenario(Scenario& scenario, HaloTransport* transport = nullptr) const;
+    // drops all of a scenario's state so the regions it used can be evicted
+    void releaseScenario(Scenario& scenario);
+    // returns false if the location isn't inside any partition.
+    //  Decomposes the location's region if it isn't resident yet
+    bool findStateIndex(const sf::Vector3f& worldSpaceLocation, StateIndex& outStateIndex);
+    // the most doubles one rank sends another in a step's halo exchange, not counting probes
+    size_t maxHaloPayload() const;
+    // Total acoustic energy in the scenario's regions, in pressure squared units: each mode's
+    //  M^2 + M'^2 - 2cos(wdt)MM', which equation (8) keeps constant while nothing forces it,
+    //  over 2(1 - cos(wdt)).  Cheap enough to check every step
+    double acousticEnergy(const Scenario& scenario) const;
+    // Writes every active region's modes & last step's modes, so a run which went wrong can be
+    //  looked into: "WSCK", then the step count, the region count with state & for each one
+    //  its index & state size as uint64s, followed by both arrays of doubles.
+    //  Returns false, having said why, if the file can't be written
+    bool writeCheckpoint(const Scenario& scenario, const std::string& filename) const;
+    // works out every pressure the last step of a scenario which prunes them left stale
+    void completePressures(Scenario& scenario) const;
+    // Every voxel's pressure in [z][y][x] order, 0 where it's solid or its region has no state.
+    //  Scenarios which prune their pressures have to be completed first
+    std::vector<double> pressureField(const Scenario& scenario) const;
+    // Every partition of the regions with state in the scenario.  The views point straight
+    //  into the scenario's arrays, so they only last until it is next streamed, and like
+    //  pressureField only hold every pressure once a pruning scenario is completed
+    std::vector<PartitionView> partitionViews(const Scenario& scenario) const;
+    sf::Vector3<unsigned> getVoxelGridLengths() const;
+    // Puts another global tile id (0 for none) at a column & row, counted from the top like Tiled,
+    //  of a tile layer.  Resident regions are only re-decomposed around the tile, and only if
+    //  it went from open to solid or back; the wave state of this map's own scenario & the
+    //  given ones is carried over into the new partitions.  Every other scenario stepping
+    //  this map has to be passed, and none of them stepped meanwhile.
+    //  Returns false, having said why, if the tile can't be changed
+    bool setTile(unsigned column, unsigned row, unsigned layer, uint16_t gid,
+        const std::vector<Scenario*>& scenarios = std::vector<Scenario*>());
+    // opens the cell under the location in the visible slice like a door, or closes it again
+    void toggleTile(const sf::Vector2f& worldSpaceLocation);
+private:
+    // loading/precomputation functions //
+    // everything load does after nullifying, also ending with the regions under the view resident
+    bool runLoad(const std::string& jsonMapFilename, const sf::FloatRect& worldSpaceViewBounds);
+    bool loadJsonMap(const std::string& jsonMapFilename);
+    bool loadTilesets(const std::string& jsonMapFilename);
+    // picks the material of one cell of cellMaterials from the tiles stacked in it
+    void resolveCellMaterial(unsigned column, unsigned row, unsigned materialLayer);
+    ResolutionPlan planResolution(float maximumSoundHz) const;
+    // Plans options.maximumSoundHz, lowering it to the highest that fits options.memoryBudget,
+    //  and sets the resolution to it.  Returns false if even MIN_SOUND_HZ doesn't fit
+    bool chooseResolution();
+    void setMaximumSoundHz(float maximumSoundHz);
+    void buildMapTileVBO();
+    void sizeVoxelGrid();
+    void buildRegions();
+    void assignRegionRanks();
+    void buildHaloLinks();
+    // /////////////////////////////// //
+    // Region streaming functions.  Each only writes the region it's given & reads nothing
+    //  else but the voxel grid, which nothing edits while loading, so runLoad prepares several
+    //  regions at once without regionMutex, each on a worker of its own.  Everywhere else
+    //  they're called with regionMutex held.  fftw's planner takes its own lock //
+    void makeRegionResident(size_t regionIndex);
+    void evictRegion(size_t regionIndex);
+    void decomposeVoxelsIntoPartitions(Region& region);
+    void buildPartitionVBO(Region& region);
+    void calculatePartitionInterfaces(Region& region);
+    void buildGhostStrips(Region& region);
+    void buildDampedVoxels(Region& region);
+    // which groups & regions each group's interface stencils read the pressures of, the planes
+    //  of each partition's voxels they & the damping read, and which groups those let prune
+    void buildStencilReads(Region& region);
+    void buildInterfaceVBO(Region& region);
+    void planPartitionTransforms(Region& region);
+    // swaps the partitions touching the voxels in [boxMin, boxMax) for a fresh decomposition
+    //  of what's open there now, projecting the scenarios' state onto the new partitions
+    void redecomposeRegion(size_t regionIndex, const unsigned boxMin[3], const unsigned boxMax[3],
+        const std::vector<Scenario*>& scenarios);
+    // /////////////////////////////// //
+    // marks the regions which a world-space rectangle overlaps
+    void pinViewRegions(const sf::FloatRect& view, std::vector<bool>& pinnedRegions) const;
+    void activateRegion(Scenario& scenario, size_t regionIndex);
+    void deactivateRegion(Scenario& scenario, size_t regionIndex);
+    bool exchangeHalos(Scenario& scenario, HaloTransport& transport) const;
+    // copies everything the partition's stencils read from across its interfaces into its ghost strips
+    void fillGhostStrips(Scenario& scenario, size_t regionIndex, const Partition& partition) const;
+    // equation (8) & the IDCT back to pressures, for every member of a group.
+    //  Pruning groups only transform their members' pressurePlanes.  Sampling steps also
+    //  work out each member's energy & loudest mode for the stability monitor
+    void updateGroupPressures(const Region& region, RegionState& regionState, size_t groupIndex,
+        bool prune, bool sample) const;
+    // adds up a sampling step's partitions into the scenario's stability history & fires its actions
+    void sampleStability(Scenario& scenario) const;
+    void completeRegionPressures(const Region& region, RegionState& regionState) const;
+    // Equation (9) across the group's interfaces, its damping & the sources in it,
+    //  then the DCT back to modes.  sourceGroups holds the group of each of the
+    //  scenario's sources sounding this step, or -1 for those which aren't
+    void updateGroupForcing(Scenario& scenario, size_t regionIndex, size_t groupIndex,
+        const std::vector<int>& sourceGroups) const;
+    size_t haloPayloadSize(unsigned fromRank, unsigned toRank) const;
+    bool isRegionOwned(size_t regionIndex) const;
+    // owned regions with state, or foreign ones their rank says are active
+    bool isRegionActive(const Scenario& scenario, size_t regionIndex) const;
+    static void executeGroupTransform(const PartitionGroup& group, fftw_plan plan,
+        fftw_r2r_kind kind, double* in, double* out);
+    // index into materials of what fills the voxel
+    uint8_t voxelMaterial(unsigned x, unsigned y, unsigned z) const;
+    bool isVoxelSolid(unsigned x, unsigned y, unsigned z) const;
+    size_t regionIndexOf(unsigned voxelX, unsigned voxelY) const;
+    // the map voxel a resident region keeps at the state index, through its partition groups;
+    //  false for the padding between a group's members
+    bool voxelOfStateIndex(const StateIndex& stateIndex, unsigned& x, unsigned& y, unsigned& z) const;
+    // nullptr if the voxel isn't in a partition, or its region has no state in the scenario
+    const double* findPressure(const Scenario& scenario, const StateIndex& stateIndex) const;
+    // the voxel's pressure after the last step, even if it pruned it; 0 without state
+    double probePressure(const Scenario& scenario, const StateIndex& stateIndex) const;
+    const double* findPressure(const Scenario& scenario, unsigned x, unsigned y, unsigned z) const;
+    // lines every 2^lod voxels, only across the given voxels
+    void buildVoxelGridLines(const sf::IntRect& visibleVoxels, unsigned lod);
+    // recolours the region's texels, reducing each square of voxels to its largest magnitude
+    void updatePressureVisuals(Region& region, const RegionState& regionState,
+        unsigned lod, const sf::IntRect& texels);
+    void nullify();
+private:
+    // MISC //
+    bool m_showVoxelGrid;
+    bool m_showPartitionMeta;
+    // Simulation data //
+    sf::VertexArray vaSimGridLines;
+    unsigned voxelGridLengthY;
+    unsigned voxelGridLengthX;
+    unsigned voxelGridLengthZ;
+    unsigned visibleVoxelZ;
+    // bumped whenever the pressures being shown change, so regions know to recolour
+    size_t pressureRevision;
+    std::vector<Region> regions;
+    unsigned regionVoxelLength;
+    unsigned regionColumns;
+    // guards region residency, which every scenario's streaming shares
+    std::mutex regionMutex;
+    // which rank simulates each region //
+    std::vector<unsigned> regionRanks;
+    std::vector<HaloLink> haloLinks;
+    // index into haloLinks of the link this rank receives from each [region*4 + side], -1 if none
+    std::vector<int> haloLinkBySide;
+    Scenario scenario;
+    // Loading //
+    std::thread loadThread;
+    std::atomic<LoadStage> loadStage;
+    std::atomic<bool> tilesReady;
+    std::atomic<bool> cancelLoad;
+    std::atomic<size_t> regionsToPrepare;
+    std::atomic<size_t> regionsPrepared;
+    // precomputation meta //
+    float mapPixelHeight;
+    // This value is tweakable, as human hearing limits are around 22khz
+    //  but increasing accuracy == HUGE increase in time/space requirements.
+    //  Set by each load from its LoadOptions, so maps at different resolutions can live
+    //  side by side.  They don't agree on the same room yet, since the modal wavenumbers
+    //  are in voxels & the interface forcing in meters, so nothing steps a scenario's
+    //  octave bands on coarser maps until the solver fixes its units
+    float maximumSoundHz;
+    // this refers to the "h" variable in the research paper
+    //  restricted by Nyquist theorem
+    float simVoxelSpacing;
+    // not entirely sure what this unit is.. probably seconds??
+    //  restricted by "the CFL condition"
+    float simDeltaTime;
+    // PointSource::gaussianPulse at this resolution
+    std::vector<double> gaussianPulseTable;
+    // Tiled map data //
+    LoadOptions options;
+    // [layer][row][col] tile ids of every tile layer, 0 where empty
+    std::vector<uint16_t> tileIds;
+    unsigned mapLayers;
+    unsigned mapCols;
+    unsigned mapRows;
+    // materials[0] is open air, the rest are every distinct set of tile properties
+    std::vector<Material> materials;
+    // index into materials of each global tile id with properties, the rest are rigid
+    std::vector<uint8_t> gidMaterials;
+    // tile ids toggleTile took out of each [layer][row][col], to put back when it's toggled again
+    std::map<size_t, uint16_t> toggledTiles;
+    // [layer][row][col] index into materials of what fills each cell.  Volumetric maps
+    //  keep one layer per 1m slice, flat ones a single layer with the least
+    //  transmissive tile of each cell's stack
+    std::vector<uint8_t> cellMaterials;
+    unsigned materialLayers;
+    // Rendering //
+    std::vector<TileSheet> tileSheets;
+    std::vector<TileBatch> tileBatches;
 };
\ No newline at end of file
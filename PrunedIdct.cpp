@@ -0,0 +1,170 @@
+#include "PrunedIdct.h"
+#include "toolbox.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <vector>
+namespace
+{
+    // Tables are never freed or changed once made, so the pointers
+    //  handed out stay good however many more lengths get added //
+    std::mutex tablesMutex;
+    std::map<unsigned, std::vector<double>> tablesByLength;
+    const double* dct3Table(unsigned length)
+    {
+        std::lock_guard<std::mutex> lock(tablesMutex);
+        std::vector<double>& table = tablesByLength[length];
+        if (table.empty())
+        {
+            table.resize(size_t(length)*length);
+            for (unsigned j = 0; j < length; j++)
+            {
+                for (unsigned k = 0; k < length; k++)
+                {
+                    table[size_t(j)*length + k] = j == 0 ? 1.0 : 2 * cos(PI*j*(k + 0.5) / length);
+                }
+            }
+        }
+        return table.data();
+    }
+}
+PrunedIdct::PrunedIdct(unsigned lengthX, unsigned lengthY, unsigned lengthZ)
+    :lengths{ lengthX, lengthY, lengthZ }
+    ,tables{ nullptr, nullptr, nullptr }
+{
+}
+void PrunedIdct::prepare()
+{
+    for (unsigned axis = 0; axis < 3; axis++)
+    {
+        tables[axis] = dct3Table(lengths[axis]);
+    }
+}
+void PrunedIdct::executePlane(unsigned axis, unsigned position, const double* in, double* out,
+    double normalization, double* scratch) const
+{
+    assert(tables[0] && axis < 3 && position < lengths[axis]);
+    // b & c are the plane's own axes, b the faster varying //
+    const unsigned b = axis == 0 ? 1 : 0;
+    const unsigned c = axis == 2 ? 1 : 2;
+    const size_t strides[3] = { 1, lengths[0], size_t(lengths[0])*lengths[1] };
+    const unsigned lengthA = lengths[axis];
+    const unsigned lengthB = lengths[b];
+    const unsigned lengthC = lengths[c];
+    const double* tableA = tables[axis];
+    const double* tableB = tables[b];
+    const double* tableC = tables[c];
+    double* weights = scratch;
+    double* plane = weights + lengthA;
+    double* line = plane + size_t(lengthB)*lengthC;
+    for (unsigned k = 0; k < lengthA; k++)
+    {
+        weights[k] = tableA[size_t(k)*lengthA + position];
+    }
+    // contract the modes along the axis into a [c][b] plane of modes //
+    std::fill(plane, plane + size_t(lengthB)*lengthC, 0.0);
+    for (unsigned kc = 0; kc < lengthC; kc++)
+    {
+        double* planeRow = plane + size_t(kc)*lengthB;
+        if (axis == 0)
+        {
+            for (unsigned kb = 0; kb < lengthB; kb++)
+            {
+                const double* modes = in + kc*strides[c] + kb*strides[b];
+                double sum = 0;
+                for (unsigned k = 0; k < lengthA; k++)
+                {
+                    sum += weights[k] * modes[k];
+                }
+                planeRow[kb] = sum;
+            }
+        }
+        else
+        {
+            // b is x, so each mode row is contiguous //
+            for (unsigned k = 0; k < lengthA; k++)
+            {
+                const double* modes = in + kc*strides[c] + k*strides[axis];
+                const double weight = weights[k];
+                for (unsigned kb = 0; kb < lengthB; kb++)
+                {
+                    planeRow[kb] += weight*modes[kb];
+                }
+            }
+        }
+    }
+    // transform each row of the plane along b //
+    for (unsigned kc = 0; kc < lengthC; kc++)
+    {
+        double* planeRow = plane + size_t(kc)*lengthB;
+        std::fill(line, line + lengthB, 0.0);
+        for (unsigned kb = 0; kb < lengthB; kb++)
+        {
+            const double* tableRow = tableB + size_t(kb)*lengthB;
+            const double mode = planeRow[kb];
+            for (unsigned n = 0; n < lengthB; n++)
+            {
+                line[n] += mode*tableRow[n];
+            }
+        }
+        std::copy(line, line + lengthB, planeRow);
+    }
+    // ..then along c, straight into the output //
+    double* outPlane = out + position*strides[axis];
+    for (unsigned nc = 0; nc < lengthC; nc++)
+    {
+        std::fill(line, line + lengthB, 0.0);
+        for (unsigned kc = 0; kc < lengthC; kc++)
+        {
+            const double weight = tableC[size_t(kc)*lengthC + nc];
+            const double* planeRow = plane + size_t(kc)*lengthB;
+            for (unsigned n = 0; n < lengthB; n++)
+            {
+                line[n] += weight*planeRow[n];
+            }
+        }
+        double* outRow = outPlane + nc*strides[c];
+        for (unsigned n = 0; n < lengthB; n++)
+        {
+            outRow[n*strides[b]] = line[n] / normalization;
+        }
+    }
+}
+double PrunedIdct::executeVoxel(unsigned x, unsigned y, unsigned z, const double* in) const
+{
+    assert(tables[0] && x < lengths[0] && y < lengths[1] && z < lengths[2]);
+    double pressure = 0;
+    for (unsigned kz = 0; kz < lengths[2]; kz++)
+    {
+        double slice = 0;
+        for (unsigned ky = 0; ky < lengths[1]; ky++)
+        {
+            const double* modes = in + (size_t(kz)*lengths[1] + ky)*lengths[0];
+            double row = 0;
+            for (unsigned kx = 0; kx < lengths[0]; kx++)
+            {
+                row += tables[0][size_t(kx)*lengths[0] + x] * modes[kx];
+            }
+            slice += tables[1][size_t(ky)*lengths[1] + y] * row;
+        }
+        pressure += tables[2][size_t(kz)*lengths[2] + z] * slice;
+    }
+    return pressure;
+}
+size_t PrunedIdct::planeCost(unsigned axis) const
+{
+    const unsigned b = axis == 0 ? 1 : 0;
+    const unsigned c = axis == 2 ? 1 : 2;
+    const size_t planeSize = size_t(lengths[b])*lengths[c];
+    return planeSize*lengths[axis] + planeSize*(lengths[b] + lengths[c]);
+}
+size_t PrunedIdct::scratchSize() const
+{
+    const unsigned longest = std::max(lengths[0], std::max(lengths[1], lengths[2]));
+    const size_t largestPlane = std::max(size_t(lengths[0])*lengths[1],
+        std::max(size_t(lengths[0])*lengths[2], size_t(lengths[1])*lengths[2]));
+    // the contraction weights, the plane & one line of it //
+    return 2 * size_t(longest) + largestPlane;
+}
\ No newline at end of file
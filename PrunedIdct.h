@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+/*
+    The unnormalized FFTW_REDFT01 (DCT-III) of a [z][y][x] grid, worked out only
+    across a few planes of it, or at single voxels.  A plane contracts the modes
+    along its own axis first, then transforms what's left as matrix DCTs, so it costs
+    one pass over the modes instead of the full transform's pass per axis & log factor.
+    Results match fftw's up to rounding error
+*/
+class PrunedIdct
+{
+public:
+    PrunedIdct(unsigned lengthX = 1, unsigned lengthY = 1, unsigned lengthZ = 1);
+    // Looks up the cosine tables, which are shared by every grid with the same lengths.
+    //  Has to be called once before anything is executed
+    void prepare();
+    // writes the plane at "position" across axis 0, 1 or 2 (x, y or z) of the transform of "in"
+    //  into the same voxels of "out", divided by normalization.  "scratch" needs scratchSize doubles
+    void executePlane(unsigned axis, unsigned position, const double* in, double* out,
+        double normalization, double* scratch) const;
+    double executeVoxel(unsigned x, unsigned y, unsigned z, const double* in) const;
+    // multiply-adds one executePlane across the axis takes
+    size_t planeCost(unsigned axis) const;
+    size_t scratchSize() const;
+private:
+    unsigned lengths[3];
+    // [mode][position] DCT-III matrix of each axis
+    const double* tables[3];
+};
\ No newline at end of file
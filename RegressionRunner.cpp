@@ -0,0 +1,531 @@
+#include "RegressionRunner.h"
+#include "toolbox.h"
+#include "SmallDct.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <utility>
+namespace
+{
+    const char GOLDEN_MAGIC[4] = { 'W', 'S', 'R', 'G' };
+    const uint32_t GOLDEN_VERSION = 1;
+    // a click forces one step, and its forcing reaches the modes the step after //
+    const size_t SOURCE_SETTLE_STEPS = 4;
+    // the most a lossless case's energy may drift for it to count as conserved //
+    const double CONSERVED_ENERGY_TOLERANCE = 1e-6;
+    // the matrix DCTs only differ from fftw by the order they add things up in //
+    const double SMALL_DCT_TOLERANCE = 1e-9;
+    // How far a probe in a room cut into partitions can get from the same room in one, for
+    //  interface stencils of order 2, 4 & 6.  These sit just above today's 0.343, 0.329 &
+    //  0.323, so they only guard against regressions: the error is dominated by the modal
+    //  wavenumbers being in voxels while the interface forcing is in metres, not by the
+    //  stencil.  With both in voxels it falls to about 0.2, & the orders no longer differ //
+    const double INTERFACE_TOLERANCES[] = { 0.35, 0.335, 0.33 };
+    // The step settile-live walls its pillar in at, once the click's wave has reached it.
+    //  The edit moves the energy by 3.5e-4 of the click's over that step where a step
+    //  without it moves it by 2.6e-4, & the wave crossing the small regions makes it
+    //  drift by 0.49 with or without the pillar //
+    const unsigned SET_TILE_STEP = 150;
+    const double SET_TILE_JUMP_TOLERANCE = 0.005;
+    const double SET_TILE_ENERGY_TOLERANCE = 0.75;
+    template<class T>
+    void writeValue(std::ostream& out, const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    template<class T>
+    bool readValue(std::istream& in, T& value)
+    {
+        return bool(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+    // pressure fields are stored as floats, since they're the bulk of a golden file
+    //  & float rounding is far below any sensible tolerance //
+    template<class Stored>
+    void writeArray(std::ostream& out, const std::vector<double>& values)
+    {
+        writeValue(out, uint64_t(values.size()));
+        for (double value : values)
+        {
+            writeValue(out, Stored(value));
+        }
+    }
+    template<class Stored>
+    bool readArray(std::istream& in, std::vector<double>& values)
+    {
+        uint64_t size;
+        if (!readValue(in, size))
+        {
+            return false;
+        }
+        std::vector<Stored> stored(static_cast<size_t>(size));
+        if (!in.read(reinterpret_cast<char*>(stored.data()), stored.size()*sizeof(Stored)))
+        {
+            return false;
+        }
+        values.assign(stored.begin(), stored.end());
+        return true;
+    }
+}
+RegressionRunner::RegressionRunner(int argc, char** argv)
+    :updateGoldens(false)
+    ,tolerance(1e-6)
+    ,energyTolerance(-1)
+{
+    // process our arg list //
+    for (int c = 1; c < argc; c++)
+    {
+        if (argv[c] == std::string("-regress") && c + 1 < argc)
+        {
+            goldenDirectory = argv[++c];
+        }
+        else if (argv[c] == std::string("-update"))
+        {
+            updateGoldens = true;
+        }
+        else if (argv[c] == std::string("-tolerance") && c + 1 < argc)
+        {
+            tolerance = std::stod(argv[++c]);
+        }
+        else if (argv[c] == std::string("-energytolerance") && c + 1 < argc)
+        {
+            energyTolerance = std::stod(argv[++c]);
+        }
+    }
+}
+int RegressionRunner::run()
+{
+    if (goldenDirectory.empty())
+    {
+        std::cerr << "ERROR: must specify the golden directory after \"-regress\", eg. assets/regress\n";
+        return EXIT_FAILURE;
+    }
+    size_t failedCases = 0;
+    for (const auto& testCase : cases())
+    {
+        Result result;
+        bool passed = runCase(testCase, result) && checkEnergy(testCase, result);
+        if (passed)
+        {
+            passed = updateGoldens ?
+                writeGolden(goldenDirectory + "/" + testCase.name + ".golden", result) :
+                compareWithGolden(testCase, result);
+        }
+        if (!passed)
+        {
+            failedCases++;
+        }
+        std::cout << "\tcase \"" << testCase.name << "\" " << (passed ? (updateGoldens ? "updated" : "passed") : "FAILED") << std::endl;
+    }
+    const std::vector<std::pair<std::string, bool (RegressionRunner::*)()>> checks = {
+        { "smalldct", &RegressionRunner::checkSmallDct },
+        { "interfaces", &RegressionRunner::checkInterfaces },
+        { "resting", &RegressionRunner::checkRestingGroups },
+        { "settile", &RegressionRunner::checkSetTile } };
+    for (const auto& check : checks)
+    {
+        const bool passed = (this->*check.second)();
+        if (!passed)
+        {
+            failedCases++;
+        }
+        std::cout << "\tcase \"" << check.first << "\" " << (passed ? "passed" : "FAILED") << std::endl;
+    }
+    std::cout << (failedCases == 0 ? "all cases passed" : std::to_string(failedCases) + " cases FAILED") << std::endl;
+    return failedCases == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+std::vector<RegressionRunner::Case> RegressionRunner::cases()
+{
+    // Energy tolerances are about 1.5 times the drift each case measures today: 0.015 for
+    //  map, 0.33 for regions, 8e-12 for room, 0.014 for box, a gain of 0.16 for materials
+    //  & 3e-4 for volume //
+    std::vector<Case> cases;
+    // the real map, in one region & in many small ones with cheaper stencils //
+    cases.push_back({ "map", "../map.json", false, 32, "final", { 6.2f, 6.5f, 0 },
+        { { 6.2f, 6.5f, 0 }, { 20, 8, 0 }, { 8, 9.5f, 0 }, { 22, 16, 0 }, { 15, 6, 0 } }, 400, true, 0.025 });
+    cases.push_back({ "regions", "../map.json", false, 8, "balanced", { 6.2f, 6.5f, 0 },
+        { { 6.2f, 6.5f, 0 }, { 20, 8, 0 }, { 8, 9.5f, 0 }, { 22, 16, 0 }, { 15, 6, 0 } }, 400, true, 0.5 });
+    // the same box without its pillar, one partition with nothing to lose energy through //
+    cases.push_back({ "room", "room.json", false, 32, "final", { 2.3f, 2.6f, 0 },
+        { { 2.3f, 2.6f, 0 }, { 7.5f, 5.5f, 0 }, { 5.2f, 1.4f, 0 } }, 400, true, 1e-9 });
+    // a walled box with a pillar, so a handful of partitions & interfaces //
+    cases.push_back({ "box", "box.json", false, 32, "final", { 2.3f, 2.6f, 0 },
+        { { 2.3f, 2.6f, 0 }, { 7.5f, 5.5f, 0 }, { 5.2f, 1.4f, 0 } }, 400, true, 0.025 });
+    // absorbing walls & a lossy curtain //
+    cases.push_back({ "materials", "materials.json", false, 32, "final", { 2.3f, 2.6f, 0 },
+        { { 2.3f, 2.6f, 0 }, { 9.5f, 5.5f, 0 }, { 6.2f, 1.4f, 0 } }, 400, false, 0.25 });
+    // a two storey volume with a hole in the floor between them //
+    cases.push_back({ "volume", "volume.json", true, 32, "final", { 1.6f, 1.6f, 0.5f },
+        { { 1.6f, 1.6f, 0.5f }, { 4.4f, 3.4f, 0.5f }, { 4.4f, 3.4f, 2.5f } }, 200, true, 5e-4 });
+    return cases;
+}
+bool RegressionRunner::runCase(const Case & testCase, Result & result, Map::PointSource::Type sourceType,
+    const std::vector<TileEdit>& tileEdits, bool skipRestingGroups)
+{
+    Map::LoadOptions options;
+    options.volumetric = testCase.volumetric;
+    options.regionTiles = testCase.regionTiles;
+    options.setQuality(testCase.quality);
+    Map map;
+    if (!map.load(goldenDirectory + "/" + testCase.mapFilename, options))
+    {
+        return false;
+    }
+    Map::Scenario scenario = map.createScenario();
+    scenario.prunePressures = true;
+    scenario.skipRestingGroups = skipRestingGroups;
+    Map::StateIndex stateIndex;
+    if (!map.findStateIndex(testCase.sourceLocation, stateIndex))
+    {
+        std::cerr << "ERROR: source of case \"" << testCase.name << "\" is outside the simulation\n";
+        return false;
+    }
+    // a pulse lasts its whole table however short it's asked to be //
+    scenario.pointSources.push_back({ map, stateIndex,
+        sourceType == Map::PointSource::Type::CLICK ? map.getSimDeltaTime() : 0, sourceType });
+    for (const auto& probeLocation : testCase.probeLocations)
+    {
+        if (!map.findStateIndex(probeLocation, stateIndex))
+        {
+            std::cerr << "ERROR: probe " << probeLocation << " of case \"" << testCase.name <<
+                "\" is outside the simulation\n";
+            return false;
+        }
+        scenario.probes.push_back(stateIndex);
+    }
+    for (unsigned s = 0; s < testCase.steps; s++)
+    {
+        for (const auto& edit : tileEdits)
+        {
+            if (edit.step == s && map.setTile(edit.column, edit.row, 0, edit.gid, { &scenario }) != edit.allowed)
+            {
+                std::cerr << "ERROR: case \"" << testCase.name << "\" expected tile " << edit.column << "," <<
+                    edit.row << " to be " << (edit.allowed ? "changed" : "refused") << " at step " << s << "\n";
+                map.releaseScenario(scenario);
+                return false;
+            }
+        }
+        map.streamScenario(scenario);
+        map.stepScenario(scenario);
+        result.energies.push_back(map.acousticEnergy(scenario));
+    }
+    for (const auto& probe : scenario.probes)
+    {
+        result.probePressures.push_back(probe.pressures);
+    }
+    map.completePressures(scenario);
+    result.pressureField = map.pressureField(scenario);
+    map.releaseScenario(scenario);
+    return true;
+}
+bool RegressionRunner::checkEnergy(const Case & testCase, const Result & result) const
+{
+    if (result.energies.size() <= SOURCE_SETTLE_STEPS)
+    {
+        return true;
+    }
+    const double tolerance = energyTolerance < 0 ? testCase.energyTolerance : energyTolerance;
+    const double referenceEnergy = result.energies[SOURCE_SETTLE_STEPS];
+    if (!(referenceEnergy > 0))
+    {
+        std::cerr << "ERROR: case \"" << testCase.name << "\" has no energy after its click\n";
+        return false;
+    }
+    // Lossless maps have to hold on to what the click put in, lossy ones can only lose it.
+    //  A single partition's modal update is exact, so it only rounds, but interfaces don't
+    //  conserve energy exactly: it wanders by a few percent in one region & by tens of
+    //  percent as a wavefront crosses lots of small ones.  An unstable step grows it without bound //
+    double worstDrift = 0;
+    size_t worstStep = SOURCE_SETTLE_STEPS;
+    for (size_t s = SOURCE_SETTLE_STEPS + 1; s < result.energies.size(); s++)
+    {
+        const double gain = (result.energies[s] - referenceEnergy) / referenceEnergy;
+        const double drift = testCase.lossless ? fabs(gain) : gain;
+        if (!(drift <= worstDrift))
+        {
+            worstDrift = _isnan(drift) ? std::numeric_limits<double>::infinity() : drift;
+            worstStep = s;
+        }
+    }
+    // only a tolerance down at rounding says the energy is conserved, rather than bounded //
+    const char* verdict = !testCase.lossless ? "lossy" :
+        tolerance <= CONSERVED_ENERGY_TOLERANCE ? "conserved" : "bounded";
+    std::cout << "\tcase \"" << testCase.name << "\" energy " << verdict << ": " <<
+        (testCase.lossless ? "drift" : "gain") << "=" << worstDrift << " within " << tolerance <<
+        " at step " << worstStep << std::endl;
+    if (!(worstDrift <= tolerance))
+    {
+        std::cerr << "ERROR: case \"" << testCase.name << "\" energy " << (testCase.lossless ? "drifted" : "grew") <<
+            " by " << worstDrift << " of the click's at step " << worstStep << "\n";
+        return false;
+    }
+    return true;
+}
+bool RegressionRunner::compareWithGolden(const Case & testCase, const Result & result) const
+{
+    Result golden;
+    if (!readGolden(goldenDirectory + "/" + testCase.name + ".golden", golden))
+    {
+        return false;
+    }
+    bool passed = true;
+    auto check = [&](const std::string& what, const std::vector<double>& values, const std::vector<double>& goldenValues)
+    {
+        const double error = relativeError(values, goldenValues);
+        if (error > tolerance)
+        {
+            std::cerr << "ERROR: case \"" << testCase.name << "\" " << what << " is off by " << error <<
+                " of its golden peak\n";
+            passed = false;
+        }
+    };
+    if (golden.probePressures.size() != result.probePressures.size())
+    {
+        std::cerr << "ERROR: case \"" << testCase.name << "\" has " << result.probePressures.size() <<
+            " probes, but its golden has " << golden.probePressures.size() << "\n";
+        return false;
+    }
+    for (size_t p = 0; p < result.probePressures.size(); p++)
+    {
+        check("probe" + std::to_string(p), result.probePressures[p], golden.probePressures[p]);
+    }
+    check("energy", result.energies, golden.energies);
+    check("pressure field", result.pressureField, golden.pressureField);
+    return passed;
+}
+bool RegressionRunner::readGolden(const std::string & filename, Result & golden)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "ERROR: could not open \"" << filename << "\", run with -update to make it\n";
+        return false;
+    }
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t probeCount = 0;
+    if (!file.read(magic, sizeof(magic)) || memcmp(magic, GOLDEN_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(file, version) || version != GOLDEN_VERSION || !readValue(file, probeCount))
+    {
+        std::cerr << "ERROR: \"" << filename << "\" is not a version " << GOLDEN_VERSION << " golden file\n";
+        return false;
+    }
+    golden.probePressures.resize(probeCount);
+    bool success = true;
+    for (auto& probe : golden.probePressures)
+    {
+        success = success && readArray<double>(file, probe);
+    }
+    success = success && readArray<double>(file, golden.energies) && readArray<float>(file, golden.pressureField);
+    if (!success)
+    {
+        std::cerr << "ERROR: \"" << filename << "\" is truncated\n";
+    }
+    return success;
+}
+bool RegressionRunner::writeGolden(const std::string & filename, const Result & result)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "ERROR: could not open \"" << filename << "\"\n";
+        return false;
+    }
+    file.write(GOLDEN_MAGIC, sizeof(GOLDEN_MAGIC));
+    writeValue(file, GOLDEN_VERSION);
+    writeValue(file, uint32_t(result.probePressures.size()));
+    for (const auto& probe : result.probePressures)
+    {
+        writeArray<double>(file, probe);
+    }
+    writeArray<double>(file, result.energies);
+    writeArray<float>(file, result.pressureField);
+    if (!file)
+    {
+        std::cerr << "ERROR: could not write \"" << filename << "\"\n";
+        return false;
+    }
+    return true;
+}
+bool RegressionRunner::checkSmallDct()
+{
+    double worstError = 0;
+    unsigned worstLengthX = 1;
+    unsigned worstLengthY = 1;
+    for (unsigned lengthY = 1; lengthY <= SmallDct::MAX_LENGTH; lengthY++)
+    {
+        for (unsigned lengthX = 1; lengthX <= SmallDct::MAX_LENGTH; lengthX++)
+        {
+            const double error = SmallDct::maxErrorVersusFftw(lengthX, lengthY);
+            if (!(error <= worstError))
+            {
+                worstError = _isnan(error) ? std::numeric_limits<double>::infinity() : error;
+                worstLengthX = lengthX;
+                worstLengthY = lengthY;
+            }
+        }
+    }
+    std::cout << "\tcase \"smalldct\" error=" << worstError << " at " << worstLengthX << "x" << worstLengthY << std::endl;
+    if (worstError > SMALL_DCT_TOLERANCE)
+    {
+        std::cerr << "ERROR: the " << worstLengthX << "x" << worstLengthY << " matrix DCT is off fftw's by " <<
+            worstError << "\n";
+        return false;
+    }
+    return true;
+}
+bool RegressionRunner::checkInterfaces()
+{
+    // The same empty room as one partition, & cut in four by small regions, heard just across
+    //  the interface from the pulse.  Each preset's stencil order has to stay within its own
+    //  tolerance & no further from the single partition than the order below it, which
+    //  guards against regressions rather than showing the orders converge //
+    const std::string qualities[] = { "preview", "balanced", "final" };
+    bool passed = true;
+    double previousError = std::numeric_limits<double>::infinity();
+    for (size_t q = 0; q < 3; q++)
+    {
+        Case testCase = { "interfaces", "room.json", false, 32, qualities[q], { 2.3f, 2.6f, 0 },
+            { { 5.2f, 1.4f, 0 } }, 400, true, 0.5 };
+        Result reference;
+        Result partitioned;
+        if (!runCase(testCase, reference, Map::PointSource::Type::GAUSIAN_PULSE))
+        {
+            return false;
+        }
+        testCase.regionTiles = 5;
+        if (!runCase(testCase, partitioned, Map::PointSource::Type::GAUSIAN_PULSE))
+        {
+            return false;
+        }
+        const unsigned stencilOrder = unsigned(2 * (q + 1));
+        const double error = relativeError(partitioned.probePressures[0], reference.probePressures[0]);
+        std::cout << "\tcase \"interfaces\" order " << stencilOrder << " error=" << error << std::endl;
+        if (!(error <= INTERFACE_TOLERANCES[q]) || !(error < previousError))
+        {
+            std::cerr << "ERROR: order " << stencilOrder << " interfaces are off a single partition by " <<
+                error << " of its peak, where they have to be within " << INTERFACE_TOLERANCES[q] <<
+                " & better than the order below's " << previousError << "\n";
+            passed = false;
+        }
+        previousError = error;
+    }
+    return passed;
+}
+bool RegressionRunner::checkRestingGroups()
+{
+    // Groups no wave has reached yet are all zeros, so skipping their transforms has to
+    //  leave every probe, energy & pressure exactly where stepping them puts it //
+    const Case testCase = { "resting", "../map.json", false, 8, "balanced", { 6.2f, 6.5f, 0 },
+        { { 6.2f, 6.5f, 0 }, { 20, 8, 0 }, { 8, 9.5f, 0 }, { 22, 16, 0 }, { 15, 6, 0 } }, 400, true, 0.5 };
+    Result skipped;
+    Result stepped;
+    if (!runCase(testCase, skipped) ||
+        !runCase(testCase, stepped, Map::PointSource::Type::CLICK, std::vector<TileEdit>(), false))
+    {
+        return false;
+    }
+    double worstError = std::max(relativeError(skipped.pressureField, stepped.pressureField),
+        relativeError(skipped.energies, stepped.energies));
+    for (size_t p = 0; p < stepped.probePressures.size(); p++)
+    {
+        worstError = std::max(worstError, relativeError(skipped.probePressures[p], stepped.probePressures[p]));
+    }
+    std::cout << "\tcase \"resting\" error=" << worstError << std::endl;
+    if (!(worstError <= tolerance))
+    {
+        std::cerr << "ERROR: skipping resting groups is off stepping them by " << worstError << " of the peak\n";
+        return false;
+    }
+    return true;
+}
+bool RegressionRunner::checkSetTile()
+{
+    // box.json is room.json with a 2x2 pillar, which the edit puts back once the room is
+    //  streamed in, so both have to come out of the same decomposition & step the same //
+    std::vector<TileEdit> pillar = { { 0, 5, 3, 1, true }, { 0, 6, 3, 1, true },
+        { 0, 5, 4, 1, true }, { 0, 6, 4, 1, true } };
+    Case testCase = { "settile", "box.json", false, 32, "final", { 2.3f, 2.6f, 0 },
+        { { 2.3f, 2.6f, 0 }, { 7.5f, 5.5f, 0 }, { 5.2f, 1.4f, 0 } }, 400, true, 0.025 };
+    Result loaded;
+    Result edited;
+    if (!runCase(testCase, loaded))
+    {
+        return false;
+    }
+    testCase.mapFilename = "room.json";
+    if (!runCase(testCase, edited, Map::PointSource::Type::CLICK, pillar))
+    {
+        return false;
+    }
+    double worstError = relativeError(edited.pressureField, loaded.pressureField);
+    for (size_t p = 0; p < loaded.probePressures.size(); p++)
+    {
+        worstError = std::max(worstError, relativeError(edited.probePressures[p], loaded.probePressures[p]));
+    }
+    std::cout << "\tcase \"settile\" error=" << worstError << std::endl;
+    if (!(worstError <= tolerance))
+    {
+        std::cerr << "ERROR: the room with its pillar put back is off the box as loaded by " <<
+            worstError << " of its peak\n";
+        return false;
+    }
+    // The same pillar walled in across four small regions as the click's wave crosses them,
+    //  with the probes in others.  Whatever the wave had in the pillar is lost, but nothing
+    //  else may jump, & a wall over a probe has to be refused //
+    for (auto& edit : pillar)
+    {
+        edit.step = SET_TILE_STEP;
+    }
+    pillar.push_back({ SET_TILE_STEP, 7, 2, 1, false });
+    testCase.name = "settile-live";
+    testCase.regionTiles = 4;
+    testCase.energyTolerance = SET_TILE_ENERGY_TOLERANCE;
+    Result live;
+    if (!runCase(testCase, live, Map::PointSource::Type::CLICK, pillar) || !checkEnergy(testCase, live))
+    {
+        return false;
+    }
+    const double jump = fabs(live.energies[SET_TILE_STEP] - live.energies[SET_TILE_STEP - 1]) /
+        live.energies[SOURCE_SETTLE_STEPS];
+    std::cout << "\tcase \"settile-live\" energy jump=" << jump << " at step " << SET_TILE_STEP << std::endl;
+    if (!(jump <= SET_TILE_JUMP_TOLERANCE))
+    {
+        std::cerr << "ERROR: walling in the pillar moved the energy by " << jump << " of the click's\n";
+        return false;
+    }
+    for (const auto& pressures : live.probePressures)
+    {
+        for (double pressure : pressures)
+        {
+            if (!(fabs(pressure) < std::numeric_limits<double>::infinity()))
+            {
+                std::cerr << "ERROR: a probe heard " << pressure << " after the pillar was walled in\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+double RegressionRunner::relativeError(const std::vector<double>& values, const std::vector<double>& golden)
+{
+    if (values.size() != golden.size())
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    double peak = 0;
+    double largestDifference = 0;
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        if (_isnan(values[i]))
+        {
+            return std::numeric_limits<double>::infinity();
+        }
+        peak = std::max(peak, fabs(golden[i]));
+        largestDifference = std::max(largestDifference, fabs(values[i] - golden[i]));
+    }
+    return peak > 0 ? largestDifference / peak : largestDifference;
+}
\ No newline at end of file
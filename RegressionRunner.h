@@ -0,0 +1,83 @@
+#pragma once
+#include "Map.h"
+#include <string>
+#include <vector>
+/*
+    Headless regression check: steps a fixed set of scenarios on assets/map.json & the
+    small synthetic maps next to the golden files, then compares every probe trace,
+    the final pressure field & the per-step energy against the goldens within a tolerance.
+    Every step's energy is checked too: lossless scenarios must hold on to what their
+    click put in, & lossy ones must never gain more than the energy tolerance.
+    Then runs the checks which judge themselves instead of going by a golden
+*/
+class RegressionRunner
+{
+private:
+    struct Case
+    {
+        std::string name;
+        std::string mapFilename;
+        bool volumetric;
+        unsigned regionTiles;
+        std::string quality;
+        sf::Vector3f sourceLocation;
+        std::vector<sf::Vector3f> probeLocations;
+        unsigned steps;
+        // rigid walls & air only, so nothing should take energy away
+        bool lossless;
+        // how far a lossless case's energy may wander from what its click put in,
+        //  or how far a lossy one's may rise above it
+        double energyTolerance;
+    };
+    // a tile changed through Map::setTile just before a step
+    struct TileEdit
+    {
+        unsigned step;
+        unsigned column;
+        unsigned row;
+        uint16_t gid;
+        // false if setTile has to refuse it, like a wall over a probe
+        bool allowed;
+    };
+    // everything a case produces which gets compared against its golden file
+    struct Result
+    {
+        std::vector<std::vector<double>> probePressures;
+        std::vector<double> energies;
+        std::vector<double> pressureField;
+    };
+public:
+    RegressionRunner(int argc, char** argv);
+    // returns EXIT_SUCCESS only if every case matched its golden & passed its energy check
+    int run();
+private:
+    static std::vector<Case> cases();
+    // the edits go to the first layer, with every region the case has streamed in resident
+    bool runCase(const Case& testCase, Result& result,
+        Map::PointSource::Type sourceType = Map::PointSource::Type::CLICK,
+        const std::vector<TileEdit>& tileEdits = std::vector<TileEdit>(),
+        bool skipRestingGroups = true);
+    bool checkEnergy(const Case& testCase, const Result& result) const;
+    bool compareWithGolden(const Case& testCase, const Result& result) const;
+    static bool readGolden(const std::string& filename, Result& golden);
+    static bool writeGolden(const std::string& filename, const Result& result);
+    // largest difference relative to the golden's peak magnitude; infinite if the sizes
+    //  differ or anything isn't a number
+    static double relativeError(const std::vector<double>& values, const std::vector<double>& golden);
+    // every size of matrix DCT against fftw's //
+    bool checkSmallDct();
+    // every stencil order's interfaces against a room simulated as a single partition //
+    bool checkInterfaces();
+    // the map in small regions with every group stepped against the same with resting ones skipped //
+    bool checkRestingGroups();
+    // a room walled into the box through setTile against the box loaded as it is,
+    //  & a pillar walled into small regions while a wave crosses them //
+    bool checkSetTile();
+private:
+    std::string goldenDirectory;
+    // writes the goldens from this build instead of checking against them
+    bool updateGoldens;
+    double tolerance;
+    // overrides every case's own energy tolerance, once it's given
+    double energyTolerance;
+};
\ No newline at end of file
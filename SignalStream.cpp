@@ -0,0 +1,179 @@
+#include "SignalStream.h"
+#include "toolbox.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+namespace
+{
+    // steps buffered ahead of the solver, a power of 2 (~9 seconds at the default resolution) //
+    const size_t RING_SIZE = size_t(1) << 16;
+    const size_t BLOCK_FRAMES = 4096;
+    // the resampling filter spans this many of its zero crossings either side of each step,
+    //  and is tabulated at this many points between each of them
+    const unsigned ZERO_CROSSINGS = 16;
+    const unsigned KERNEL_RESOLUTION = 512;
+    // in case the solver's wake-up gets missed, the loader checks back this often anyway
+    const unsigned WAKE_MILLISECONDS = 10;
+    // Blackman-windowed sinc, u measured in zero crossings from the centre
+    std::vector<float> buildKernel()
+    {
+        std::vector<float> kernel(ZERO_CROSSINGS*KERNEL_RESOLUTION + 2, 0.f);
+        for (size_t i = 0; i <= ZERO_CROSSINGS*KERNEL_RESOLUTION; i++)
+        {
+            const double u = double(i) / KERNEL_RESOLUTION;
+            const double sinc = i == 0 ? 1.0 : sin(PI*u) / (PI*u);
+            const double w = u / ZERO_CROSSINGS;
+            kernel[i] = float(sinc*(0.42 + 0.5*cos(PI*w) + 0.08*cos(2 * PI*w)));
+        }
+        return kernel;
+    }
+    float sampleKernel(double u)
+    {
+        static const std::vector<float> kernel = buildKernel();
+        const double position = fabs(u)*KERNEL_RESOLUTION;
+        const size_t i = size_t(position);
+        if (i >= ZERO_CROSSINGS*KERNEL_RESOLUTION)
+        {
+            return 0.f;
+        }
+        const float t = float(position - i);
+        return kernel[i] + t*(kernel[i + 1] - kernel[i]);
+    }
+}
+SignalStream::SignalStream()
+    :inputStart(0)
+    ,inputEnded(false)
+    ,inputStep(1)
+    ,cutoff(0.5)
+    ,stepCount(0)
+    ,resampled(0)
+    ,underruns(0)
+    ,writePosition(0)
+    ,readPosition(0)
+    ,stopping(false)
+{
+}
+SignalStream::~SignalStream()
+{
+    stopping = true;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wake.notify_all();
+    if (loader.joinable())
+    {
+        loader.join();
+    }
+}
+bool SignalStream::open(const std::string & wavFilename, double stepSeconds, double cutoffHz)
+{
+    if (!reader.open(wavFilename))
+    {
+        return false;
+    }
+    inputStep = reader.sampleRate*stepSeconds;
+    // stay clear of both Nyquist limits, whichever way the rate goes //
+    cutoff = std::min({ cutoffHz, 0.45 / stepSeconds, 0.45*reader.sampleRate }) / reader.sampleRate;
+    stepCount = size_t(ceil(reader.frameCount / inputStep));
+    ring.assign(RING_SIZE, 0.f);
+    if (fill())
+    {
+        loader = std::thread(&SignalStream::load, this);
+    }
+    return true;
+}
+float SignalStream::next()
+{
+    const size_t read = readPosition.load(std::memory_order_relaxed);
+    if (read >= stepCount)
+    {
+        return 0.f;
+    }
+    // never wait for the loader: the rest of the signal just comes a step late //
+    if (read == writePosition.load(std::memory_order_acquire))
+    {
+        underruns++;
+        return 0.f;
+    }
+    const float sample = ring[read & (RING_SIZE - 1)];
+    readPosition.store(read + 1, std::memory_order_release);
+    if (((read + 1) & (RING_SIZE / 2 - 1)) == 0)
+    {
+        wake.notify_one();
+    }
+    return sample;
+}
+size_t SignalStream::getStepCount() const
+{
+    return stepCount;
+}
+size_t SignalStream::getUnderruns() const
+{
+    return underruns;
+}
+bool SignalStream::fill()
+{
+    const double halfWidth = ZERO_CROSSINGS / (2 * cutoff);
+    const size_t read = readPosition.load(std::memory_order_acquire);
+    size_t write = writePosition.load(std::memory_order_relaxed);
+    std::vector<std::vector<float>> channels(reader.channelCount);
+    while (resampled < stepCount && write - read < RING_SIZE && !stopping)
+    {
+        const double centre = resampled*inputStep;
+        const size_t first = size_t(std::max(0.0, ceil(centre - halfWidth)));
+        const size_t last = size_t(floor(centre + halfWidth));
+        // decode until the filter's whole span is in, or the file runs out //
+        while (!inputEnded && inputStart + input.size() <= last)
+        {
+            for (auto& channel : channels)
+            {
+                channel.clear();
+            }
+            const size_t frames = reader.read(BLOCK_FRAMES, channels);
+            inputEnded = frames == 0;
+            const size_t start = input.size();
+            input.resize(start + frames, 0.f);
+            for (const auto& channel : channels)
+            {
+                for (size_t f = 0; f < frames; f++)
+                {
+                    input[start + f] += channel[f] / reader.channelCount;
+                }
+            }
+        }
+        // let go of the frames no later step reaches back to, a block at a time //
+        if (first > inputStart + BLOCK_FRAMES)
+        {
+            input.erase(input.begin(), input.begin() + (first - inputStart));
+            inputStart = first;
+        }
+        double sample = 0;
+        const size_t end = std::min(last + 1, inputStart + input.size());
+        for (size_t k = std::max(first, inputStart); k < end; k++)
+        {
+            sample += input[k - inputStart] * sampleKernel(2 * cutoff*(k - centre));
+        }
+        ring[write & (RING_SIZE - 1)] = float(2 * cutoff*sample);
+        write++;
+        resampled++;
+        // hand the solver what's ready now & then, rather than only once the ring is full //
+        if ((write & (BLOCK_FRAMES - 1)) == 0)
+        {
+            writePosition.store(write, std::memory_order_release);
+        }
+    }
+    writePosition.store(write, std::memory_order_release);
+    return resampled < stepCount;
+}
+void SignalStream::load()
+{
+    while (!stopping && fill())
+    {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait_for(lock, std::chrono::milliseconds(WAKE_MILLISECONDS), [this]()->bool
+        {
+            return stopping || writePosition.load() - readPosition.load() <= RING_SIZE / 2;
+        });
+    }
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+#include "WavFile.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+/*
+    A WAV file played into the simulation as a point source's signal.
+    Its own loader thread decodes the file a block at a time, mixes it down to mono
+    & resamples it to the simulation's step rate into a ring buffer ahead of the solver,
+    which takes one sample per step without ever waiting on it:
+    a step the loader hasn't caught up to yet just gets silence
+*/
+class SignalStream
+{
+public:
+    SignalStream();
+    ~SignalStream();
+    SignalStream(const SignalStream&) = delete;
+    SignalStream& operator=(const SignalStream&) = delete;
+    // Resamples to one sample every stepSeconds, band-limited to cutoffHz.
+    //  The ring is filled before this returns, so signals which fit in it never underrun.
+    //  Returns false, having said why, if the file can't be read
+    bool open(const std::string& wavFilename, double stepSeconds, double cutoffHz);
+    // the next step's sample, 0 once the signal is over.  Only ever call this from one thread
+    float next();
+    // how many steps the whole signal lasts
+    size_t getStepCount() const;
+    // how many steps got silence because the loader had fallen behind
+    size_t getUnderruns() const;
+private:
+    // resamples until the ring is full, returning false once the whole signal is in it
+    bool fill();
+    void load();
+private:
+    WavReader reader;
+    // the file's frames mixed down to mono, from the frame inputStart onwards
+    std::vector<float> input;
+    size_t inputStart;
+    bool inputEnded;
+    // input frames per step, & the resampling filter's cutoff in cycles per input frame
+    double inputStep;
+    double cutoff;
+    size_t stepCount;
+    size_t resampled;
+    size_t underruns;
+    std::vector<float> ring;
+    std::atomic<size_t> writePosition;
+    std::atomic<size_t> readPosition;
+    std::atomic<bool> stopping;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::thread loader;
+};
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "SmallDct.h"
+#include "toolbox.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <emmintrin.h>
+#include <vector>
+namespace
+{
+    // Both matrices are stored input-index major, so each pass of the 2D
+    //  transform is a series of row axpys that vectorize across the row //
+    template<unsigned N>
+    struct SmallDctMatrices
+    {
+        SmallDctMatrices()
+        {
+            for (unsigned j = 0; j < N; j++)
+            {
+                for (unsigned k = 0; k < N; k++)
+                {
+                    dct2[j*N + k] = 2 * cos(PI*(j + 0.5)*k / N);
+                    dct3[j*N + k] = j == 0 ? 1.0 : 2 * cos(PI*j*(k + 0.5) / N);
+                }
+            }
+        }
+        static const SmallDctMatrices& get()
+        {
+            static const SmallDctMatrices matrices;
+            return matrices;
+        }
+        double dct2[N*N];
+        double dct3[N*N];
+    };
+    // y += a*x, for a row of compile-time length //
+    template<unsigned N>
+    inline void axpy(double a, const double* x, double* y)
+    {
+        const __m128d va = _mm_set1_pd(a);
+        for (unsigned i = 0; i + 2 <= N; i += 2)
+        {
+            _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i),
+                _mm_mul_pd(va, _mm_loadu_pd(x + i))));
+        }
+        if (N % 2)
+        {
+            y[N - 1] += a*x[N - 1];
+        }
+    }
+    // lengthX is a template parameter since it is the vectorized row length,
+    //  lengthY only changes the trip count //
+    template<unsigned NX>
+    void transform2d(const double* matrixX, const double* matrixY, unsigned lengthY,
+        const double* in, double* out)
+    {
+        double rows[SmallDct::MAX_LENGTH*SmallDct::MAX_LENGTH];
+        // transform along X into a scratch buffer, so "in" is fully consumed
+        //  before anything is written to "out" //
+        for (unsigned y = 0; y < lengthY; y++)
+        {
+            double* row = rows + y*NX;
+            std::fill(row, row + NX, 0.0);
+            for (unsigned j = 0; j < NX; j++)
+            {
+                axpy<NX>(in[y*NX + j], matrixX + j*NX, row);
+            }
+        }
+        // then along Y, accumulating whole rows at a time //
+        for (unsigned k = 0; k < lengthY; k++)
+        {
+            double* outRow = out + k*NX;
+            std::fill(outRow, outRow + NX, 0.0);
+            for (unsigned j = 0; j < lengthY; j++)
+            {
+                axpy<NX>(matrixY[j*lengthY + k], rows + j*NX, outRow);
+            }
+        }
+    }
+    typedef void(*Transform2d)(const double*, const double*, unsigned, const double*, double*);
+    struct SmallDctSize
+    {
+        const double* dct2;
+        const double* dct3;
+        Transform2d transform;
+    };
+    template<unsigned N>
+    SmallDctSize smallDctSize()
+    {
+        return { SmallDctMatrices<N>::get().dct2, SmallDctMatrices<N>::get().dct3, &transform2d<N> };
+    }
+    const SmallDctSize& getSmallDctSize(unsigned length)
+    {
+        static const SmallDctSize SIZES[SmallDct::MAX_LENGTH] = {
+            smallDctSize<1>(),  smallDctSize<2>(),  smallDctSize<3>(),  smallDctSize<4>(),
+            smallDctSize<5>(),  smallDctSize<6>(),  smallDctSize<7>(),  smallDctSize<8>(),
+            smallDctSize<9>(),  smallDctSize<10>(), smallDctSize<11>(), smallDctSize<12>(),
+            smallDctSize<13>(), smallDctSize<14>(), smallDctSize<15>(), smallDctSize<16>()
+        };
+        return SIZES[length - 1];
+    }
+}
+bool SmallDct::supports(unsigned lengthX, unsigned lengthY)
+{
+    return lengthX > 0 && lengthX <= MAX_LENGTH &&
+        lengthY > 0 && lengthY <= MAX_LENGTH;
+}
+void SmallDct::execute(fftw_r2r_kind kind, unsigned lengthX, unsigned lengthY,
+    size_t count, size_t stride, const double* in, double* out)
+{
+    assert(supports(lengthX, lengthY));
+    assert(kind == FFTW_REDFT10 || kind == FFTW_REDFT01);
+    const SmallDctSize& sizeX = getSmallDctSize(lengthX);
+    const SmallDctSize& sizeY = getSmallDctSize(lengthY);
+    const double* matrixX = kind == FFTW_REDFT10 ? sizeX.dct2 : sizeX.dct3;
+    const double* matrixY = kind == FFTW_REDFT10 ? sizeY.dct2 : sizeY.dct3;
+    for (size_t c = 0; c < count; c++)
+    {
+        sizeX.transform(matrixX, matrixY, lengthY, in + c*stride, out + c*stride);
+    }
+}
+double SmallDct::maxErrorVersusFftw(unsigned lengthX, unsigned lengthY)
+{
+    const size_t gridSize = lengthX*lengthY;
+    double* input = static_cast<double*>(fftw_malloc(sizeof(double)*gridSize));
+    double* expected = static_cast<double*>(fftw_malloc(sizeof(double)*gridSize));
+    std::vector<double> actual(gridSize);
+    double maxError = 0;
+    for (fftw_r2r_kind kind : { FFTW_REDFT10, FFTW_REDFT01 })
+    {
+        fftw_plan plan = fftw_plan_r2r_2d(lengthY, lengthX, input, expected,
+            kind, kind, FFTW_ESTIMATE);
+        for (size_t i = 0; i < gridSize; i++)
+        {
+            input[i] = sin(1.0 + 7.0*i);
+        }
+        fftw_execute(plan);
+        execute(kind, lengthX, lengthY, 1, gridSize, input, actual.data());
+        for (size_t i = 0; i < gridSize; i++)
+        {
+            maxError = std::max(maxError, std::abs(actual[i] - expected[i]));
+        }
+        fftw_destroy_plan(plan);
+    }
+    fftw_free(input);
+    fftw_free(expected);
+    return maxError;
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+#include <fftw3.h>
+/*
+    Precomputed matrix DCTs for partitions so small that fftw's per-call
+    overhead costs more than the arithmetic.  Results match fftw's unnormalized
+    FFTW_REDFT10 (DCT-II) & FFTW_REDFT01 (DCT-III) up to rounding error.
+*/
+class SmallDct
+{
+public:
+    static const unsigned MAX_LENGTH = 16;
+    static bool supports(unsigned lengthX, unsigned lengthY);
+    // transforms "count" row-major lengthY*lengthX arrays placed "stride" apart.
+    //  "in" & "out" may be the same array
+    static void execute(fftw_r2r_kind kind, unsigned lengthX, unsigned lengthY,
+        size_t count, size_t stride, const double* in, double* out);
+    // largest absolute difference from fftw over both transform kinds
+    static double maxErrorVersusFftw(unsigned lengthX, unsigned lengthY);
+};
\ No newline at end of file
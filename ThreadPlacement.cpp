@@ -0,0 +1,137 @@
+#include "ThreadPlacement.h"
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#ifdef USE_NUMA
+#include <numa.h>
+#include <numaif.h>
+#endif
+#endif
+unsigned ThreadPlacement::nodeCount()
+{
+    const unsigned cpuCount = std::max(1u, std::thread::hardware_concurrency());
+    int maxNode = 0;
+    for (unsigned cpu = 0; cpu < cpuCount; cpu++)
+    {
+        maxNode = std::max(maxNode, nodeOfCpu(cpu));
+    }
+    return unsigned(maxNode) + 1;
+}
+unsigned ThreadPlacement::cpuForWorker(unsigned workerIndex)
+{
+    const std::vector<unsigned>& cpus = cpusInWorkerOrder();
+    return cpus[workerIndex % cpus.size()];
+}
+bool ThreadPlacement::pinCurrentThread(unsigned cpu)
+{
+#ifdef _WIN32
+    if (cpu >= sizeof(DWORD_PTR) * 8)
+    {
+        return false;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#else
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#endif
+}
+int ThreadPlacement::nodeOfCpu(unsigned cpu)
+{
+#ifdef _WIN32
+    UCHAR node = 0;
+    if (cpu > 0xFF || !GetNumaProcessorNode(UCHAR(cpu), &node) || node == 0xFF)
+    {
+        return 0;
+    }
+    return int(node);
+#elif defined(USE_NUMA)
+    if (numa_available() < 0)
+    {
+        return 0;
+    }
+    return std::max(0, numa_node_of_cpu(int(cpu)));
+#else
+    (void)cpu;
+    return 0;
+#endif
+}
+int ThreadPlacement::nodeOfAddress(const void* address)
+{
+#ifdef _WIN32
+    PSAPI_WORKING_SET_EX_INFORMATION info;
+    info.VirtualAddress = const_cast<void*>(address);
+    if (!QueryWorkingSetEx(GetCurrentProcess(), &info, sizeof(info)) || !info.VirtualAttributes.Valid)
+    {
+        return -1;
+    }
+    return int(info.VirtualAttributes.Node);
+#elif defined(USE_NUMA)
+    if (numa_available() < 0)
+    {
+        return -1;
+    }
+    // asking move_pages to move nowhere just reports where each page is //
+    void* page = reinterpret_cast<void*>(uintptr_t(address) & ~uintptr_t(pageSize() - 1));
+    int status = -1;
+    if (move_pages(0, 1, &page, nullptr, &status, 0) != 0)
+    {
+        return -1;
+    }
+    return status >= 0 ? status : -1;
+#else
+    (void)address;
+    return -1;
+#endif
+}
+size_t ThreadPlacement::pageSize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return size_t(systemInfo.dwPageSize);
+#else
+    return size_t(sysconf(_SC_PAGESIZE));
+#endif
+}
+const std::vector<unsigned>& ThreadPlacement::cpusInWorkerOrder()
+{
+    static const std::vector<unsigned> cpus = []()->std::vector<unsigned>
+    {
+        // bucket the cpus by node, then deal them out one node at a time //
+        const unsigned cpuCount = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::vector<unsigned>> nodeCpus;
+        for (unsigned cpu = 0; cpu < cpuCount; cpu++)
+        {
+            const unsigned node = unsigned(nodeOfCpu(cpu));
+            if (node >= nodeCpus.size())
+            {
+                nodeCpus.resize(node + 1);
+            }
+            nodeCpus[node].push_back(cpu);
+        }
+        std::vector<unsigned> ordered;
+        for (size_t i = 0; ordered.size() < cpuCount; i++)
+        {
+            for (const auto& cpusOfNode : nodeCpus)
+            {
+                if (i < cpusOfNode.size())
+                {
+                    ordered.push_back(cpusOfNode[i]);
+                }
+            }
+        }
+        return ordered;
+    }();
+    return cpus;
+}
\ No newline at end of file
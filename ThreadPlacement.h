@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+/*
+    Pins worker threads to cores spread evenly over the machine's NUMA nodes,
+    and reports which node memory actually landed on.  Memory goes to the node
+    of whichever thread first touches it, so a pinned worker which allocates &
+    zeroes its own state keeps it local.  Node queries on linux need a build
+    with USE_NUMA (libnuma); without it every cpu reads as node 0
+*/
+class ThreadPlacement
+{
+public:
+    static unsigned nodeCount();
+    // the cpu worker "workerIndex" should run on.  Consecutive workers
+    //  alternate between nodes, so every node's memory controller gets used
+    static unsigned cpuForWorker(unsigned workerIndex);
+    // returns false if the OS refused
+    static bool pinCurrentThread(unsigned cpu);
+    static int nodeOfCpu(unsigned cpu);
+    // -1 if the page hasn't been touched yet, or it can't be told
+    static int nodeOfAddress(const void* address);
+    static size_t pageSize();
+private:
+    static const std::vector<unsigned>& cpusInWorkerOrder();
+};
\ No newline at end of file
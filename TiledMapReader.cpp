@@ -0,0 +1,482 @@
+#include "TiledMapReader.h"
+#include <nlohmann\json.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+namespace
+{
+    // Tiled keeps horizontal/vertical/diagonal flips in the top bits of each id //
+    const uint32_t TILED_GID_MASK = 0x1FFFFFFF;
+    bool decodeBase64(const std::string& text, std::vector<uint8_t>& outBytes)
+    {
+        outBytes.clear();
+        outBytes.reserve(text.size() / 4 * 3);
+        uint32_t bits = 0;
+        unsigned bitCount = 0;
+        for (const char c : text)
+        {
+            int value;
+            if (c >= 'A' && c <= 'Z') value = c - 'A';
+            else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') value = c - '0' + 52;
+            else if (c == '+') value = 62;
+            else if (c == '/') value = 63;
+            else if (c == '=' || c == '\n' || c == '\r' || c == ' ') continue;
+            else return false;
+            bits = (bits << 6) | uint32_t(value);
+            bitCount += 6;
+            if (bitCount >= 8)
+            {
+                bitCount -= 8;
+                outBytes.push_back(uint8_t(bits >> bitCount));
+            }
+        }
+        return true;
+    }
+    // Only remembers the handful of values Map needs, dropping everything else as it goes by //
+    class TiledMapSax : public nlohmann::json_sax<nlohmann::json>
+    {
+    private:
+        enum class Context : uint8_t
+        {
+            ROOT, LAYERS, LAYER, LAYER_DATA, TILESETS, TILESET,
+            // Tiled < 1.2 keeps tile properties as {"id": {"name": value}} objects..
+            TILE_PROPERTY_MAP, TILE_PROPERTY_SET,
+            // ..newer versions as a "tiles" array of {"id", "properties": [{"name", "value"}]}
+            TILES, TILE, TILE_PROPERTIES, TILE_PROPERTY,
+            IGNORED
+        };
+    public:
+        TiledMapSax(TiledMapReader& reader)
+            :reader(reader)
+            ,tileId(0)
+            ,tilePropertyValue(0)
+            ,hasTilePropertyValue(false)
+        {
+        }
+        const std::string& getError() const
+        {
+            return error;
+        }
+        bool null() override
+        {
+            return true;
+        }
+        bool boolean(bool value) override
+        {
+            return propertyValue(value ? 1 : 0);
+        }
+        bool number_integer(number_integer_t value) override
+        {
+            if (isPropertyContext())
+            {
+                return propertyValue(double(value));
+            }
+            // a tile id can't be negative, but anything else which is means nothing to us //
+            if (value < 0)
+            {
+                return contexts.empty() || contexts.back() != Context::LAYER_DATA ||
+                    fail("negative tile id in a layer's data");
+            }
+            return number(uint64_t(value));
+        }
+        bool number_unsigned(number_unsigned_t value) override
+        {
+            if (isPropertyContext())
+            {
+                return propertyValue(double(value));
+            }
+            return number(uint64_t(value));
+        }
+        bool number_float(number_float_t value, const string_t&) override
+        {
+            return propertyValue(value);
+        }
+        bool string(string_t& value) override
+        {
+            if (contexts.empty())
+            {
+                return true;
+            }
+            if (contexts.back() == Context::LAYER)
+            {
+                if (lastKey == "type") layerType = value;
+                else if (lastKey == "name") layer.name = value;
+                else if (lastKey == "encoding") layerEncoding = value;
+                else if (lastKey == "compression") layerCompression = value;
+                // base64 data can't be decoded until we know how it's compressed //
+                else if (lastKey == "data") layerEncodedData.swap(value);
+            }
+            else if (contexts.back() == Context::TILESET)
+            {
+                if (lastKey == "image") tileset.image = value;
+                else if (lastKey == "source")
+                {
+                    return fail("external tileset \"" + value + "\" isn't supported, embed it in the map");
+                }
+            }
+            else if (contexts.back() == Context::TILE_PROPERTY && lastKey == "name")
+            {
+                tilePropertyName = value;
+            }
+            return true;
+        }
+        bool binary(binary_t&) override
+        {
+            return true;
+        }
+        bool start_object(std::size_t) override
+        {
+            Context context = Context::IGNORED;
+            if (contexts.empty())
+            {
+                context = Context::ROOT;
+            }
+            else if (contexts.back() == Context::LAYERS)
+            {
+                context = Context::LAYER;
+                layer = TiledMapReader::TileLayer();
+                layerType.clear();
+                layerEncoding.clear();
+                layerCompression.clear();
+                layerEncodedData.clear();
+            }
+            else if (contexts.back() == Context::TILESETS)
+            {
+                context = Context::TILESET;
+                tileset = TiledMapReader::Tileset();
+            }
+            else if (contexts.back() == Context::TILESET && lastKey == "tileproperties")
+            {
+                context = Context::TILE_PROPERTY_MAP;
+            }
+            else if (contexts.back() == Context::TILE_PROPERTY_MAP)
+            {
+                context = Context::TILE_PROPERTY_SET;
+                tileId = unsigned(std::strtoul(lastKey.c_str(), nullptr, 10));
+            }
+            else if (contexts.back() == Context::TILES)
+            {
+                context = Context::TILE;
+                tileId = 0;
+                tileProperties.clear();
+            }
+            else if (contexts.back() == Context::TILE_PROPERTIES)
+            {
+                context = Context::TILE_PROPERTY;
+                tilePropertyName.clear();
+                hasTilePropertyValue = false;
+            }
+            contexts.push_back(context);
+            return true;
+        }
+        bool key(string_t& value) override
+        {
+            lastKey = value;
+            return true;
+        }
+        bool end_object() override
+        {
+            const Context context = contexts.back();
+            contexts.pop_back();
+            if (context == Context::LAYER)
+            {
+                return finishLayer();
+            }
+            if (context == Context::TILESET)
+            {
+                reader.tilesets.push_back(tileset);
+            }
+            else if (context == Context::TILE_PROPERTY && hasTilePropertyValue)
+            {
+                tileProperties[tilePropertyName] = tilePropertyValue;
+            }
+            // a tile's "id" may come after its properties, so they wait until the tile ends //
+            else if (context == Context::TILE && !tileProperties.empty())
+            {
+                tileset.tileProperties[tileId].swap(tileProperties);
+            }
+            return true;
+        }
+        bool start_array(std::size_t) override
+        {
+            Context context = Context::IGNORED;
+            if (!contexts.empty() && contexts.back() == Context::ROOT && lastKey == "layers")
+            {
+                context = Context::LAYERS;
+            }
+            else if (!contexts.empty() && contexts.back() == Context::ROOT && lastKey == "tilesets")
+            {
+                context = Context::TILESETS;
+            }
+            else if (!contexts.empty() && contexts.back() == Context::LAYER && lastKey == "data")
+            {
+                context = Context::LAYER_DATA;
+            }
+            else if (!contexts.empty() && contexts.back() == Context::TILESET && lastKey == "tiles")
+            {
+                context = Context::TILES;
+            }
+            else if (!contexts.empty() && contexts.back() == Context::TILE && lastKey == "properties")
+            {
+                context = Context::TILE_PROPERTIES;
+            }
+            contexts.push_back(context);
+            return true;
+        }
+        bool end_array() override
+        {
+            contexts.pop_back();
+            return true;
+        }
+        bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& e) override
+        {
+            return fail(std::string(e.what()) + " at byte " + std::to_string(position));
+        }
+    private:
+        bool fail(const std::string& message)
+        {
+            error = message;
+            return false;
+        }
+        bool number(uint64_t value)
+        {
+            if (contexts.empty())
+            {
+                return true;
+            }
+            switch (contexts.back())
+            {
+            case Context::LAYER_DATA:
+                // every layer's data is kept until we know whether it's a tile layer worth keeping //
+                return appendTile(value);
+            case Context::LAYER:
+                if (lastKey == "width") layer.width = unsigned(value);
+                else if (lastKey == "height") layer.height = unsigned(value);
+                return true;
+            case Context::TILESET:
+                if (lastKey == "tilewidth") tileset.tileWidth = unsigned(value);
+                else if (lastKey == "tileheight") tileset.tileHeight = unsigned(value);
+                else if (lastKey == "columns") tileset.columns = unsigned(value);
+                else if (lastKey == "firstgid") tileset.firstGid = unsigned(value);
+                return true;
+            case Context::TILE:
+                if (lastKey == "id") tileId = unsigned(value);
+                return true;
+            default:
+                return true;
+            }
+        }
+        bool isPropertyContext() const
+        {
+            return !contexts.empty() &&
+                (contexts.back() == Context::TILE_PROPERTY_SET || contexts.back() == Context::TILE_PROPERTY);
+        }
+        // only numeric & boolean properties mean anything to the simulation //
+        bool propertyValue(double value)
+        {
+            if (contexts.empty())
+            {
+                return true;
+            }
+            if (contexts.back() == Context::TILE_PROPERTY_SET)
+            {
+                tileset.tileProperties[tileId][lastKey] = value;
+            }
+            else if (contexts.back() == Context::TILE_PROPERTY && lastKey == "value")
+            {
+                tilePropertyValue = value;
+                hasTilePropertyValue = true;
+            }
+            return true;
+        }
+        bool appendTile(uint64_t gid)
+        {
+            gid &= TILED_GID_MASK;
+            if (gid > UINT16_MAX)
+            {
+                return fail("tile id " + std::to_string(gid) + " doesn't fit in 16 bits");
+            }
+            layer.tiles.push_back(uint16_t(gid));
+            return true;
+        }
+        bool finishLayer()
+        {
+            if (layerType != "tilelayer")
+            {
+                return true;
+            }
+            const size_t tileCount = size_t(layer.width)*layer.height;
+            if (layerEncoding == "base64")
+            {
+                std::vector<uint8_t> bytes;
+                if (!decodeBase64(layerEncodedData, bytes))
+                {
+                    return fail("layer \"" + layer.name + "\" has malformed base64 data");
+                }
+                std::string().swap(layerEncodedData);
+                if (!decompress(bytes, tileCount * 4))
+                {
+                    return false;
+                }
+                if (bytes.size() != tileCount * 4)
+                {
+                    return fail("layer \"" + layer.name + "\" decodes to the wrong number of tiles");
+                }
+                layer.tiles.reserve(tileCount);
+                for (size_t t = 0; t < tileCount; t++)
+                {
+                    // little endian 32 bit ids //
+                    const uint32_t gid = uint32_t(bytes[4 * t]) | uint32_t(bytes[4 * t + 1]) << 8 |
+                        uint32_t(bytes[4 * t + 2]) << 16 | uint32_t(bytes[4 * t + 3]) << 24;
+                    if (!appendTile(gid))
+                    {
+                        return false;
+                    }
+                }
+            }
+            else if (!layerEncoding.empty() && layerEncoding != "csv")
+            {
+                return fail("layer \"" + layer.name + "\" has unknown encoding \"" + layerEncoding + "\"");
+            }
+            if (layer.tiles.size() != tileCount)
+            {
+                return fail("layer \"" + layer.name + "\" should have " + std::to_string(tileCount) +
+                    " tiles but has " + std::to_string(layer.tiles.size()));
+            }
+            reader.tileLayers.push_back(std::move(layer));
+            layer = TiledMapReader::TileLayer();
+            return true;
+        }
+        bool decompress(std::vector<uint8_t>& bytes, size_t decompressedSize)
+        {
+            if (layerCompression.empty())
+            {
+                return true;
+            }
+            std::vector<uint8_t> decompressed(decompressedSize);
+            if (layerCompression == "zlib" || layerCompression == "gzip")
+            {
+#ifdef USE_ZLIB
+                z_stream stream = {};
+                // +32 lets zlib tell the two headers apart by itself //
+                if (inflateInit2(&stream, 15 + 32) != Z_OK)
+                {
+                    return fail("could not start zlib");
+                }
+                stream.next_in = bytes.data();
+                stream.avail_in = uInt(bytes.size());
+                stream.next_out = decompressed.data();
+                stream.avail_out = uInt(decompressed.size());
+                const int result = inflate(&stream, Z_FINISH);
+                const size_t inflatedSize = stream.total_out;
+                inflateEnd(&stream);
+                if (result != Z_STREAM_END)
+                {
+                    return fail("layer \"" + layer.name + "\" has corrupt " + layerCompression + " data");
+                }
+                decompressed.resize(inflatedSize);
+#else
+                return fail("layer \"" + layer.name + "\" is " + layerCompression +
+                    " compressed, which needs a build with USE_ZLIB");
+#endif
+            }
+            else if (layerCompression == "zstd")
+            {
+#ifdef USE_ZSTD
+                const size_t result = ZSTD_decompress(decompressed.data(), decompressed.size(),
+                    bytes.data(), bytes.size());
+                if (ZSTD_isError(result))
+                {
+                    return fail("layer \"" + layer.name + "\" has corrupt zstd data: " + ZSTD_getErrorName(result));
+                }
+                decompressed.resize(result);
+#else
+                return fail("layer \"" + layer.name + "\" is zstd compressed, which needs a build with USE_ZSTD");
+#endif
+            }
+            else
+            {
+                return fail("layer \"" + layer.name + "\" has unknown compression \"" + layerCompression + "\"");
+            }
+            bytes.swap(decompressed);
+            return true;
+        }
+    private:
+        TiledMapReader& reader;
+        std::vector<Context> contexts;
+        std::string lastKey;
+        std::string error;
+        // the layer/tileset object currently being streamed through //
+        TiledMapReader::TileLayer layer;
+        std::string layerType;
+        std::string layerEncoding;
+        std::string layerCompression;
+        std::string layerEncodedData;
+        TiledMapReader::Tileset tileset;
+        // the tile currently being streamed through, and its properties so far //
+        unsigned tileId;
+        std::map<std::string, double> tileProperties;
+        std::string tilePropertyName;
+        double tilePropertyValue;
+        bool hasTilePropertyValue;
+    };
+}
+bool TiledMapReader::read(const std::string& filename)
+{
+    tilesets.clear();
+    tileLayers.clear();
+    // parsed straight off stdio's buffer, much cheaper than an istream & without ever holding the whole text //
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file)
+    {
+        std::cerr << "ERROR: could not open \"" << filename << "\"\n";
+        return false;
+    }
+    TiledMapSax sax(*this);
+    const bool parsed = nlohmann::json::sax_parse(file, &sax);
+    std::fclose(file);
+    if (!parsed)
+    {
+        std::cerr << "ERROR: could not load \"" << filename << "\": " << sax.getError() << "\n";
+        return false;
+    }
+    if (tileLayers.empty())
+    {
+        std::cerr << "ERROR: \"" << filename << "\" has no tile layers\n";
+        return false;
+    }
+    if (tilesets.empty())
+    {
+        std::cerr << "ERROR: \"" << filename << "\" has no tilesets\n";
+        return false;
+    }
+    for (const auto& tileLayer : tileLayers)
+    {
+        if (tileLayer.width != tileLayers[0].width || tileLayer.height != tileLayers[0].height)
+        {
+            std::cerr << "ERROR: tile layer \"" << tileLayer.name << "\" of \"" << filename <<
+                "\" isn't the same size as \"" << tileLayers[0].name << "\"\n";
+            return false;
+        }
+    }
+    return true;
+}
+TiledMapReader::Tileset::Tileset()
+    :tileWidth(0)
+    ,tileHeight(0)
+    ,columns(1)
+    ,firstGid(1)
+{
+}
+TiledMapReader::TileLayer::TileLayer()
+    :width(0)
+    ,height(0)
+{
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+/*
+    Streams a Tiled JSON map straight into compact tile grids with a SAX parser,
+    so the json document of a big map never has to exist in memory all at once.
+    Layer data can be a plain array of tile ids, or base64 encoded, which may also
+    be zlib/gzip (build with USE_ZLIB) or zstd (build with USE_ZSTD) compressed
+*/
+class TiledMapReader
+{
+public:
+    struct Tileset
+    {
+        Tileset();
+        std::string image;
+        unsigned tileWidth;
+        unsigned tileHeight;
+        unsigned columns;
+        unsigned firstGid;
+        // numeric & boolean custom properties of each tile which has any, by local tile id.
+        //  Both Tiled's older "tileproperties" & newer "tiles" layouts are read
+        std::map<unsigned, std::map<std::string, double>> tileProperties;
+    };
+    struct TileLayer
+    {
+        TileLayer();
+        std::string name;
+        unsigned width;
+        unsigned height;
+        // row-major global tile ids with Tiled's flip flags stripped, 0 where empty
+        std::vector<uint16_t> tiles;
+    };
+public:
+    // keeps every tile layer, in the order Tiled draws them.
+    //  Returns false, having said why, if the file can't be read or understood
+    bool read(const std::string& filename);
+public:
+    std::vector<Tileset> tilesets;
+    std::vector<TileLayer> tileLayers;
+};
\ No newline at end of file
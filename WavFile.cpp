@@ -0,0 +1,222 @@
+#include "WavFile.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+namespace
+{
+    const uint16_t FORMAT_PCM = 1;
+    const uint16_t FORMAT_IEEE_FLOAT = 3;
+    const uint16_t FORMAT_EXTENSIBLE = 0xFFFE;
+    // WAVE files are little-endian no matter what wrote them //
+    uint32_t readLittleEndian(const unsigned char* bytes, unsigned byteCount)
+    {
+        uint32_t value = 0;
+        for (unsigned b = 0; b < byteCount; b++)
+        {
+            value |= uint32_t(bytes[b]) << (8 * b);
+        }
+        return value;
+    }
+    void writeLittleEndian(std::ostream& out, uint32_t value, unsigned byteCount)
+    {
+        for (unsigned b = 0; b < byteCount; b++)
+        {
+            out.put(char((value >> (8 * b)) & 0xFF));
+        }
+    }
+    // one sample, scaled so full scale is +-1
+    float decodeSample(const unsigned char* bytes, uint16_t format, unsigned bitsPerSample)
+    {
+        if (format == FORMAT_IEEE_FLOAT)
+        {
+            if (bitsPerSample == 64)
+            {
+                double value;
+                const uint64_t raw = uint64_t(readLittleEndian(bytes, 4)) |
+                    (uint64_t(readLittleEndian(bytes + 4, 4)) << 32);
+                memcpy(&value, &raw, sizeof(value));
+                return float(value);
+            }
+            float value;
+            const uint32_t raw = readLittleEndian(bytes, 4);
+            memcpy(&value, &raw, sizeof(value));
+            return value;
+        }
+        // 8 bit PCM is the only unsigned one //
+        const unsigned byteCount = bitsPerSample / 8;
+        if (byteCount == 1)
+        {
+            return (float(bytes[0]) - 128.f) / 128.f;
+        }
+        // shift the sample up to the top of an int32 so its sign comes along //
+        const int32_t value = int32_t(readLittleEndian(bytes, byteCount) << (32 - bitsPerSample));
+        return float(value / 2147483648.0);
+    }
+}
+WavFile::WavFile()
+    :sampleRate(0)
+{
+}
+bool WavFile::read(const std::string & filename)
+{
+    WavReader reader;
+    if (!reader.open(filename))
+    {
+        return false;
+    }
+    sampleRate = reader.sampleRate;
+    channels.assign(reader.channelCount, std::vector<float>());
+    reader.read(reader.frameCount, channels);
+    return true;
+}
+bool WavFile::write(const std::string & filename) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "ERROR: could not open \"" << filename << "\"\n";
+        return false;
+    }
+    const uint32_t channelCount = uint32_t(channels.size());
+    const uint32_t frames = uint32_t(frameCount());
+    const uint32_t dataBytes = frames*channelCount * 4;
+    // float files carry a fact chunk with their length //
+    file.write("RIFF", 4);
+    writeLittleEndian(file, 4 + (8 + 16) + (8 + 4) + (8 + dataBytes), 4);
+    file.write("WAVE", 4);
+    file.write("fmt ", 4);
+    writeLittleEndian(file, 16, 4);
+    writeLittleEndian(file, FORMAT_IEEE_FLOAT, 2);
+    writeLittleEndian(file, channelCount, 2);
+    writeLittleEndian(file, sampleRate, 4);
+    writeLittleEndian(file, sampleRate*channelCount * 4, 4);
+    writeLittleEndian(file, channelCount * 4, 2);
+    writeLittleEndian(file, 32, 2);
+    file.write("fact", 4);
+    writeLittleEndian(file, 4, 4);
+    writeLittleEndian(file, frames, 4);
+    file.write("data", 4);
+    writeLittleEndian(file, dataBytes, 4);
+    // interleave into one buffer so minutes of audio aren't written a byte at a time //
+    std::vector<unsigned char> data(dataBytes);
+    for (uint32_t f = 0; f < frames; f++)
+    {
+        for (uint32_t c = 0; c < channelCount; c++)
+        {
+            uint32_t raw;
+            memcpy(&raw, &channels[c][f], sizeof(raw));
+            for (unsigned b = 0; b < 4; b++)
+            {
+                data[(size_t(f)*channelCount + c) * 4 + b] = (unsigned char)((raw >> (8 * b)) & 0xFF);
+            }
+        }
+    }
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    if (!file)
+    {
+        std::cerr << "ERROR: could not write \"" << filename << "\"\n";
+        return false;
+    }
+    return true;
+}
+size_t WavFile::frameCount() const
+{
+    return channels.empty() ? 0 : channels[0].size();
+}
+WavReader::WavReader()
+    :sampleRate(0)
+    ,channelCount(0)
+    ,frameCount(0)
+    ,format(0)
+    ,bitsPerSample(0)
+    ,framesLeft(0)
+{
+}
+bool WavReader::open(const std::string & filename)
+{
+    file.open(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "ERROR: could not open \"" << filename << "\"\n";
+        return false;
+    }
+    unsigned char riffHeader[12];
+    if (!file.read(reinterpret_cast<char*>(riffHeader), sizeof(riffHeader)) ||
+        memcmp(riffHeader, "RIFF", 4) != 0 || memcmp(riffHeader + 8, "WAVE", 4) != 0)
+    {
+        std::cerr << "ERROR: \"" << filename << "\" is not a RIFF WAVE file\n";
+        return false;
+    }
+    bool foundFormat = false;
+    // walk the chunks until the samples turn up, skipping any we don't care about //
+    unsigned char chunkHeader[8];
+    while (file.read(reinterpret_cast<char*>(chunkHeader), sizeof(chunkHeader)))
+    {
+        const uint32_t chunkSize = readLittleEndian(chunkHeader + 4, 4);
+        if (memcmp(chunkHeader, "fmt ", 4) == 0)
+        {
+            std::vector<unsigned char> fmt(chunkSize);
+            if (chunkSize < 16 || !file.read(reinterpret_cast<char*>(fmt.data()), chunkSize))
+            {
+                break;
+            }
+            format = uint16_t(readLittleEndian(&fmt[0], 2));
+            channelCount = readLittleEndian(&fmt[2], 2);
+            sampleRate = readLittleEndian(&fmt[4], 4);
+            bitsPerSample = readLittleEndian(&fmt[14], 2);
+            // the real format of an extensible file is the first 2 bytes of its sub-format guid //
+            if (format == FORMAT_EXTENSIBLE && chunkSize >= 26)
+            {
+                format = uint16_t(readLittleEndian(&fmt[24], 2));
+            }
+            foundFormat = true;
+        }
+        else if (memcmp(chunkHeader, "data", 4) == 0)
+        {
+            if (!foundFormat)
+            {
+                break;
+            }
+            const bool isPcm = format == FORMAT_PCM && bitsPerSample >= 8 && bitsPerSample <= 32 &&
+                bitsPerSample % 8 == 0;
+            const bool isFloat = format == FORMAT_IEEE_FLOAT && (bitsPerSample == 32 || bitsPerSample == 64);
+            if ((!isPcm && !isFloat) || channelCount == 0 || sampleRate == 0)
+            {
+                std::cerr << "ERROR: \"" << filename << "\" has an unsupported format (format=" << format <<
+                    " bitsPerSample=" << bitsPerSample << " channels=" << channelCount << ")\n";
+                return false;
+            }
+            frameCount = chunkSize / (channelCount*bitsPerSample / 8);
+            framesLeft = frameCount;
+            return true;
+        }
+        else
+        {
+            // chunks are padded to an even length //
+            file.seekg(chunkSize + (chunkSize & 1), std::ios::cur);
+        }
+    }
+    std::cerr << "ERROR: \"" << filename << "\" has no " << (foundFormat ? "data" : "fmt") << " chunk\n";
+    return false;
+}
+size_t WavReader::read(size_t frameCount, std::vector<std::vector<float>>& channels)
+{
+    const unsigned frameBytes = channelCount*bitsPerSample / 8;
+    std::vector<unsigned char> data(std::min(frameCount, framesLeft)*frameBytes);
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+    const size_t frames = size_t(file.gcount()) / frameBytes;
+    // a short read means the file ends early, so there's nothing more to come //
+    framesLeft = frames*frameBytes < data.size() ? 0 : framesLeft - frames;
+    for (unsigned c = 0; c < channelCount; c++)
+    {
+        std::vector<float>& channel = channels[c];
+        const size_t start = channel.size();
+        channel.resize(start + frames);
+        for (size_t f = 0; f < frames; f++)
+        {
+            channel[start + f] = decodeSample(&data[f*frameBytes + c*bitsPerSample / 8], format, bitsPerSample);
+        }
+    }
+    return frames;
+}
\ No newline at end of file
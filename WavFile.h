@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+/*
+    RIFF WAVE audio, held as one float array per channel with full scale at +-1.
+    Reads 8 to 32 bit integer PCM & 32/64 bit float, plain or WAVE_FORMAT_EXTENSIBLE.
+    Always writes 32 bit float, so nothing louder than full scale gets clipped
+*/
+class WavFile
+{
+public:
+    WavFile();
+    // Returns false, having said why, if the file can't be read or understood
+    bool read(const std::string& filename);
+    bool write(const std::string& filename) const;
+    size_t frameCount() const;
+public:
+    unsigned sampleRate;
+    std::vector<std::vector<float>> channels;
+};
+/*
+    Reads a WAVE file's frames a block at a time,
+    for signals too long to want all of them in memory at once
+*/
+class WavReader
+{
+public:
+    WavReader();
+    // Returns false, having said why, if the file can't be read or understood
+    bool open(const std::string& filename);
+    // Appends up to frameCount frames onto each of channelCount channels, returning how many there were.
+    //  A truncated file still gives up the frames it has
+    size_t read(size_t frameCount, std::vector<std::vector<float>>& channels);
+public:
+    unsigned sampleRate;
+    unsigned channelCount;
+    // according to the data chunk's header
+    size_t frameCount;
+private:
+    std::ifstream file;
+    uint16_t format;
+    unsigned bitsPerSample;
+    size_t framesLeft;
+};
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "WaveSimApi.h"
+#include "Map.h"
+#include "toolbox.h"
+#include <cstdint>
+#include <iostream>
+struct WaveSim
+{
+    Map map;
+    Map::Scenario scenario;
+};
+namespace
+{
+    bool findStateIndex(WaveSim* sim, double x, double y, double z, Map::StateIndex& stateIndex)
+    {
+        const sf::Vector3f location(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
+        if (!sim->map.findStateIndex(location, stateIndex))
+        {
+            std::cerr << "ERROR: " << location << " is outside the simulation\n";
+            return false;
+        }
+        return true;
+    }
+}
+WaveSim* wavesim_create(const char* mapFilename, int volumetric, unsigned regionTiles, const char* quality)
+{
+    Map::LoadOptions options;
+    options.volumetric = volumetric != 0;
+    if (regionTiles > 0)
+    {
+        options.regionTiles = regionTiles;
+    }
+    if (quality && !options.setQuality(quality))
+    {
+        std::cerr << "ERROR: unknown quality \"" << quality << "\"\n";
+        return nullptr;
+    }
+    WaveSim* sim = new WaveSim;
+    if (!mapFilename || !sim->map.load(mapFilename, options))
+    {
+        delete sim;
+        return nullptr;
+    }
+    sim->scenario = sim->map.createScenario();
+    return sim;
+}
+void wavesim_destroy(WaveSim* sim)
+{
+    if (!sim)
+    {
+        return;
+    }
+    sim->map.releaseScenario(sim->scenario);
+    delete sim;
+}
+double wavesim_time_step(const WaveSim* sim)
+{
+    return sim->map.getSimDeltaTime();
+}
+double wavesim_voxel_spacing(const WaveSim* sim)
+{
+    return sim->map.getVoxelSpacing();
+}
+void wavesim_grid_size(const WaveSim* sim, unsigned* lengthX, unsigned* lengthY, unsigned* lengthZ)
+{
+    const sf::Vector3<unsigned> lengths = sim->map.getVoxelGridLengths();
+    if (lengthX) *lengthX = lengths.x;
+    if (lengthY) *lengthY = lengths.y;
+    if (lengthZ) *lengthZ = lengths.z;
+}
+int wavesim_add_source(WaveSim* sim, double x, double y, double z, int signal, double seconds)
+{
+    Map::PointSource::Type type;
+    switch (signal)
+    {
+    case WAVESIM_SIGNAL_CLICK:
+        type = Map::PointSource::Type::CLICK;
+        break;
+    case WAVESIM_SIGNAL_GAUSSIAN:
+        type = Map::PointSource::Type::GAUSIAN_PULSE;
+        break;
+    default:
+        std::cerr << "ERROR: unknown signal " << signal << "\n";
+        return -1;
+    }
+    Map::StateIndex stateIndex;
+    if (!findStateIndex(sim, x, y, z, stateIndex))
+    {
+        return -1;
+    }
+    sim->scenario.pointSources.push_back({ sim->map, stateIndex, float(seconds), type });
+    return 0;
+}
+int wavesim_add_wav_source(WaveSim* sim, double x, double y, double z, const char* wavFilename)
+{
+    Map::StateIndex stateIndex;
+    if (!wavFilename || !findStateIndex(sim, x, y, z, stateIndex))
+    {
+        return -1;
+    }
+    auto signal = std::make_shared<SignalStream>();
+    if (!signal->open(wavFilename, sim->map.getSimDeltaTime(), sim->map.getMaximumSoundHz()))
+    {
+        return -1;
+    }
+    sim->scenario.pointSources.push_back({ sim->map, stateIndex, signal });
+    return 0;
+}
+int wavesim_add_probe(WaveSim* sim, double x, double y, double z)
+{
+    Map::StateIndex stateIndex;
+    if (!findStateIndex(sim, x, y, z, stateIndex))
+    {
+        return -1;
+    }
+    sim->scenario.probes.push_back(stateIndex);
+    return int(sim->scenario.probes.size() - 1);
+}
+int wavesim_step(WaveSim* sim, unsigned steps)
+{
+    for (unsigned s = 0; s < steps && !sim->scenario.stability.paused; s++)
+    {
+        sim->map.streamScenario(sim->scenario);
+        if (!sim->map.stepScenario(sim->scenario))
+        {
+            return -1;
+        }
+    }
+    if (sim->scenario.stability.paused)
+    {
+        std::cerr << "ERROR: the simulation diverged at step " << sim->scenario.stepCount << " & is paused\n";
+        return -1;
+    }
+    return 0;
+}
+size_t wavesim_probe_samples(const WaveSim* sim, unsigned probe, const double** samples)
+{
+    if (probe >= sim->scenario.probes.size())
+    {
+        *samples = nullptr;
+        return 0;
+    }
+    const std::vector<double>& pressures = sim->scenario.probes[probe].pressures;
+    *samples = pressures.data();
+    return pressures.size();
+}
+size_t wavesim_partition_views(const WaveSim* sim, WaveSimPartitionView* views, size_t capacity)
+{
+    // only the handful of numbers describing each partition are copied, never its pressures //
+    const std::vector<Map::PartitionView> partitionViews = sim->map.partitionViews(sim->scenario);
+    for (size_t v = 0; v < partitionViews.size() && v < capacity; v++)
+    {
+        const Map::PartitionView& partitionView = partitionViews[v];
+        WaveSimPartitionView& view = views[v];
+        view.pressures = partitionView.pressures;
+        view.region = partitionView.region;
+        view.voxelX = partitionView.voxelX;
+        view.voxelY = partitionView.voxelY;
+        view.voxelZ = partitionView.voxelZ;
+        view.lengthX = partitionView.voxelLengthX;
+        view.lengthY = partitionView.voxelLengthY;
+        view.lengthZ = partitionView.voxelLengthZ;
+        view.strideX = 1;
+        view.strideY = partitionView.voxelLengthX;
+        view.strideZ = size_t(partitionView.voxelLengthX)*partitionView.voxelLengthY;
+    }
+    return partitionViews.size();
+}
+void wavesim_watch_stability(WaveSim* sim, unsigned sampleInterval, size_t historyLength,
+    double divergentEnergyRatio, unsigned actions, const char* checkpointFilename)
+{
+    Map::StabilityMonitor& stability = sim->scenario.stability;
+    stability.sampleInterval = sampleInterval;
+    if (historyLength > 0)
+    {
+        stability.historyLength = historyLength;
+    }
+    if (divergentEnergyRatio > 0)
+    {
+        stability.divergentEnergyRatio = divergentEnergyRatio;
+    }
+    stability.actions = uint8_t(actions);
+    if (checkpointFilename)
+    {
+        stability.checkpointFilename = checkpointFilename;
+    }
+}
+size_t wavesim_stability_history(const WaveSim* sim, WaveSimStabilitySample* samples, size_t capacity)
+{
+    const std::deque<Map::StabilitySample>& history = sim->scenario.stability.history;
+    for (size_t s = 0; s < history.size() && s < capacity; s++)
+    {
+        const Map::StabilitySample& stabilitySample = history[s];
+        WaveSimStabilitySample& sample = samples[s];
+        sample.step = stabilitySample.step;
+        sample.energy = stabilitySample.energy;
+        sample.peakMode = stabilitySample.peakMode;
+        sample.growthRate = stabilitySample.growthRate;
+        sample.fastestRegion = stabilitySample.fastestRegion;
+        sample.fastestPartition = stabilitySample.fastestPartition;
+        sample.fastestGrowthRate = stabilitySample.fastestGrowthRate;
+        sample.driven = stabilitySample.driven ? 1 : 0;
+    }
+    return history.size();
+}
+int wavesim_paused(const WaveSim* sim)
+{
+    return sim->scenario.stability.paused ? 1 : 0;
+}
+void wavesim_resume(WaveSim* sim)
+{
+    sim->scenario.stability.resume();
+}
+int wavesim_write_checkpoint(const WaveSim* sim, const char* filename)
+{
+    return filename && sim->map.writeCheckpoint(sim->scenario, filename) ? 0 : -1;
+}
+int wavesim_set_tile(WaveSim* sim, unsigned column, unsigned row, unsigned layer, unsigned gid)
+{
+    if (gid > UINT16_MAX)
+    {
+        std::cerr << "ERROR: tile id " << gid << " is too big\n";
+        return -1;
+    }
+    return sim->map.setTile(column, row, layer, uint16_t(gid), { &sim->scenario }) ? 0 : -1;
+}
\ No newline at end of file
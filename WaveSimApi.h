@@ -0,0 +1,108 @@
+#pragma once
+/*
+    C interface to the solver, for embedding it in other programs & tools (see python/wavesim.py).
+    A simulation is one map & one scenario stepping through it.  Functions returning int give
+    0 on success & -1 on failure, having written why to stderr, like the rest of the program.
+    Pressures come back as views straight into the solver's own arrays, never copies:
+    they change in place as the simulation steps, and only stay valid until the next
+    wavesim_step or wavesim_set_tile, since regions streaming in & out move them.
+    Coordinates are world-space meters; the z of flat maps is ignored
+*/
+#include <stddef.h>
+#ifdef _WIN32
+    #ifdef WAVESIM_EXPORTS
+        #define WAVESIM_API __declspec(dllexport)
+    #else
+        #define WAVESIM_API __declspec(dllimport)
+    #endif
+#else
+    #define WAVESIM_API __attribute__((visibility("default")))
+#endif
+#ifdef __cplusplus
+extern "C" {
+#endif
+typedef struct WaveSim WaveSim;
+enum WaveSimSignal
+{
+    WAVESIM_SIGNAL_CLICK = 0,
+    WAVESIM_SIGNAL_GAUSSIAN = 1
+};
+/* what the stability watch does once the energy diverges, any of them or'd together */
+enum WaveSimWatchAction
+{
+    WAVESIM_WATCH_LOG = 1,
+    /* wavesim_step fails until wavesim_resume */
+    WAVESIM_WATCH_PAUSE = 2,
+    WAVESIM_WATCH_DUMP_CHECKPOINT = 4
+};
+/* One partition's pressures: lengthZ slices of lengthY rows of lengthX voxels,
+    each stride* doubles apart, starting at the voxel voxelX,voxelY,voxelZ of the grid */
+typedef struct WaveSimPartitionView
+{
+    const double* pressures;
+    unsigned region;
+    unsigned voxelX;
+    unsigned voxelY;
+    unsigned voxelZ;
+    unsigned lengthX;
+    unsigned lengthY;
+    unsigned lengthZ;
+    size_t strideX;
+    size_t strideY;
+    size_t strideZ;
+} WaveSimPartitionView;
+/* The scenario's health at one step: its energy, the biggest magnitude of any mode, and the
+    energy's growth per step since the sample before, with the partition which grew fastest.
+    driven is nonzero if a source drove it since the sample before */
+typedef struct WaveSimStabilitySample
+{
+    size_t step;
+    double energy;
+    double peakMode;
+    double growthRate;
+    unsigned fastestRegion;
+    size_t fastestPartition;
+    double fastestGrowthRate;
+    int driven;
+} WaveSimStabilitySample;
+/* quality is "preview", "balanced" or "final", or NULL for the default.
+    regionTiles of 0 keeps the default region size.  Returns NULL if the map won't load */
+WAVESIM_API WaveSim* wavesim_create(const char* mapFilename, int volumetric, unsigned regionTiles,
+    const char* quality);
+WAVESIM_API void wavesim_destroy(WaveSim* sim);
+/* the seconds each step simulates & the meters between voxels, which follow the map's quality */
+WAVESIM_API double wavesim_time_step(const WaveSim* sim);
+WAVESIM_API double wavesim_voxel_spacing(const WaveSim* sim);
+WAVESIM_API void wavesim_grid_size(const WaveSim* sim, unsigned* lengthX, unsigned* lengthY, unsigned* lengthZ);
+/* drives the signal at a location for the given seconds, which must be inside a partition */
+WAVESIM_API int wavesim_add_source(WaveSim* sim, double x, double y, double z, int signal, double seconds);
+/* plays a WAV file from a location, streaming it in ahead of the steps that need it */
+WAVESIM_API int wavesim_add_wav_source(WaveSim* sim, double x, double y, double z, const char* wavFilename);
+/* returns the new probe's index, or -1 if the location isn't inside a partition */
+WAVESIM_API int wavesim_add_probe(WaveSim* sim, double x, double y, double z);
+WAVESIM_API int wavesim_step(WaveSim* sim, unsigned steps);
+/* every pressure the probe has recorded, one per step taken since it was added */
+WAVESIM_API size_t wavesim_probe_samples(const WaveSim* sim, unsigned probe, const double** samples);
+/* Fills up to capacity views, and returns how many partitions there are in all.
+    Only regions a wavefront, source or probe has reached have any */
+WAVESIM_API size_t wavesim_partition_views(const WaveSim* sim, WaveSimPartitionView* views, size_t capacity);
+/* Samples the energy every sampleInterval steps, 0 to stop, keeping the last historyLength
+    samples (0 keeps the default of 256).  Once an undriven simulation's energy passes
+    divergentEnergyRatio times what its sources last left in it (0 keeps the default of 4),
+    or stops being finite, it does the WaveSimWatchActions in actions, writing any
+    checkpoint to checkpointFilename */
+WAVESIM_API void wavesim_watch_stability(WaveSim* sim, unsigned sampleInterval, size_t historyLength,
+    double divergentEnergyRatio, unsigned actions, const char* checkpointFilename);
+/* Fills up to capacity samples, oldest first, and returns how many there are in all */
+WAVESIM_API size_t wavesim_stability_history(const WaveSim* sim, WaveSimStabilitySample* samples, size_t capacity);
+/* nonzero once the watch has paused the simulation */
+WAVESIM_API int wavesim_paused(const WaveSim* sim);
+/* lets a paused simulation step again, watching for it to diverge anew */
+WAVESIM_API void wavesim_resume(WaveSim* sim);
+/* writes every mode of the regions with state, in the format Map::writeCheckpoint describes */
+WAVESIM_API int wavesim_write_checkpoint(const WaveSim* sim, const char* filename);
+/* swaps the tile at a column & row, counted from the top, of a tile layer for another tile id, 0 for none */
+WAVESIM_API int wavesim_set_tile(WaveSim* sim, unsigned column, unsigned row, unsigned layer, unsigned gid);
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,223 @@
+"""
+Thin ctypes binding over the solver's C interface (WaveSimApi.h).
+
+Pressures come back as numpy arrays viewing the solver's own buffers, so nothing is copied,
+but they change as the simulation steps & are only valid until the next step() or set_tile().
+The library is looked for next to this file, or wherever WAVESIM_LIBRARY points.
+"""
+import ctypes
+import os
+import sys
+
+import numpy as np
+
+CLICK = 0
+GAUSSIAN = 1
+
+WATCH_LOG = 1
+WATCH_PAUSE = 2
+WATCH_DUMP_CHECKPOINT = 4
+
+
+class PartitionView(ctypes.Structure):
+    _fields_ = [
+        ("pressures", ctypes.POINTER(ctypes.c_double)),
+        ("region", ctypes.c_uint),
+        ("voxelX", ctypes.c_uint),
+        ("voxelY", ctypes.c_uint),
+        ("voxelZ", ctypes.c_uint),
+        ("lengthX", ctypes.c_uint),
+        ("lengthY", ctypes.c_uint),
+        ("lengthZ", ctypes.c_uint),
+        ("strideX", ctypes.c_size_t),
+        ("strideY", ctypes.c_size_t),
+        ("strideZ", ctypes.c_size_t),
+    ]
+
+
+class StabilitySample(ctypes.Structure):
+    _fields_ = [
+        ("step", ctypes.c_size_t),
+        ("energy", ctypes.c_double),
+        ("peakMode", ctypes.c_double),
+        ("growthRate", ctypes.c_double),
+        ("fastestRegion", ctypes.c_uint),
+        ("fastestPartition", ctypes.c_size_t),
+        ("fastestGrowthRate", ctypes.c_double),
+        ("driven", ctypes.c_int),
+    ]
+
+
+def _load_library():
+    path = os.environ.get("WAVESIM_LIBRARY")
+    if not path:
+        name = "wave-sim-c.dll" if sys.platform == "win32" else "libwave-sim-c.so"
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)), name)
+    lib = ctypes.CDLL(path)
+    sim_p = ctypes.c_void_p
+    lib.wavesim_create.restype = sim_p
+    lib.wavesim_create.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_uint, ctypes.c_char_p]
+    lib.wavesim_destroy.restype = None
+    lib.wavesim_destroy.argtypes = [sim_p]
+    lib.wavesim_time_step.restype = ctypes.c_double
+    lib.wavesim_time_step.argtypes = [sim_p]
+    lib.wavesim_voxel_spacing.restype = ctypes.c_double
+    lib.wavesim_voxel_spacing.argtypes = [sim_p]
+    lib.wavesim_grid_size.restype = None
+    lib.wavesim_grid_size.argtypes = [sim_p] + [ctypes.POINTER(ctypes.c_uint)] * 3
+    lib.wavesim_add_source.restype = ctypes.c_int
+    lib.wavesim_add_source.argtypes = [sim_p, ctypes.c_double, ctypes.c_double, ctypes.c_double,
+                                       ctypes.c_int, ctypes.c_double]
+    lib.wavesim_add_wav_source.restype = ctypes.c_int
+    lib.wavesim_add_wav_source.argtypes = [sim_p, ctypes.c_double, ctypes.c_double, ctypes.c_double,
+                                           ctypes.c_char_p]
+    lib.wavesim_add_probe.restype = ctypes.c_int
+    lib.wavesim_add_probe.argtypes = [sim_p, ctypes.c_double, ctypes.c_double, ctypes.c_double]
+    lib.wavesim_step.restype = ctypes.c_int
+    lib.wavesim_step.argtypes = [sim_p, ctypes.c_uint]
+    lib.wavesim_probe_samples.restype = ctypes.c_size_t
+    lib.wavesim_probe_samples.argtypes = [sim_p, ctypes.c_uint, ctypes.POINTER(ctypes.POINTER(ctypes.c_double))]
+    lib.wavesim_partition_views.restype = ctypes.c_size_t
+    lib.wavesim_partition_views.argtypes = [sim_p, ctypes.POINTER(PartitionView), ctypes.c_size_t]
+    lib.wavesim_watch_stability.restype = None
+    lib.wavesim_watch_stability.argtypes = [sim_p, ctypes.c_uint, ctypes.c_size_t, ctypes.c_double, ctypes.c_uint,
+                                            ctypes.c_char_p]
+    lib.wavesim_stability_history.restype = ctypes.c_size_t
+    lib.wavesim_stability_history.argtypes = [sim_p, ctypes.POINTER(StabilitySample), ctypes.c_size_t]
+    lib.wavesim_paused.restype = ctypes.c_int
+    lib.wavesim_paused.argtypes = [sim_p]
+    lib.wavesim_resume.restype = None
+    lib.wavesim_resume.argtypes = [sim_p]
+    lib.wavesim_write_checkpoint.restype = ctypes.c_int
+    lib.wavesim_write_checkpoint.argtypes = [sim_p, ctypes.c_char_p]
+    lib.wavesim_set_tile.restype = ctypes.c_int
+    lib.wavesim_set_tile.argtypes = [sim_p, ctypes.c_uint, ctypes.c_uint, ctypes.c_uint, ctypes.c_uint]
+    return lib
+
+
+_lib = _load_library()
+
+
+def _view(pointer, shape, strides):
+    """numpy array over memory the solver owns, without copying it"""
+    if not pointer or 0 in shape:
+        return np.zeros(shape)
+    item = ctypes.sizeof(ctypes.c_double)
+    extent = 1 + sum((length - 1) * stride for length, stride in zip(shape, strides))
+    buffer = (ctypes.c_double * extent).from_address(ctypes.addressof(pointer.contents))
+    flat = np.frombuffer(buffer, dtype=np.float64)
+    view = np.lib.stride_tricks.as_strided(flat, shape=shape, strides=[s * item for s in strides])
+    view.flags.writeable = False
+    return view
+
+
+class Simulation:
+    """One map & one scenario stepping through it.  Locations are world-space meters"""
+
+    def __init__(self, map_filename, volumetric=False, region_tiles=0, quality=None):
+        self._sim = _lib.wavesim_create(map_filename.encode(), int(volumetric), region_tiles,
+                                        quality.encode() if quality else None)
+        if not self._sim:
+            raise RuntimeError("could not load \"%s\"" % map_filename)
+        self.time_step = _lib.wavesim_time_step(self._sim)
+        self.voxel_spacing = _lib.wavesim_voxel_spacing(self._sim)
+
+    def close(self):
+        if self._sim:
+            _lib.wavesim_destroy(self._sim)
+            self._sim = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    @property
+    def grid_size(self):
+        """(x, y, z) voxel counts of the whole map"""
+        lengths = [ctypes.c_uint() for _ in range(3)]
+        _lib.wavesim_grid_size(self._sim, *[ctypes.byref(length) for length in lengths])
+        return tuple(length.value for length in lengths)
+
+    def add_source(self, location, signal=CLICK, seconds=None):
+        x, y, z = (tuple(location) + (0.0,))[:3]
+        if _lib.wavesim_add_source(self._sim, x, y, z, signal,
+                                   self.time_step if seconds is None else seconds) != 0:
+            raise ValueError("source at %s is outside the simulation" % (location,))
+
+    def add_wav_source(self, location, wav_filename):
+        """plays a WAV file from a location, resampled to the time step"""
+        x, y, z = (tuple(location) + (0.0,))[:3]
+        if _lib.wavesim_add_wav_source(self._sim, x, y, z, wav_filename.encode()) != 0:
+            raise ValueError("could not play \"%s\" from %s" % (wav_filename, location))
+
+    def add_probe(self, location):
+        x, y, z = (tuple(location) + (0.0,))[:3]
+        probe = _lib.wavesim_add_probe(self._sim, x, y, z)
+        if probe < 0:
+            raise ValueError("probe at %s is outside the simulation" % (location,))
+        return probe
+
+    def step(self, steps=1):
+        if _lib.wavesim_step(self._sim, steps) != 0:
+            raise RuntimeError("step failed")
+
+    def probe_samples(self, probe):
+        """every pressure the probe has recorded so far, one per step"""
+        samples = ctypes.POINTER(ctypes.c_double)()
+        count = _lib.wavesim_probe_samples(self._sim, probe, ctypes.byref(samples))
+        return _view(samples, (count,), (1,))
+
+    def partitions(self):
+        """(view, pressures) of every partition with state: pressures is indexed [z][y][x],
+        and view says where in the voxel grid it starts"""
+        count = _lib.wavesim_partition_views(self._sim, None, 0)
+        views = (PartitionView * count)()
+        _lib.wavesim_partition_views(self._sim, views, count)
+        return [(view, _view(view.pressures, (view.lengthZ, view.lengthY, view.lengthX),
+                             (view.strideZ, view.strideY, view.strideX))) for view in views]
+
+    def pressure_field(self):
+        """Assembles the whole [z][y][x] grid, zero where there's no state.
+        Unlike partitions(), this does copy every pressure"""
+        field = np.zeros(tuple(reversed(self.grid_size)))
+        for view, pressures in self.partitions():
+            field[view.voxelZ:view.voxelZ + view.lengthZ,
+                  view.voxelY:view.voxelY + view.lengthY,
+                  view.voxelX:view.voxelX + view.lengthX] = pressures
+        return field
+
+    def watch_stability(self, sample_interval=16, history_length=0, divergent_energy_ratio=0.0,
+                        actions=WATCH_LOG, checkpoint_filename=None):
+        """samples the energy every sample_interval steps, 0 to stop, & does actions once it diverges.
+        0 keeps the defaults of 256 samples & 4 times what the sources last left in it"""
+        _lib.wavesim_watch_stability(self._sim, sample_interval, history_length, divergent_energy_ratio, actions,
+                                     checkpoint_filename.encode() if checkpoint_filename else None)
+
+    def stability_history(self):
+        """the samples kept so far, oldest first"""
+        count = _lib.wavesim_stability_history(self._sim, None, 0)
+        samples = (StabilitySample * count)()
+        _lib.wavesim_stability_history(self._sim, samples, count)
+        return list(samples)
+
+    @property
+    def paused(self):
+        """whether the stability watch has paused the simulation, so step() fails until resume()"""
+        return _lib.wavesim_paused(self._sim) != 0
+
+    def resume(self):
+        _lib.wavesim_resume(self._sim)
+
+    def write_checkpoint(self, filename):
+        if _lib.wavesim_write_checkpoint(self._sim, filename.encode()) != 0:
+            raise IOError("could not write \"%s\"" % filename)
+
+    def set_tile(self, column, row, layer, gid):
+        """swaps a tile for another tile id, 0 for none, re-decomposing only around it"""
+        if _lib.wavesim_set_tile(self._sim, column, row, layer, gid) != 0:
+            raise ValueError("tile %d,%d of layer %d can't be changed" % (column, row, layer))
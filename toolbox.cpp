@@ -1,11 +1,16 @@
-#include "toolbox.h"
-const double PI = 4 * atan(1);
-std::ostream & operator<<(std::ostream & lhs, const sf::Vector2f rhs)
-{
-    lhs << "{" << rhs.x << "," << rhs.y << "}";
-    return lhs;
-}
-float clampf(float value, float minValue, float maxValue)
-{
-    return std::min(std::max(minValue, value), maxValue);
+#include "toolbox.h"
+const double PI = 4 * atan(1);
+std::ostream & operator<<(std::ostream & lhs, const sf::Vector2f rhs)
+{
+    lhs << "{" << rhs.x << "," << rhs.y << "}";
+    return lhs;
+}
+std::ostream & operator<<(std::ostream & lhs, const sf::Vector3f rhs)
+{
+    lhs << "{" << rhs.x << "," << rhs.y << "," << rhs.z << "}";
+    return lhs;
+}
+float clampf(float value, float minValue, float maxValue)
+{
+    return std::min(std::max(minValue, value), maxValue);
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
-#pragma once
-#include <iostream>
-#include <SFML/System.hpp>
-extern const double PI;
-std::ostream& operator<<(std::ostream& lhs, const sf::Vector2f rhs);
+#pragma once
+#include <iostream>
+#include <SFML/System.hpp>
+extern const double PI;
+std::ostream& operator<<(std::ostream& lhs, const sf::Vector2f rhs);
+std::ostream& operator<<(std::ostream& lhs, const sf::Vector3f rhs);
 float clampf(float value, float minValue, float maxValue);
\ No newline at end of file